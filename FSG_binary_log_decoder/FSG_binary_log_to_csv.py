@@ -0,0 +1,327 @@
+'''
+Title:            FSG_binary_log_to_csv.py
+Date:             Modified 10/17/2026
+Version:          0.5
+Description:      Expands a binary MBED log file (LOG000.BIN) back into the LOG000.csv column layout.
+Python Version:   2.7.13 (also runs on 3.x)
+System:           Windows 7 64-bit
+Notes:            The binary format is the BinaryLogFileHeader / BinaryLogRecord structs in MbedLogger/LogRecord.hpp.
+                  Records with a bad sync byte or CRC are skipped and the decoder resyncs on the next 0xA5.
+                  Version 2 files stamp records in microseconds since power up, TimeSec is worked out from the
+                  last EPOCH (wall time) record.  --us adds a TimeUsec column with the raw microsecond stamp.
+                  Version 3 records are variable length and only carry the fields in their field mask (fast fields
+                  at 10 Hz, slow fields at 1 Hz, gains when they change).  Every record becomes a CSV line with the
+                  other fields carried over from the last record that had them.
+                  Version 4 files can have DELTA records (varint changes since the last record) between full
+                  keyframes, after a bad record the DELTA records are skipped until the next keyframe.
+                  Version 1 files (32 bit TimeSec in the record) and version 2 files are still read.  A file
+                  newer than this decoder is refused (it could have records it would silently leave out), a
+                  record type it doesn't know is counted as bad.
+                  Usage: python FSG_binary_log_to_csv.py [--us] LOG000.BIN [LOG000.csv]
+'''
+
+from __future__ import print_function
+
+import struct
+import sys
+
+class BinaryLogDecoder(object):
+    # same CRC table as the MBED (MbedLogger.cpp) and the transmit/receive programs
+    CRCTABLE = [0, 49345, 49537, 320, 49921, 960, 640, 49729, 50689, 1728, 1920, 51009, 1280, 50625, 50305,  1088, 52225,  3264,  3456, 52545,  3840, 53185, 52865,  3648,  2560, 51905, 52097,  2880, 51457,  2496,  2176, 51265, 55297,  6336,  6528, 55617,  6912, 56257, 55937,  6720,  7680, 57025, 57217,  8000, 56577,  7616,  7296, 56385,  5120, 54465, 54657,  5440, 55041,  6080,  5760, 54849, 53761,  4800,  4992, 54081,  4352, 53697, 53377,  4160, 61441, 12480, 12672, 61761, 13056, 62401, 62081, 12864, 13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529, 15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089, 64001, 15040, 15232, 64321, 14592, 63937, 63617, 14400, 10240, 59585, 59777, 10560, 60161, 11200, 10880, 59969, 60929, 11968, 12160, 61249, 11520, 60865, 60545, 11328, 58369,  9408,  9600, 58689,  9984, 59329, 59009,  9792,  8704, 58049, 58241,  9024, 57601,  8640,  8320, 57409, 40961, 24768, 24960, 41281, 25344, 41921, 41601, 25152, 26112, 42689, 42881, 26432, 42241, 26048, 25728, 42049, 27648, 44225, 44417, 27968, 44801, 28608, 28288, 44609, 43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688, 30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681, 48641, 32448, 32640, 48961, 32000, 48577, 48257, 31808, 46081, 29888, 30080, 46401, 30464, 47041, 46721, 30272, 29184, 45761, 45953, 29504, 45313, 29120, 28800, 45121, 20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441, 38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568, 39937, 23744, 23936, 40257, 24320, 40897, 40577, 24128, 23040, 39617, 39809, 23360, 39169, 22976, 22656, 38977, 34817, 18624, 18816, 35137, 19200, 35777, 35457, 19008, 19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905, 17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369, 33281, 17088, 17280, 33601, 16640, 33217, 32897, 16448]
+
+    # MbedLogger _heading_string
+    HEADING_STRING = "StateStr,St#,TimeSec,DepthCmd,DepthFt,PitchCmd,PitchDeg,RudderPWM,RudderCmdDeg,HeadDeg,bceCmd,bce_mm,battCmd,batt_mm,PitchRateDegSec,depthrate_fps,SystemAmps,SystemVolts,AltChRd,IntPSI,BCE_p,BCi,BCd,BATT_p,BTi,BTd,DEPTH_p,Di,Dd,PITCH_p,Pi,Pd,HEAD_p,Hi,Hd\n"
+
+    # MbedLogger::getStateString(), indexed by the StateMachine state enumeration
+    STATE_STRINGS = ["________SIT_IDLE", "____CHECK_TUNING", "____FIND_NEUTRAL", "____________DIVE",
+                     "____________RISE", "___POSITION_DIVE", "___POSITION_RISE", "_____FLOAT_LEVEL",
+                     "_FLOAT_BROADCAST", "_EMERGENCY_CLIMB", "______MULTI_DIVE", "______MULTI_RISE",
+                     "________KEYBOARD", "_____TX_MBED_LOG", "RECEIVE_SEQUENCE", "_____MANUAL_TUNE"]
+
+    MAGIC = b"FSGB"
+    SYNC = 0xA5
+    TYPE_DATA = 0x01
+    TYPE_EPOCH = 0x02
+    TYPE_DELTA = 0x03
+    LAST_VERSION = 4                # BINARY_LOG_VERSION this decoder knows
+    FIRST_DELTA_VERSION = 4
+    INT16_NAN = -32768
+
+    # version 3 records: sync, type, length, state, time_us_low, time_us_high ... sequence, crc
+    RECORD_HEADER = 12
+    RECORD_TRAILER = 4
+    DELTA_MINIMUM_LENGTH = 9
+    ALL_FIELDS = 0xFFFFFFFF
+
+    def __init__(self, microsecond_column=False):
+        self.microsecond_column = microsecond_column
+
+        self.version = 0
+        self.header_size = 0
+        self.record_size = 0
+        self.num_fields = 0
+        self.decimals = []
+
+        self.good_records = 0
+        self.bad_records = 0
+        self.missing_records = 0
+        self.epoch_records = 0
+        self.skipped_records = 0
+        self.next_sequence = None
+
+        # wall time anchor (EPOCH record), until the first one TimeSec is seconds since power up
+        self.epoch_seconds = 0
+        self.epoch_time_us = 0
+
+    def crccalc(self, input_bytes):
+        crc = 0
+        for x in bytearray(input_bytes):
+            crc = (self.CRCTABLE[(x ^ crc) & 0xff] ^ (crc >> 8)) & 0xFFFF
+        return crc
+
+    def readFileHeader(self, data):
+        # magic, version, header_size, record_size, num_fields (decimals and crc follow)
+        if data[0:4] != self.MAGIC:
+            raise ValueError("Not a binary FSG log file (magic is %r)" % data[0:4])
+
+        self.version, self.header_size, self.record_size, self.num_fields = struct.unpack_from("<HHHH", data, 4)
+        if self.version < 1 or self.version > self.LAST_VERSION:
+            raise ValueError("Binary log version %d, this decoder reads versions 1 to %d" % (self.version, self.LAST_VERSION))
+        self.decimals = list(bytearray(data[12:12 + self.num_fields]))
+
+        (header_crc,) = struct.unpack_from("<H", data, self.header_size - 2)
+        if self.crccalc(data[0:self.header_size - 2]) != header_crc:
+            raise ValueError("Binary log file header CRC is bad")
+
+        return self.header_size
+
+    def wallTime(self, time_us):
+        # floor division, same as MbedLogger::getWallTime for stamps before the epoch
+        return self.epoch_seconds + (time_us - self.epoch_time_us) // 1000000
+
+    def formatLine(self, state, timestamp, fields, time_us=None):
+        if 0 <= state < len(self.STATE_STRINGS):
+            state_string = self.STATE_STRINGS[state]
+        else:
+            state_string = ""
+
+        # same format as the sprintf in MbedLogger::formatCSVLine
+        line = "%16s,%.2d,%10d" % (state_string, state, timestamp)
+
+        for value, decimals in zip(fields, self.decimals):
+            if value == self.INT16_NAN:
+                line += ",%6s" % "nan"
+            else:
+                line += ",%0*.*f" % (6, decimals, value / float(10 ** decimals))
+
+        if self.microsecond_column:
+            line += ",%d" % time_us
+
+        return line + "\n"
+
+    def decode(self, data):
+        """Return the list of CSV lines (heading first) decoded from the binary log"""
+        if self.microsecond_column:
+            lines = [self.HEADING_STRING.rstrip("\n") + ",TimeUsec\n"]
+        else:
+            lines = [self.HEADING_STRING]
+
+        position = self.readFileHeader(data)
+
+        if self.version >= 3:
+            self.decodeVariableRecords(data, position, lines)
+        else:
+            self.decodeFixedRecords(data, position, lines)
+
+        return lines
+
+    def addDataLine(self, lines, state, timestamp, fields, time_us, sequence):
+        # only data records are numbered
+        if self.next_sequence is not None:
+            self.missing_records += (sequence - self.next_sequence) & 0xFFFF
+        self.next_sequence = (sequence + 1) & 0xFFFF
+
+        lines.append(self.formatLine(state, timestamp, fields, time_us))
+        self.good_records += 1
+
+    def setEpoch(self, epoch_seconds, time_us):
+        self.epoch_seconds = epoch_seconds
+        self.epoch_time_us = time_us
+        self.epoch_records += 1
+
+    def decodeFixedRecords(self, data, position, lines):
+        """Version 1 and 2 files, every record is record_size bytes with every field"""
+        # version 1: 32 bit TimeSec, version 2: 64 bit microseconds split in two words
+        if self.version == 1:
+            record_format = "<BBBBI%dhHH" % self.num_fields
+            time_words = 1
+        else:
+            record_format = "<BBBBII%dhHH" % self.num_fields
+            time_words = 2
+
+        fields_start = 4 + time_words
+
+        while position + self.record_size <= len(data):
+            # find the start of the next record
+            if bytearray(data[position:position + 1])[0] != self.SYNC:
+                position += 1
+                continue
+
+            record = struct.unpack_from(record_format, data, position)
+            sync, record_type, length, state = record[0:4]
+            fields = record[fields_start:fields_start + self.num_fields]
+            sequence, crc = record[fields_start + self.num_fields:]
+
+            if length != self.record_size or self.crccalc(data[position:position + self.record_size - 2]) != crc:
+                self.bad_records += 1
+                position += 1
+                continue
+
+            if time_words == 1:
+                time_us = record[4] * 1000000
+            else:
+                time_us = record[4] | (record[5] << 32)
+
+            if record_type == self.TYPE_DATA:
+                if time_words == 1:
+                    timestamp = record[4]
+                else:
+                    timestamp = self.wallTime(time_us)
+
+                self.addDataLine(lines, state, timestamp, fields, time_us, sequence)
+
+            elif record_type == self.TYPE_EPOCH:
+                (epoch_seconds,) = struct.unpack_from("<I", data, position + 4 + 4 * time_words)
+                self.setEpoch(epoch_seconds, time_us)
+
+            position += self.record_size
+
+
+    def readVarint(self, data, offset):
+        """Unsigned LEB128, returns (value, next offset)"""
+        value = 0
+        shift = 0
+        while True:
+            byte = bytearray(data[offset:offset + 1])[0]
+            offset += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value, offset
+
+    def decodeVariableRecords(self, data, position, lines):
+        """Version 3 files, each record has its own length and field mask"""
+        # fields not seen yet print as nan (the first record of a segment has all of them)
+        fields = [self.INT16_NAN] * self.num_fields
+        minimum_length = self.DELTA_MINIMUM_LENGTH
+
+        # DELTA records need every field and the time of the record before
+        have_keyframe = False
+        last_time_us = 0
+
+        while position + minimum_length <= len(data):
+            # find the start of the next record
+            if bytearray(data[position:position + 1])[0] != self.SYNC:
+                position += 1
+                continue
+
+            sync, record_type, length, state = struct.unpack_from("<BBBB", data, position)
+
+            if length < minimum_length or length > self.record_size or position + length > len(data):
+                self.bad_records += 1
+                position += 1
+                continue
+
+            (crc,) = struct.unpack_from("<H", data, position + length - 2)
+
+            if self.crccalc(data[position:position + length - 2]) != crc:
+                self.bad_records += 1
+                have_keyframe = False
+                position += 1
+                continue
+
+            if record_type == self.TYPE_DATA:
+                time_us_low, time_us_high, field_mask = struct.unpack_from("<III", data, position + 4)
+                (sequence,) = struct.unpack_from("<H", data, position + length - 4)
+                time_us = time_us_low | (time_us_high << 32)
+                offset = position + self.RECORD_HEADER + 4
+
+                for i in range(self.num_fields):
+                    if field_mask & (1 << i):
+                        (fields[i],) = struct.unpack_from("<h", data, offset)
+                        offset += 2
+
+                if field_mask == self.ALL_FIELDS:
+                    have_keyframe = True
+                last_time_us = time_us
+
+                self.addDataLine(lines, state, self.wallTime(time_us), fields, time_us, sequence)
+
+            elif record_type == self.TYPE_DELTA and self.version >= self.FIRST_DELTA_VERSION:
+                # only the low byte of the sequence is stored
+                sequence_low = bytearray(data[position + length - 3:position + length - 2])[0]
+                if self.next_sequence is None:
+                    sequence = sequence_low
+                else:
+                    sequence = (self.next_sequence + ((sequence_low - self.next_sequence) & 0xFF)) & 0xFFFF
+
+                if not have_keyframe:
+                    self.skipped_records += 1
+                    self.next_sequence = (sequence + 1) & 0xFFFF
+                    position += length
+                    continue
+
+                delta_time_us, offset = self.readVarint(data, position + 4)
+                changed_mask, offset = self.readVarint(data, offset)
+
+                for i in range(self.num_fields):
+                    if changed_mask & (1 << i):
+                        zig_zag, offset = self.readVarint(data, offset)
+                        fields[i] += (zig_zag >> 1) ^ -(zig_zag & 1)
+
+                time_us = last_time_us + delta_time_us
+                last_time_us = time_us
+
+                self.addDataLine(lines, state, self.wallTime(time_us), fields, time_us, sequence)
+
+            elif record_type == self.TYPE_EPOCH:
+                time_us_low, time_us_high, epoch_seconds = struct.unpack_from("<III", data, position + 4)
+                self.setEpoch(epoch_seconds, time_us_low | (time_us_high << 32))
+
+            else:
+                # good CRC but not a record this version has
+                self.bad_records += 1
+
+            position += length
+
+def main():
+    arguments = sys.argv[1:]
+
+    microsecond_column = "--us" in arguments
+    if microsecond_column:
+        arguments.remove("--us")
+
+    if len(arguments) < 1:
+        print("Usage: python FSG_binary_log_to_csv.py [--us] LOG000.BIN [LOG000.csv]")
+        return
+
+    input_filename = arguments[0]
+
+    if len(arguments) > 1:
+        output_filename = arguments[1]
+    else:
+        output_filename = input_filename.rsplit(".", 1)[0] + ".csv"
+
+    with open(input_filename, "rb") as input_file:
+        data = input_file.read()
+
+    decoder = BinaryLogDecoder(microsecond_column)
+    lines = decoder.decode(data)
+
+    with open(output_filename, "w") as output_file:
+        output_file.writelines(lines)
+
+    print("Python: %s -> %s (version %d, %d records, %d epoch, %d bad, %d missing, %d skipped)" % (input_filename, output_filename, decoder.version, decoder.good_records, decoder.epoch_records, decoder.bad_records, decoder.missing_records, decoder.skipped_records))
+
+if __name__ == '__main__':
+    main()
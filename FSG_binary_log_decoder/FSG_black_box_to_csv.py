@@ -0,0 +1,123 @@
+'''
+Title:            FSG_black_box_to_csv.py
+Date:             10/17/2026
+Version:          0.1
+Description:      Expands a black box capture (BBOX000.BIN) into a CSV file, one line per 100 Hz sample.
+Python Version:   2.7.13 (also runs on 3.x)
+System:           Windows 7 64-bit
+Notes:            The format is the BlackBoxFileHeader / BlackBoxSample structs in BlackBox/BlackBox.hpp.
+                  TimeMs is milliseconds from the trigger (negative before it), positions/PID terms are
+                  scaled back from the x10 integers and the motor commands from x1000.
+                  Usage: python FSG_black_box_to_csv.py BBOX000.BIN [BBOX000.csv]
+'''
+
+from __future__ import print_function
+
+import struct
+import sys
+
+class BlackBoxDecoder(object):
+    # same CRC table as the MBED (MbedLogger.cpp) and the transmit/receive programs
+    CRCTABLE = [0, 49345, 49537, 320, 49921, 960, 640, 49729, 50689, 1728, 1920, 51009, 1280, 50625, 50305,  1088, 52225,  3264,  3456, 52545,  3840, 53185, 52865,  3648,  2560, 51905, 52097,  2880, 51457,  2496,  2176, 51265, 55297,  6336,  6528, 55617,  6912, 56257, 55937,  6720,  7680, 57025, 57217,  8000, 56577,  7616,  7296, 56385,  5120, 54465, 54657,  5440, 55041,  6080,  5760, 54849, 53761,  4800,  4992, 54081,  4352, 53697, 53377,  4160, 61441, 12480, 12672, 61761, 13056, 62401, 62081, 12864, 13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529, 15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089, 64001, 15040, 15232, 64321, 14592, 63937, 63617, 14400, 10240, 59585, 59777, 10560, 60161, 11200, 10880, 59969, 60929, 11968, 12160, 61249, 11520, 60865, 60545, 11328, 58369,  9408,  9600, 58689,  9984, 59329, 59009,  9792,  8704, 58049, 58241,  9024, 57601,  8640,  8320, 57409, 40961, 24768, 24960, 41281, 25344, 41921, 41601, 25152, 26112, 42689, 42881, 26432, 42241, 26048, 25728, 42049, 27648, 44225, 44417, 27968, 44801, 28608, 28288, 44609, 43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688, 30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681, 48641, 32448, 32640, 48961, 32000, 48577, 48257, 31808, 46081, 29888, 30080, 46401, 30464, 47041, 46721, 30272, 29184, 45761, 45953, 29504, 45313, 29120, 28800, 45121, 20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441, 38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568, 39937, 23744, 23936, 40257, 24320, 40897, 40577, 24128, 23040, 39617, 39809, 23360, 39169, 22976, 22656, 38977, 34817, 18624, 18816, 35137, 19200, 35777, 35457, 19008, 19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905, 17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369, 33281, 17088, 17280, 33601, 16640, 33217, 32897, 16448]
+
+    # MbedLogger::getStateString(), indexed by the StateMachine state enumeration
+    STATE_STRINGS = ["________SIT_IDLE", "____CHECK_TUNING", "____FIND_NEUTRAL", "____________DIVE",
+                     "____________RISE", "___POSITION_DIVE", "___POSITION_RISE", "_____FLOAT_LEVEL",
+                     "_FLOAT_BROADCAST", "_EMERGENCY_CLIMB", "______MULTI_DIVE", "______MULTI_RISE",
+                     "________KEYBOARD", "_____TX_MBED_LOG", "RECEIVE_SEQUENCE", "_____MANUAL_TUNE"]
+
+    TRIGGER_STRINGS = {1: "EMERGENCY_CLIMB", 2: "LIMIT_SWITCH", 4: "MANUAL"}
+
+    MAGIC = b"FSGK"
+
+    # magic, version, header_size, sample_size, sample_count, rate_hz, trigger_index, cause, state, reserved,
+    # trigger time low/high, trigger wall time, crc
+    HEADER_FORMAT = "<4sHHHHHHBBHIIIH"
+    HEADER_CRC_OFFSET = 32
+
+    # time_us, adc[8], bce_mm, batt_mm, bce_set_mm, batt_set_mm, depth_ft, pitch_deg, bce_pid[3], batt_pid[3],
+    # bce_output, batt_output, state, switches, reserved
+    SAMPLE_FORMAT = "<I8H6h3h3hhhBBH"
+
+    HEADING_STRING = ("TimeMs,StateStr,St#,ADC0,ADC1,ADC2,ADC3,ADC4,ADC5,ADC6,ADC7,bce_mm,batt_mm,bceSet_mm,battSet_mm,"
+                      "DepthFt,PitchDeg,BCE_err,BCE_int,BCE_der,BATT_err,BATT_int,BATT_der,bceOut,battOut,bceSwitch,battSwitch\n")
+
+    def __init__(self):
+        self.trigger_cause = 0
+        self.trigger_state = 0
+        self.trigger_index = 0
+        self.trigger_epoch_seconds = 0
+        self.sample_count = 0
+
+    def crccalc(self, input_bytes):
+        crc = 0
+        for x in bytearray(input_bytes):
+            crc = (self.CRCTABLE[(x ^ crc) & 0xff] ^ (crc >> 8)) & 0xFFFF
+        return crc
+
+    def decode(self, data):
+        if data[0:4] != self.MAGIC:
+            raise ValueError("not a black box file (no FSGK)")
+
+        header = struct.unpack_from(self.HEADER_FORMAT, data, 0)
+        (magic, version, header_size, sample_size, sample_count, rate_hz, self.trigger_index, self.trigger_cause,
+         self.trigger_state, reserved, time_low, time_high, self.trigger_epoch_seconds, crc) = header
+
+        if self.crccalc(data[0:self.HEADER_CRC_OFFSET]) != crc:
+            raise ValueError("bad header CRC")
+
+        # a short file (power lost while writing) has fewer samples than the header says
+        self.sample_count = min(sample_count, (len(data) - header_size) // sample_size)
+
+        samples = []
+        for i in range(self.sample_count):
+            samples.append(struct.unpack_from(self.SAMPLE_FORMAT, data, header_size + i * sample_size))
+
+        lines = [self.HEADING_STRING]
+        if not samples:
+            return lines
+
+        trigger_time_us = samples[min(self.trigger_index, len(samples) - 1)][0]
+
+        for sample in samples:
+            # microsecond stamps are the low 32 bits, the difference still works across a wrap
+            time_ms = ((sample[0] - trigger_time_us + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+            state = sample[23]
+            state_string = self.STATE_STRINGS[state] if state < len(self.STATE_STRINGS) else ""
+
+            values = ["%.1f" % (time_ms / 1000.0), state_string, "%02d" % state]
+            values += ["%d" % x for x in sample[1:9]]
+            values += ["%.1f" % (x / 10.0) for x in sample[9:21]]
+            values += ["%.3f" % (x / 1000.0) for x in sample[21:23]]
+            values += ["%d" % (sample[24] & 1), "%d" % ((sample[24] >> 1) & 1)]
+            lines.append(",".join(values) + "\n")
+
+        return lines
+
+def main():
+    arguments = sys.argv[1:]
+
+    if len(arguments) < 1:
+        print("Usage: python FSG_black_box_to_csv.py BBOX000.BIN [BBOX000.csv]")
+        return
+
+    input_filename = arguments[0]
+
+    if len(arguments) > 1:
+        output_filename = arguments[1]
+    else:
+        output_filename = input_filename.rsplit(".", 1)[0] + ".csv"
+
+    with open(input_filename, "rb") as input_file:
+        data = input_file.read()
+
+    decoder = BlackBoxDecoder()
+    lines = decoder.decode(data)
+
+    with open(output_filename, "w") as output_file:
+        output_file.writelines(lines)
+
+    print("Python: %s -> %s (%d samples, trigger %s in state %d at sample %d, wall time %d)" % (input_filename, output_filename, decoder.sample_count, decoder.TRIGGER_STRINGS.get(decoder.trigger_cause, str(decoder.trigger_cause)), decoder.trigger_state, decoder.trigger_index, decoder.trigger_epoch_seconds))
+
+if __name__ == '__main__':
+    main()
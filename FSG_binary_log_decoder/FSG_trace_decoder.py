@@ -0,0 +1,158 @@
+'''
+Title:            FSG_trace_decoder.py
+Date:             10/17/2026
+Version:          0.1
+Description:      Turns the binary trace records in an XBee capture back into the status lines.
+Python Version:   2.7.13 (also runs on 3.x)
+System:           Windows 7 64-bit
+Notes:            Record: 0xB5, format ID, argument bytes, time (us, uint32), arguments, XOR checksum
+                  (Trace.cpp).  The format strings and argument types come from Trace/TraceFormats.hpp,
+                  use the copy that matches the firmware.  Text between the records is copied through.
+                  Usage: python FSG_trace_decoder.py capture.bin [capture.txt] [TraceFormats.hpp]
+'''
+
+from __future__ import print_function
+
+import os
+import re
+import struct
+import sys
+
+class TraceDecoder(object):
+    SYNC = 0xB5
+    HEADER_SIZE = 7
+
+    # argument type -> (struct format, scale)
+    TYPES = {"f": ("<f", 1.0), "d": ("<i", 1.0), "t": ("<h", 10.0), "c": ("<h", 100.0)}
+    TYPE_SIZES = {"f": 4, "d": 4, "t": 2, "c": 2}
+
+    ENTRY = re.compile(r'X\((\w+),\s*"(\w*)",\s*"((?:[^"\\]|\\.)*)"\)')
+
+    def __init__(self, formats_filename):
+        # the ID is the position in TRACE_FORMAT_LIST
+        self.formats = []
+
+        with open(formats_filename, "r") as formats_file:
+            for match in self.ENTRY.finditer(formats_file.read()):
+                format_string = match.group(3).replace("\\r", "\r").replace("\\n", "\n").replace('\\"', '"')
+                self.formats.append((match.group(1), match.group(2), format_string))
+
+        self.record_count = 0
+        self.bad_record_count = 0
+        self.last_time_us = None
+        self.time_high = 0
+
+    def argumentBytes(self, types):
+        return sum(self.TYPE_SIZES[t] for t in types)
+
+    def checkRecord(self, data, position):
+        # returns the record length, 0 if there is no good record here
+        if position + self.HEADER_SIZE + 1 > len(data):
+            return 0
+
+        format_id = data[position + 1]
+        length = data[position + 2]
+
+        if format_id >= len(self.formats) or length != self.argumentBytes(self.formats[format_id][1]):
+            return 0
+
+        end = position + self.HEADER_SIZE + length
+
+        if end >= len(data):
+            return 0
+
+        checksum = 0
+        for x in data[position:end]:
+            checksum ^= x
+
+        if checksum != data[end]:
+            return 0
+
+        return self.HEADER_SIZE + length + 1
+
+    def decodeRecord(self, data, position):
+        format_id = data[position + 1]
+        time_us = struct.unpack_from("<I", data, position + 3)[0]
+
+        # the 32 bit microsecond time rolls over every 71.6 minutes
+        if self.last_time_us is not None and time_us < self.last_time_us:
+            self.time_high += 1
+        self.last_time_us = time_us
+
+        name, types, format_string = self.formats[format_id]
+        offset = position + self.HEADER_SIZE
+        values = []
+
+        for t in types:
+            struct_format, scale = self.TYPES[t]
+            value = struct.unpack_from(struct_format, data, offset)[0]
+            values.append(value / scale if t != "d" else value)
+            offset += self.TYPE_SIZES[t]
+
+        seconds = (self.time_high * 4294967296 + time_us) / 1000000.0
+
+        # one line per record (the firmware overwrites the status line with \r on a terminal)
+        return "[%10.3f] %s\n" % (seconds, (format_string % tuple(values)).rstrip())
+
+    def decode(self, data):
+        data = bytearray(data)
+        output = []
+        text = bytearray()
+        position = 0
+
+        while position < len(data):
+            if data[position] == self.SYNC:
+                length = self.checkRecord(data, position)
+
+                if length:
+                    if text:
+                        output.append(text.decode("ascii", "replace"))
+                        text = bytearray()
+
+                    output.append(self.decodeRecord(data, position))
+                    self.record_count += 1
+                    position += length
+                    continue
+
+                self.bad_record_count += 1
+
+            text.append(data[position])
+            position += 1
+
+        if text:
+            output.append(text.decode("ascii", "replace"))
+
+        return output
+
+def main():
+    arguments = sys.argv[1:]
+
+    if len(arguments) < 1:
+        print("Usage: python FSG_trace_decoder.py capture.bin [capture.txt] [TraceFormats.hpp]")
+        return
+
+    input_filename = arguments[0]
+
+    if len(arguments) > 1:
+        output_filename = arguments[1]
+    else:
+        output_filename = input_filename.rsplit(".", 1)[0] + ".txt"
+
+    if len(arguments) > 2:
+        formats_filename = arguments[2]
+    else:
+        formats_filename = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "FSG_code_example_CPP", "Trace", "TraceFormats.hpp")
+
+    with open(input_filename, "rb") as input_file:
+        data = input_file.read()
+
+    decoder = TraceDecoder(formats_filename)
+    output = decoder.decode(data)
+
+    with open(output_filename, "w") as output_file:
+        output_file.writelines(output)
+
+    print("Python: %s -> %s (%d trace records, %d bad, %d formats)" % (input_filename, output_filename, decoder.record_count, decoder.bad_record_count, len(decoder.formats)))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,232 @@
+/*******************************************************************************
+Title:            BlackBox.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+"Black box" for fault forensics.  The 1 Hz log has almost nothing from the
+moments before an emergency climb or a limit switch hit, so the last
+BLACK_BOX_SAMPLES samples at 100 Hz (raw ADC channels, filtered and set
+positions, PID terms, motor commands, state and limit switches) are always kept
+in a RAM ring buffer.
+
+sample() runs in the system ticker right after the linear actuators update, it
+only copies the numbers into the ring (no file I/O).  When a trigger in the
+trigger mask fires (emergency climb, limit switch, keyboard), the ring keeps
+BLACK_BOX_POST_TRIGGER more samples and then freezes.  persist() runs in the
+main loop slack and writes the frozen ring to BBOX###.BIN a block at a time,
+then the black box is armed again.  Triggers while a capture is being
+recorded or written are counted and ignored.
+
+Decode the file with FSG_binary_log_decoder/FSG_black_box_to_csv.py.
+
+*******************************************************************************/
+
+#include "BlackBox.hpp"
+#include "StaticDefs.hpp"
+#include <stddef.h>     //offsetof
+
+// the ring is 13 KB, it goes in the AHB SRAM bank (16 KB that mbed only uses for Ethernet/USB buffers, neither is used here)
+static BlackBoxSample black_box_samples[BLACK_BOX_SAMPLES] __attribute__((section("AHBSRAM0")));
+
+BlackBox::BlackBox(string file_system_input_string) {
+    _file_system_string = file_system_input_string;
+    _fp = NULL;
+    
+    _state = BLACK_BOX_ARMED;
+    _head = 0;
+    _post_trigger_remaining = 0;
+    _trigger_mask = BLACK_BOX_TRIGGER_ALL;
+    
+    memset(&_header, 0, sizeof(_header));
+    _trigger_head = 0;
+    _trigger_time_us = 0;
+    _write_index = 0;
+    _write_end = 0;
+    _file_number = -1;
+    _files_written = 0;
+    _triggers_ignored = 0;
+}
+
+void BlackBox::sample() {
+    if (_state == BLACK_BOX_FROZEN)
+        return;
+    
+    BlackBoxSample & sample = black_box_samples[_head & (BLACK_BOX_SAMPLES - 1)];
+    
+    sample.time_us = (uint32_t)systemClock().read_us();
+    
+    sample.adc[0] = adc().readRawCh0();
+    sample.adc[1] = adc().readRawCh1();
+    sample.adc[2] = adc().readRawCh2();
+    sample.adc[3] = adc().readRawCh3();
+    sample.adc[4] = adc().readRawCh4();
+    sample.adc[5] = adc().readRawCh5();
+    sample.adc[6] = adc().readRawCh6();
+    sample.adc[7] = adc().readRawCh7();
+    
+    sample.bce_mm = scaleToInt16(bce().getPosition_mm(), 1);
+    sample.batt_mm = scaleToInt16(batt().getPosition_mm(), 1);
+    sample.bce_set_mm = scaleToInt16(bce().getSetPosition_mm(), 1);
+    sample.batt_set_mm = scaleToInt16(batt().getSetPosition_mm(), 1);
+    sample.depth_ft = scaleToInt16(depthLoop().getPosition(), 1);
+    sample.pitch_deg = scaleToInt16(pitchLoop().getPosition(), 1);
+    
+    sample.bce_pid[0] = scaleToInt16(bce().getPIDErrorTerm(), 1);
+    sample.bce_pid[1] = scaleToInt16(bce().getPIDIntegralTerm(), 1);
+    sample.bce_pid[2] = scaleToInt16(bce().getPIDDerivativeTerm(), 1);
+    sample.batt_pid[0] = scaleToInt16(batt().getPIDErrorTerm(), 1);
+    sample.batt_pid[1] = scaleToInt16(batt().getPIDIntegralTerm(), 1);
+    sample.batt_pid[2] = scaleToInt16(batt().getPIDDerivativeTerm(), 1);
+    
+    sample.bce_output = scaleToInt16(bce().getOutput(), 3);
+    sample.batt_output = scaleToInt16(batt().getOutput(), 3);
+    
+    sample.state = stateMachine().getState();
+    sample.switches = (bce().getHardwareSwitchStatus() ? 0 : 0x01) | (batt().getHardwareSwitchStatus() ? 0 : 0x02);    //switch reads zero when pressed
+    sample.reserved = 0;
+    
+    _head++;
+    
+    if (_state == BLACK_BOX_TRIGGERED and --_post_trigger_remaining <= 0)
+        _state = BLACK_BOX_FROZEN;
+}
+
+void BlackBox::trigger(int cause) {
+    if (!(cause & _trigger_mask))
+        return;
+    
+    //the limit switch interrupt and the main loop can both get here, the sample ticker must not run in between
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    
+    if (_state != BLACK_BOX_ARMED) {
+        _triggers_ignored++;
+    }
+    else {
+        _state = BLACK_BOX_TRIGGERED;
+        _post_trigger_remaining = BLACK_BOX_POST_TRIGGER;
+        _trigger_head = _head;
+        _trigger_time_us = systemClock().read_us();
+        _header.trigger_cause = cause;
+        _header.trigger_state = stateMachine().getState();
+    }
+    
+    if (!primask)
+        __enable_irq();
+}
+
+// called from the main loop, does nothing unless the buffer is frozen
+void BlackBox::persist() {
+    if (_state != BLACK_BOX_FROZEN)
+        return;
+    
+    if (!_fp) {
+        openFile();
+        
+        if (!_fp) {
+            _state = BLACK_BOX_ARMED;       //no file, don't hold the black box up
+            return;
+        }
+    }
+    
+    unsigned int count = _write_end - _write_index;
+    if (count > BLACK_BOX_WRITE_SAMPLES)
+        count = BLACK_BOX_WRITE_SAMPLES;
+    
+    //the ring wraps around at the end of the array
+    unsigned int index = _write_index & (BLACK_BOX_SAMPLES - 1);
+    if (index + count > BLACK_BOX_SAMPLES)
+        count = BLACK_BOX_SAMPLES - index;
+    
+    fwrite(&black_box_samples[index], sizeof(BlackBoxSample), count, _fp);
+    _write_index += count;
+    
+    if (_write_index == _write_end) {
+        fclose(_fp);
+        _fp = NULL;
+        _files_written++;
+        
+        TRACE(TRACE_LOG, TRACE_INFO, "BlackBox: wrote BBOX%03d.BIN (trigger %d in state %d, %d samples)\n\r", _file_number, _header.trigger_cause, _header.trigger_state, _header.sample_count);
+        
+        //start over
+        _head = 0;
+        _state = BLACK_BOX_ARMED;
+    }
+}
+
+// next BBOX###.BIN and its header, the samples go in oldest first
+void BlackBox::openFile() {
+    if (_file_number < 0)
+        _file_number = findNextFileNumber() - 1;
+    
+    if (_file_number < BLACK_BOX_MAX_FILE)
+        _file_number++;
+    
+    char file_name[20];
+    sprintf(file_name, "BBOX%03d.BIN", _file_number);
+    string file_path_string = _file_system_string + file_name;
+    
+    _fp = fopen(file_path_string.c_str(), "wb");
+    
+    if (!_fp) {
+        TRACE(TRACE_LOG, TRACE_ERROR, "BlackBox: could not open %s\n\r", file_path_string.c_str());
+        return;
+    }
+    
+    _write_end = _head;
+    _write_index = (_head > BLACK_BOX_SAMPLES) ? _head - BLACK_BOX_SAMPLES : 0;
+    
+    memcpy(_header.magic, "FSGK", 4);
+    _header.version = BLACK_BOX_VERSION;
+    _header.header_size = sizeof(BlackBoxFileHeader);
+    _header.sample_size = sizeof(BlackBoxSample);
+    _header.sample_count = _write_end - _write_index;
+    _header.rate_hz = BLACK_BOX_RATE_HZ;
+    _header.trigger_index = (_trigger_head > _write_index) ? _trigger_head - _write_index : 0;
+    _header.reserved = 0;
+    _header.trigger_time_us_low = (uint32_t)_trigger_time_us;
+    _header.trigger_time_us_high = (uint32_t)(_trigger_time_us >> 32);
+    _header.trigger_epoch_seconds = mbedLogger().getWallTime(_trigger_time_us);
+    _header.crc = MbedLogger::calcCrc16((const uint8_t *)&_header, offsetof(BlackBoxFileHeader, crc));
+    
+    fwrite(&_header, sizeof(BlackBoxFileHeader), 1, _fp);
+}
+
+// one past the highest BBOX### on the file system
+int BlackBox::findNextFileNumber() {
+    int next_file = 0;
+    DIR *dir = opendir(_file_system_string.c_str());
+    struct dirent *dp;
+    
+    if (!dir)
+        return 0;
+    
+    while ( NULL != (dp = readdir( dir )) ) {
+        if (strncmp(dp->d_name, "BBOX", 4) == 0 and dp->d_name[4] >= '0' and dp->d_name[4] <= '9') {
+            int file_number = strtol(dp->d_name + 4, NULL, 10);
+            if (file_number + 1 > next_file)
+                next_file = file_number + 1;
+        }
+    }
+    
+    closedir(dir);
+    
+    return next_file;
+}
+
+void BlackBox::setTriggerMask(int trigger_mask) {
+    _trigger_mask = trigger_mask & BLACK_BOX_TRIGGER_ALL;
+}
+
+int BlackBox::getTriggerMask() {
+    return _trigger_mask;
+}
+
+void BlackBox::printStatus() {
+    const char * state_strings[] = {"ARMED", "TRIGGERED", "FROZEN (writing)"};
+    
+    serialPrint("\n\rBLACK BOX: %s, %d samples at %d Hz (%u recorded), trigger mask %d (1 emergency climb, 2 limit switch, 4 manual)\n\r",
+        state_strings[_state], BLACK_BOX_SAMPLES, BLACK_BOX_RATE_HZ, _head, _trigger_mask);
+    serialPrint("  files written: %u (last BBOX%03d.BIN), triggers ignored while busy: %u\n\r", _files_written, _file_number, _triggers_ignored);
+}
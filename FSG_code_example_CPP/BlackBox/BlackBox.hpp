@@ -0,0 +1,98 @@
+#ifndef BLACKBOX_HPP
+#define BLACKBOX_HPP
+
+#include "mbed.h"
+#include <string>
+using namespace std;
+
+#define BLACK_BOX_RATE_HZ       100     //sample() runs in the system ticker at 100 Hz
+#define BLACK_BOX_SAMPLES       256     //2.56 seconds, MUST be a power of two (256 x 52 bytes in the AHB SRAM)
+#define BLACK_BOX_POST_TRIGGER  50      //samples kept after the trigger (0.5 seconds)
+#define BLACK_BOX_WRITE_SAMPLES 20      //samples written to the file per persist() call (about 1 KB)
+#define BLACK_BOX_MAX_FILE      999     //BBOX000.BIN to BBOX999.BIN
+#define BLACK_BOX_VERSION       1
+
+//trigger causes (bit mask, setTriggerMask)
+#define BLACK_BOX_TRIGGER_EMERGENCY     0x01    //FSM entered EMERGENCY_CLIMB
+#define BLACK_BOX_TRIGGER_LIMIT_SWITCH  0x02    //BCE or battery limit switch hit outside of homing
+#define BLACK_BOX_TRIGGER_MANUAL        0x04    //keyboard (log file menu)
+#define BLACK_BOX_TRIGGER_ALL           0x07
+
+//one 100 Hz sample (positions, PID terms and commands are scaled like the binary log, see BlackBox::sample)
+struct BlackBoxSample {
+    uint32_t time_us;               // low word of systemClock (wraps every 71 minutes, the header has the full trigger time)
+    uint16_t adc[8];                // raw ADC channels 0-7
+    int16_t  bce_mm;                // filtered positions, mm x10
+    int16_t  batt_mm;
+    int16_t  bce_set_mm;            // set positions, mm x10
+    int16_t  batt_set_mm;
+    int16_t  depth_ft;              // outer loop positions, ft x10 and deg x10
+    int16_t  pitch_deg;
+    int16_t  bce_pid[3];            // error, integral, derivative terms x10
+    int16_t  batt_pid[3];
+    int16_t  bce_output;            // motor commands x1000
+    int16_t  batt_output;
+    uint8_t  state;                 // state machine state
+    uint8_t  switches;              // bit 0 BCE limit switch pressed, bit 1 battery limit switch pressed
+    uint16_t reserved;              // 52 bytes
+};
+
+//written once at the start of every BBOX###.BIN, then sample_count BlackBoxSamples (oldest first)
+struct BlackBoxFileHeader {
+    char     magic[4];              // "FSGK"
+    uint16_t version;               // BLACK_BOX_VERSION
+    uint16_t header_size;           // sizeof(BlackBoxFileHeader)
+    uint16_t sample_size;           // sizeof(BlackBoxSample)
+    uint16_t sample_count;
+    uint16_t rate_hz;               // BLACK_BOX_RATE_HZ
+    uint16_t trigger_index;         // sample taken right after the trigger
+    uint8_t  trigger_cause;         // BLACK_BOX_TRIGGER_...
+    uint8_t  trigger_state;         // state machine state at the trigger
+    uint16_t reserved;
+    uint32_t trigger_time_us_low;   // systemClock at the trigger
+    uint32_t trigger_time_us_high;
+    uint32_t trigger_epoch_seconds; // wall time at the trigger
+    uint16_t crc;                   // CRC16 of the bytes above
+};
+
+class BlackBox {
+public:
+    BlackBox(string file_system_input_string);
+    
+    void sample();                      //system ticker, 100 Hz
+    void trigger(int cause);            //freeze after BLACK_BOX_POST_TRIGGER more samples (safe from interrupts)
+    void persist();                     //main loop slack: write part of a frozen buffer, re-arms when it is all written
+    
+    void setTriggerMask(int trigger_mask);
+    int getTriggerMask();
+    void printStatus();
+    
+private:
+    enum {
+        BLACK_BOX_ARMED,                //recording, waiting for a trigger
+        BLACK_BOX_TRIGGERED,            //recording the post trigger samples
+        BLACK_BOX_FROZEN                //waiting for persist() to write it
+    };
+    
+    void openFile();
+    int findNextFileNumber();
+    
+    string _file_system_string;
+    FILE *_fp;
+    
+    volatile int _state;
+    volatile unsigned int _head;        //free running sample counter (index is _head & (BLACK_BOX_SAMPLES - 1))
+    volatile int _post_trigger_remaining;
+    int _trigger_mask;
+    
+    BlackBoxFileHeader _header;         //filled in at the trigger
+    unsigned int _trigger_head;
+    uint64_t _trigger_time_us;
+    unsigned int _write_index;          //next sample to write (free running, like _head)
+    unsigned int _write_end;
+    int _file_number;                   //last BBOX### written (-1 before the first)
+    unsigned int _files_written;
+    unsigned int _triggers_ignored;     //triggers while one was already being captured/written
+};
+
+#endif
@@ -0,0 +1,221 @@
+/*******************************************************************************
+Title:            DiveStatistics.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+Running statistics for the current dive so the operator gets a go/no-go answer
+without downloading the log: depth, pitch, system current and voltage (min, max,
+mean and standard deviation), energy used, time in each state and how many
+times each state was entered.
+
+update() runs every FSM tick (10 Hz) and is O(1), the mean and variance are
+updated one sample at a time (Welford) so nothing is stored per sample.  A dive
+starts when the FSM leaves SIT_IDLE and the numbers stop when it goes back, so
+the last dive can still be asked for at the surface.
+
+The state machine prints the summary and appends it to DIVES.TXT when it gets
+to FLOAT_BROADCAST.  Keyboard 'K' sends it as one 81 byte packet.
+
+*******************************************************************************/
+
+#include "DiveStatistics.hpp"
+#include "StaticDefs.hpp"
+
+// high byte first, like the packet numbers
+static int putUint16(uint8_t * buffer, unsigned int value) {
+    if (value > 65535)
+        value = 65535;
+    
+    buffer[0] = (value >> 8) & 0xFF;
+    buffer[1] = value & 0xFF;
+    return 2;
+}
+
+static int putInt16(uint8_t * buffer, int16_t value) {
+    return putUint16(buffer, (uint16_t)value);
+}
+
+static int putUint32(uint8_t * buffer, uint32_t value) {
+    buffer[0] = (value >> 24) & 0xFF;
+    buffer[1] = (value >> 16) & 0xFF;
+    buffer[2] = (value >> 8) & 0xFF;
+    buffer[3] = value & 0xFF;
+    return 4;
+}
+
+DiveStatistics::DiveStatistics() {
+    _dive_number = 0;
+    _diving = false;
+    _last_state = SIT_IDLE;
+    
+    reset();
+}
+
+void DiveStatistics::reset() {
+    _start_time_us = systemClock().read_us();
+    _last_time_us = _start_time_us;
+    
+    memset(&_depth, 0, sizeof(_depth));
+    memset(&_pitch, 0, sizeof(_pitch));
+    memset(&_current, 0, sizeof(_current));
+    memset(&_voltage, 0, sizeof(_voltage));
+    _energy_joules = 0;
+    
+    for (int i = 0; i < DIVE_STATS_NUM_STATES; i++) {
+        _state_time_us[i] = 0;
+        _state_entries[i] = 0;
+    }
+    _transitions = 0;
+}
+
+void DiveStatistics::addSample(RunningStat & stat, float value) {
+    if (value != value)         //NaN (sensor not read yet)
+        return;
+    
+    stat.count++;
+    
+    if (stat.count == 1 or value < stat.min)
+        stat.min = value;
+    if (stat.count == 1 or value > stat.max)
+        stat.max = value;
+    
+    float delta = value - stat.mean;
+    stat.mean += delta / stat.count;
+    stat.m2 += delta * (value - stat.mean);
+}
+
+float DiveStatistics::getStandardDeviation(const RunningStat & stat) {
+    if (stat.count < 2)
+        return 0;
+    
+    return sqrt(stat.m2 / (stat.count - 1));
+}
+
+void DiveStatistics::update(int state) {
+    bool idle = (state == SIT_IDLE or state == KEYBOARD);
+    uint64_t time_us = systemClock().read_us();
+    
+    if (!_diving) {
+        if (idle)
+            return;
+        
+        //FSM left SIT_IDLE, new dive
+        _dive_number++;
+        _diving = true;
+        reset();
+        _last_state = state;
+        _state_entries[state % DIVE_STATS_NUM_STATES]++;
+    }
+    
+    //the time since the last tick was spent in the last state
+    _state_time_us[_last_state % DIVE_STATS_NUM_STATES] += time_us - _last_time_us;
+    
+    float volts = sensors().getVoltageInput();
+    float amps = sensors().getCurrentInput();
+    _energy_joules += volts * amps * ((time_us - _last_time_us) / 1000000.0);
+    _last_time_us = time_us;
+    
+    if (idle) {
+        _diving = false;        //keep the numbers for the surface
+        return;
+    }
+    
+    if (state != _last_state) {
+        _transitions++;
+        _state_entries[state % DIVE_STATS_NUM_STATES]++;
+        _last_state = state;
+    }
+    
+    addSample(_depth, depthLoop().getPosition());
+    addSample(_pitch, pitchLoop().getPosition());
+    addSample(_current, amps);
+    addSample(_voltage, volts);
+}
+
+int DiveStatistics::getDiveNumber() {
+    return _dive_number;
+}
+
+float DiveStatistics::getDuration() {
+    return (_last_time_us - _start_time_us) / 1000000.0;
+}
+
+void DiveStatistics::printSummary() {
+    serialPrint("\n\rDIVE %d SUMMARY (%0.1f s, %u transitions):\n\r", _dive_number, getDuration(), _transitions);
+    serialPrint("  depth   max %7.2f ft   mean %7.2f ft   std %6.2f\n\r", _depth.max, _depth.mean, getStandardDeviation(_depth));
+    serialPrint("  pitch   min %7.2f deg  max %7.2f deg  mean %7.2f deg  std %6.2f\n\r", _pitch.min, _pitch.max, _pitch.mean, getStandardDeviation(_pitch));
+    serialPrint("  current mean %6.3f A  max %6.3f A   voltage min %6.2f V   energy %0.1f J (%0.3f Wh)\n\r", _current.mean, _current.max, _voltage.min, _energy_joules, _energy_joules / 3600.0);
+    
+    for (int i = 0; i < DIVE_STATS_NUM_STATES; i++) {
+        if (_state_entries[i] > 0) {
+            serialPrint("  state %2d (%s) %8.1f s  entered %u\n\r", i, mbedLogger().getStateString(i), _state_time_us[i] / 1000000.0, _state_entries[i]);
+        }
+    }
+}
+
+// dive,start,duration,max depth,mean depth,min pitch,max pitch,mean pitch,std pitch,mean amps,max amps,min volts,joules,transitions,
+// then seconds in state 0 to 15 and entries of state 0 to 15
+void DiveStatistics::writeSummary(const char * file_name) {
+    FILE *fp = fopen(file_name, "a");
+    
+    if (!fp) {
+        TRACE(TRACE_LOG, TRACE_ERROR, "DiveStatistics: could not open %s\n\r", file_name);
+        return;
+    }
+    
+    fprintf(fp, "%d,%u,%.1f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f,%.2f,%.1f,%u", _dive_number,
+        mbedLogger().getWallTime(_start_time_us), getDuration(), _depth.max, _depth.mean, _pitch.min, _pitch.max,
+        _pitch.mean, getStandardDeviation(_pitch), _current.mean, _current.max, _voltage.min, _energy_joules, _transitions);
+    
+    for (int i = 0; i < DIVE_STATS_NUM_STATES; i++)
+        fprintf(fp, ",%.1f", _state_time_us[i] / 1000000.0);
+    for (int i = 0; i < DIVE_STATS_NUM_STATES; i++)
+        fprintf(fp, ",%u", _state_entries[i]);
+    
+    fprintf(fp, "\n");
+    fclose(fp);
+}
+
+// 0x75 0x73 ('s'), payload length, payload, CRC16 of everything before it (same CRC as the data packets)
+// payload (high byte first): dive number, seconds, max/mean depth (ft x10), min/max/mean/std pitch (deg x10),
+// mean/max amps (x1000), min volts (x100), joules (4 bytes), transitions, seconds in each state (16 x 2), entries (16 x 1)
+int DiveStatistics::fillSummaryPacket(uint8_t * packet) {
+    int length = 0;
+    
+    packet[length++] = 0x75;
+    packet[length++] = 0x73;
+    packet[length++] = DIVE_SUMMARY_PAYLOAD;
+    
+    length += putUint16(packet + length, _dive_number);
+    length += putUint16(packet + length, (unsigned int)getDuration());
+    length += putInt16(packet + length, scaleToInt16(_depth.max, 1));
+    length += putInt16(packet + length, scaleToInt16(_depth.mean, 1));
+    length += putInt16(packet + length, scaleToInt16(_pitch.min, 1));
+    length += putInt16(packet + length, scaleToInt16(_pitch.max, 1));
+    length += putInt16(packet + length, scaleToInt16(_pitch.mean, 1));
+    length += putInt16(packet + length, scaleToInt16(getStandardDeviation(_pitch), 1));
+    length += putInt16(packet + length, scaleToInt16(_current.mean, 3));
+    length += putInt16(packet + length, scaleToInt16(_current.max, 3));
+    length += putInt16(packet + length, scaleToInt16(_voltage.min, 2));
+    length += putUint32(packet + length, (uint32_t)_energy_joules);
+    length += putUint16(packet + length, _transitions);
+    
+    for (int i = 0; i < DIVE_STATS_NUM_STATES; i++)
+        length += putUint16(packet + length, (unsigned int)(_state_time_us[i] / 1000000));
+    for (int i = 0; i < DIVE_STATS_NUM_STATES; i++)
+        packet[length++] = (_state_entries[i] > 255) ? 255 : _state_entries[i];
+    
+    int crc = MbedLogger::calcCrc16(packet, length);
+    packet[length++] = crc / 256;
+    packet[length++] = crc % 256;
+    
+    return length;
+}
+
+void DiveStatistics::transmitSummaryPacket() {
+    uint8_t packet[DIVE_SUMMARY_PACKET_SIZE];
+    int length = fillSummaryPacket(packet);
+    
+    xbee().write(packet, length);
+}
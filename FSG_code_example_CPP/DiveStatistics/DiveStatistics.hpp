@@ -0,0 +1,55 @@
+#ifndef DIVESTATISTICS_HPP
+#define DIVESTATISTICS_HPP
+
+#include "mbed.h"
+
+#define DIVE_STATS_NUM_STATES       16      //SIT_IDLE to MANUAL_TUNING (StateMachine.hpp)
+#define DIVE_SUMMARY_PAYLOAD        76      //bytes of summary in the 0x75 0x73 packet (see fillSummaryPacket)
+#define DIVE_SUMMARY_PACKET_SIZE    (3 + DIVE_SUMMARY_PAYLOAD + 2)     //header, length, payload, CRC16
+
+//min/max/mean/variance of one signal, updated one sample at a time (Welford)
+struct RunningStat {
+    unsigned int count;
+    float min;
+    float max;
+    float mean;
+    float m2;                       //sum of squared differences from the mean
+};
+
+class DiveStatistics {
+public:
+    DiveStatistics();
+    
+    void update(int state);         //every FSM tick, starts a new dive when the FSM leaves SIT_IDLE
+    void reset();                   //start of a dive
+    
+    void printSummary();
+    void writeSummary(const char * file_name);      //append one line (DIVES.TXT)
+    int fillSummaryPacket(uint8_t * packet);        //needs DIVE_SUMMARY_PACKET_SIZE bytes, returns the length
+    void transmitSummaryPacket();
+    
+    int getDiveNumber();
+    float getDuration();            //seconds since the dive started
+    
+private:
+    void addSample(RunningStat & stat, float value);
+    float getStandardDeviation(const RunningStat & stat);
+    
+    int _dive_number;               //dives since power up (0 before the first)
+    bool _diving;                   //false while the FSM sits idle
+    int _last_state;
+    uint64_t _start_time_us;
+    uint64_t _last_time_us;
+    
+    RunningStat _depth;             //ft
+    RunningStat _pitch;             //deg
+    RunningStat _current;           //system amps
+    RunningStat _voltage;           //system volts
+    double _energy_joules;          //volts * amps * seconds
+    
+    uint64_t _state_time_us[DIVE_STATS_NUM_STATES];
+    unsigned int _state_entries[DIVE_STATS_NUM_STATES];
+    unsigned int _transitions;
+};
+
+#endif
@@ -70,12 +70,11 @@ int Gui::calcCrcTwoVector(vector <int> crc_packet) {
 }
 
 void Gui::transmitDataPacket(vector <int> full_packet) {
-    std::vector<int>::iterator itr;
+    //transmit full packet, the integers as bytes in one write to the TX buffer
+    vector <uint8_t> bytes(full_packet.begin(), full_packet.end());
     
-    //transmit full packet
-    for (itr = full_packet.begin(); itr < full_packet.end(); itr++) {
-        xbee().putc(*itr); //send integers over serial port one byte at a time
-    }
+    if (!bytes.empty())
+        xbee().write(&bytes[0], bytes.size());
 }
 
 // get command one byte at a time
@@ -204,25 +203,17 @@ void Gui::getCommandFSM() {
 //remove class vector?
 
 void Gui::updateGUI() {
-    float roll_value = imu().getRoll();
-    float pitch_value = imu().getPitch();
-    float heading_value = imu().getHeading();
-    float depth_value = depthLoop().getPosition(); //filtered depth position
-    float timer_value = stateMachine().getTimerValue();
+    float value[TELEMETRY_NUM_GUI_FIELDS];
     
-    xbee().printf("roll %0.2f / pitch %0.2f / heading %0.2f / depth %0.2f / timer %0.2f\n\r", roll_value, pitch_value, heading_value, depth_value, timer_value);
+    for (int i = 0; i < TELEMETRY_NUM_GUI_FIELDS; i++) {
+        value[i] = telemetry_gui_fields[i].getter();
+        xbee().printf("%s %0.*f / ", telemetry_gui_fields[i].name, telemetry_gui_fields[i].decimals, value[i]);
+    }
+    xbee().printf("\n\r");
     
     vector <int> gui_update_packet;
     
-    //ROLL PITCH HEADING(YAW) DEPTH TIMER (sending all at once, at one second intervals)
-    
-    //take float value, convert to unsigned char, reverse and send
-    const unsigned char * ptr_roll_value = reinterpret_cast<const unsigned char*>(&roll_value);
-    const unsigned char * ptr_pitch_value = reinterpret_cast<const unsigned char*>(&pitch_value);
-    const unsigned char * ptr_heading_value = reinterpret_cast<const unsigned char*>(&heading_value);
-    const unsigned char * ptr_depth_value = reinterpret_cast<const unsigned char*>(&depth_value);
-    const unsigned char * ptr_timer_value = reinterpret_cast<const unsigned char*>(&timer_value);
-    //xbee().printf("DEBUG: timer_value is %f or HEX: %x %x %x %x\n\r",timer_value,ptr_timer_value[3],ptr_timer_value[2],ptr_timer_value[1],ptr_timer_value[0]);
+    //ROLL PITCH HEADING(YAW) DEPTH TIMER (sending all at once, at one second intervals), see telemetry_gui_fields
     
     // BE AD GUI GUI LENGTH DATA DATA CC CC
     
@@ -235,32 +226,17 @@ void Gui::updateGUI() {
     gui_update_packet.push_back(204);  // 0xCC 
     gui_update_packet.push_back(204);  // 0xCC
     
-    gui_update_packet.push_back(20);  // 0x14 (length)
-    
-    gui_update_packet.push_back(ptr_roll_value[3]);
-    gui_update_packet.push_back(ptr_roll_value[2]);
-    gui_update_packet.push_back(ptr_roll_value[1]);
-    gui_update_packet.push_back(ptr_roll_value[0]);
+    gui_update_packet.push_back(4 * TELEMETRY_NUM_GUI_FIELDS);  // 0x14 (length)
     
-    gui_update_packet.push_back(ptr_pitch_value[3]);
-    gui_update_packet.push_back(ptr_pitch_value[2]);
-    gui_update_packet.push_back(ptr_pitch_value[1]);
-    gui_update_packet.push_back(ptr_pitch_value[0]);
-    
-    gui_update_packet.push_back(ptr_heading_value[3]);
-    gui_update_packet.push_back(ptr_heading_value[2]);
-    gui_update_packet.push_back(ptr_heading_value[1]);
-    gui_update_packet.push_back(ptr_heading_value[0]);
-    
-    gui_update_packet.push_back(ptr_depth_value[3]);
-    gui_update_packet.push_back(ptr_depth_value[2]);
-    gui_update_packet.push_back(ptr_depth_value[1]);
-    gui_update_packet.push_back(ptr_depth_value[0]);
-    
-    gui_update_packet.push_back(ptr_timer_value[3]);
-    gui_update_packet.push_back(ptr_timer_value[2]);
-    gui_update_packet.push_back(ptr_timer_value[1]);
-    gui_update_packet.push_back(ptr_timer_value[0]);
+    //take float value, convert to unsigned char, reverse and send
+    for (int i = 0; i < TELEMETRY_NUM_GUI_FIELDS; i++) {
+        const unsigned char * ptr_value = reinterpret_cast<const unsigned char*>(&value[i]);
+        
+        gui_update_packet.push_back(ptr_value[3]);
+        gui_update_packet.push_back(ptr_value[2]);
+        gui_update_packet.push_back(ptr_value[1]);
+        gui_update_packet.push_back(ptr_value[0]);
+    }
     
     //CRC CALCULATION
     int crc_one = calcCrcOneVector(gui_update_packet);
@@ -40,6 +40,7 @@ LinearActuator::LinearActuator(float interval, PinName pwm, PinName dir, PinName
  
     _init = true;
     _paused = false;
+    _homing = false;
     
     _slope = 498.729/4096;  //this value should be correct for our current string pots using .625" diameter and 12 bit ADC (hardcoded in config as 0.12176)
     _deadband = 0.5;
@@ -267,6 +268,9 @@ float LinearActuator::counts_to_velocity(int count) {
 //Stop motor immediately when limit switch pressed.
 void LinearActuator::switchPressed() {
     _motor.stop();
+    
+    if (!_homing)
+        blackBox().trigger(BLACK_BOX_TRIGGER_LIMIT_SWITCH);
 }
  
 void LinearActuator::homePiston() {
@@ -279,6 +283,7 @@ void LinearActuator::homePiston() {
     //unpause the motor (activate it)
     unpause();
     
+    _homing = true;
     _motor.run(-0.5);
     
     xbee().printf("HOMING SEQUENCE ENGAGED. Press \"X\" to exit!\n\r");
@@ -323,6 +328,8 @@ void LinearActuator::homePiston() {
             }
         }
     }
+    
+    _homing = false;
 }
  
 bool LinearActuator::getHardwareSwitchStatus() {
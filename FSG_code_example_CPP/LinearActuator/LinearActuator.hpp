@@ -89,6 +89,7 @@ protected:
     
     bool _init;
     bool _paused;
+    bool _homing;                       //limit switch hits are expected (no black box trigger)
     
     int _adc_channel;
     
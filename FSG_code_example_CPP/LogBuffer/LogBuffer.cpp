@@ -0,0 +1,96 @@
+/*******************************************************************************
+Title:            LogBuffer.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+Single producer, single consumer ring buffer of log records held in RAM.
+
+The logging loop pushes one record per sample (just a copy, no file I/O) and
+MbedLogger::drainLogBuffer() writes them to the file system later, between
+state machine ticks.  If the file system falls behind and the buffer fills up
+the newest record is dropped and counted, the control loop never waits.
+
+The producer only writes _head and the consumer only writes _tail, so no
+interrupt masking is needed as long as each side stays in one context.
+
+*******************************************************************************/
+
+#include "LogBuffer.hpp"
+
+LogBuffer::LogBuffer() {
+    _head = 0;
+    _tail = 0;
+    
+    resetCounters();
+}
+
+bool LogBuffer::push(const BinaryLogRecord & record) {
+    unsigned int count = _head - _tail;
+    
+    if (count >= LOG_BUFFER_SIZE) {
+        _drop_count++;
+        
+        //count each time the buffer fills, not every record lost while it is full
+        if (!_overflowing) {
+            _overflow_count++;
+            _overflowing = true;
+        }
+        return false;
+    }
+    
+    _records[_head & (LOG_BUFFER_SIZE - 1)] = record;
+    _head = _head + 1;      //publish after the copy is complete
+    
+    _push_count++;
+    _overflowing = false;
+    
+    if ((int)(count + 1) > _high_water_mark)
+        _high_water_mark = count + 1;
+    
+    return true;
+}
+
+BinaryLogRecord * LogBuffer::front() {
+    if (_head == _tail)
+        return NULL;
+    
+    return &_records[_tail & (LOG_BUFFER_SIZE - 1)];
+}
+
+void LogBuffer::pop() {
+    if (_head != _tail)
+        _tail = _tail + 1;
+}
+
+void LogBuffer::clear() {
+    _tail = _head;
+}
+
+int LogBuffer::getCount() {
+    return _head - _tail;
+}
+
+unsigned int LogBuffer::getPushCount() {
+    return _push_count;
+}
+
+unsigned int LogBuffer::getDropCount() {
+    return _drop_count;
+}
+
+unsigned int LogBuffer::getOverflowCount() {
+    return _overflow_count;
+}
+
+int LogBuffer::getHighWaterMark() {
+    return _high_water_mark;
+}
+
+void LogBuffer::resetCounters() {
+    _push_count = 0;
+    _drop_count = 0;
+    _overflow_count = 0;
+    _overflowing = false;
+    _high_water_mark = 0;
+}
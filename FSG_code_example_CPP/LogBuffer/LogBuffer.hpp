@@ -0,0 +1,43 @@
+#ifndef LOGBUFFER_HPP
+#define LOGBUFFER_HPP
+
+#include "mbed.h"
+#include "LogRecord.hpp"
+
+#define LOG_BUFFER_SIZE     32      //number of records, MUST be a power of two (32 x 84 byte BinaryLogRecord, 2.6 KB)
+
+class LogBuffer {
+public:
+    LogBuffer();
+    
+    //producer side (the logging loop)
+    bool push(const BinaryLogRecord & record);  //returns false (and counts a drop) if the buffer is full
+    
+    //consumer side (MbedLogger::drainLogBuffer)
+    BinaryLogRecord * front();                  //oldest record, NULL if empty (valid until pop)
+    void pop();
+    void clear();
+    
+    int getCount();
+    
+    unsigned int getPushCount();                //records accepted
+    unsigned int getDropCount();                //records thrown away because the buffer was full
+    unsigned int getOverflowCount();            //times the buffer filled up (one per overflow, not per record)
+    int getHighWaterMark();                     //most records waiting at once
+    void resetCounters();
+    
+private:
+    BinaryLogRecord _records[LOG_BUFFER_SIZE];
+    
+    //free running indices, _head is only written by the producer and _tail only by the consumer
+    volatile unsigned int _head;
+    volatile unsigned int _tail;
+    
+    unsigned int _push_count;
+    unsigned int _drop_count;
+    unsigned int _overflow_count;
+    bool _overflowing;
+    int _high_water_mark;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*******************************************************************************
+Title:            LogCompressor.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+LZSS compressor for blocks of fixed-width CSV log lines (compressed log
+download, see MbedLogger::transmitCompressedBlock).
+
+Output is groups of eight items, each group starts with a flag byte (bit 0 is
+the first item).  A clear bit is one literal byte, a set bit is a match of two
+bytes: distance - 1 in the top 12 bits, length - 3 in the low 4 bits.  Length
+code 15 is followed by one more byte that is added to it (18 to 273 bytes).
+
+Log lines are almost the same as the line above (state string, gains, zero
+padding), so the same column one and two lines up are tried before the one
+entry hash table.  No chains and no lazy matching, a block of eight lines
+takes well under a millisecond.
+
+The decoder is FSG_transmit_and_receive_GUI/receive_file_from_mbed (decompressBlock).
+
+*******************************************************************************/
+
+#include "LogCompressor.hpp"
+
+LogCompressor::LogCompressor() {
+    memset(_hash_head, 0, sizeof(_hash_head));
+}
+
+int LogCompressor::hash(const uint8_t * bytes) {
+    return ((bytes[0] << 8) ^ (bytes[1] << 4) ^ bytes[2]) & (LOG_COMPRESS_HASH_SIZE - 1);
+}
+
+int LogCompressor::matchLength(const uint8_t * input, int candidate, int position, int length) {
+    if (candidate < 0 or candidate >= position or position - candidate > LOG_COMPRESS_MAX_DISTANCE)
+        return 0;
+    
+    int match = 0;
+    while (position + match < length and match < LOG_COMPRESS_MAX_MATCH and input[candidate + match] == input[position + match])
+        match++;
+    
+    return match;
+}
+
+void LogCompressor::addHash(const uint8_t * input, int position, int length) {
+    if (position + 2 < length)
+        _hash_head[hash(input + position)] = position + 1;
+}
+
+int LogCompressor::compress(const uint8_t * input, int primer_length, int length, int line_length, uint8_t * output, int output_size) {
+    memset(_hash_head, 0, sizeof(_hash_head));
+    
+    for (int position = 0; position < primer_length; position++)
+        addHash(input, position, length);
+    
+    int output_length = 0;
+    int flag_index = 0;
+    int items = 8;
+    int position = primer_length;
+    
+    while (position < length) {
+        //flag byte and the largest item
+        if (output_length + 4 > output_size)
+            return -1;
+        
+        if (items == 8) {
+            flag_index = output_length;
+            output[output_length++] = 0;
+            items = 0;
+        }
+        
+        int best_length = 0;
+        int best_distance = 0;
+        int candidates[3];
+        candidates[0] = position - line_length;
+        candidates[1] = position - 2 * line_length;
+        candidates[2] = (position + 2 < length) ? _hash_head[hash(input + position)] - 1 : -1;
+        
+        for (int i = 0; i < 3; i++) {
+            int match = matchLength(input, candidates[i], position, length);
+            
+            if (match > best_length) {
+                best_length = match;
+                best_distance = position - candidates[i];
+            }
+        }
+        
+        if (best_length >= LOG_COMPRESS_MIN_MATCH) {
+            int code = best_length - LOG_COMPRESS_MIN_MATCH;
+            
+            output[flag_index] |= (1 << items);
+            output[output_length++] = (best_distance - 1) >> 4;
+            
+            if (code >= 15) {
+                output[output_length++] = ((best_distance - 1) << 4) | 15;
+                output[output_length++] = code - 15;
+            }
+            else {
+                output[output_length++] = ((best_distance - 1) << 4) | code;
+            }
+            
+            for (int i = 0; i < best_length; i++)
+                addHash(input, position + i, length);
+            
+            position += best_length;
+        }
+        else {
+            output[output_length++] = input[position];
+            addHash(input, position, length);
+            position++;
+        }
+        
+        items++;
+    }
+    
+    return output_length;
+}
@@ -0,0 +1,28 @@
+#ifndef LOGCOMPRESSOR_HPP
+#define LOGCOMPRESSOR_HPP
+
+#include "mbed.h"
+
+#define LOG_COMPRESS_HASH_SIZE      256     //hash table entries, MUST be a power of two (512 bytes)
+#define LOG_COMPRESS_MAX_DISTANCE   4096    //12 bit distance
+#define LOG_COMPRESS_MIN_MATCH      3
+#define LOG_COMPRESS_MAX_MATCH      273     //3 + 15 + 255 (length code 15 has an extra byte)
+
+class LogCompressor {
+public:
+    LogCompressor();
+    
+    //compress input[primer_length] to input[length - 1], the primer is history only (the decoder already has it)
+    //line_length is the fixed line stride, the same column one and two lines up are tried first
+    //returns the compressed length, -1 if it doesn't fit in output_size
+    int compress(const uint8_t * input, int primer_length, int length, int line_length, uint8_t * output, int output_size);
+    
+private:
+    int hash(const uint8_t * bytes);
+    int matchLength(const uint8_t * input, int candidate, int position, int length);
+    void addHash(const uint8_t * input, int position, int length);
+    
+    uint16_t _hash_head[LOG_COMPRESS_HASH_SIZE];    //last position + 1 with that hash, 0 for none
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*******************************************************************************
+Title:            LogFormat.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+Integer to text for the CSV log columns.  MbedLogger::formatCSVLine prints the
+record's scaled int16 fields with these instead of sprintf("%06.*f"): the
+digits, the decimal point and the padding are written straight into the line
+buffer, no float conversion (the M3 has no FPU and the float printf is slow
+and uses a lot of stack).  The characters are the same as the printf formats
+they replace, TESTS/host checks that against sprintf and times both.
+
+*******************************************************************************/
+
+#include "LogFormat.hpp"
+
+int putFixed(char * buffer, int32_t value, int width, int decimals, char pad) {
+    char digits[12];    //least significant first
+    int digit_count = 0;
+    uint32_t magnitude = (value < 0) ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+    
+    do {
+        digits[digit_count++] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    
+    //at least one digit in front of the decimal point
+    while (digit_count < decimals + 1)
+        digits[digit_count++] = '0';
+    
+    int length = digit_count + (decimals ? 1 : 0) + ((value < 0) ? 1 : 0);
+    int pad_count = (width > length) ? width - length : 0;
+    char * write = buffer;
+    
+    //the sign goes in front of zeros but after spaces
+    if (pad == ' ') {
+        while (pad_count--)
+            *write++ = ' ';
+    }
+    
+    if (value < 0)
+        *write++ = '-';
+    
+    if (pad == '0') {
+        while (pad_count-- > 0)
+            *write++ = '0';
+    }
+    
+    for (int i = digit_count - 1; i >= 0; i--) {
+        if (i == decimals - 1)
+            *write++ = '.';
+        
+        *write++ = digits[i];
+    }
+    
+    return write - buffer;
+}
+
+// -32768 is NaN (printf gives "nan" with spaces for %06.1f too)
+int putScaledInt16(char * buffer, int16_t value, int width, int decimals) {
+    if (value == -32768) {
+        int pad_count = width - 3;
+        
+        for (int i = 0; i < pad_count; i++)
+            buffer[i] = ' ';
+        
+        memcpy(buffer + (pad_count > 0 ? pad_count : 0), "nan", 3);
+        
+        return (pad_count > 0 ? pad_count : 0) + 3;
+    }
+    
+    return putFixed(buffer, value, width, decimals, '0');
+}
@@ -0,0 +1,13 @@
+#ifndef LOGFORMAT_HPP
+#define LOGFORMAT_HPP
+
+#include "mbed.h"
+
+//value / 10^decimals right justified in width characters, the same characters as printf("%0*.*f") (pad '0')
+//or printf("%*d") (pad ' ', no decimals), returns the length (no terminating zero)
+int putFixed(char * buffer, int32_t value, int width, int decimals, char pad);
+
+//putFixed for a scaleToInt16 value with '0' padding, -32768 (NaN) is "nan" with spaces in front like printf
+int putScaledInt16(char * buffer, int16_t value, int width, int decimals);
+
+#endif
@@ -0,0 +1,221 @@
+// putFixed/putScaledInt16 on the host against the sprintf formats MbedLogger::formatCSVLine used before them.
+// Checks every int16 field value at 0 to 3 decimals ("%0*.*f", -32768 is NaN), the St# ("%.2d") and TimeSec
+// ("%10d") columns, and random records printed as whole CSV lines both ways.  Any character that differs fails
+// the run.  Then times the two lines per record ("check" on the command line skips the timing).
+// Host numbers only compare the two ways of doing it, the LPC1768 is slower at both.
+#include "LogFormat.hpp"
+#include <math.h>
+#include <time.h>
+
+// the LOG_CSV_ layout in MbedLogger.hpp (32 fields, 254 characters without the newline)
+#define LOG_CSV_STATE_WIDTH         16
+#define LOG_CSV_STATE_NUMBER_WIDTH  2
+#define LOG_CSV_TIME_WIDTH          10
+#define LOG_CSV_FIELD_WIDTH         6
+#define LOG_CSV_LINE_LENGTH         254
+#define NUM_FIELDS                  32
+#define NUM_RECORDS                 20000
+
+static const double powers_of_ten[] = {1.0, 10.0, 100.0, 1000.0};
+
+struct Record {
+    uint8_t state;
+    int32_t time;
+    int16_t field[NUM_FIELDS];
+};
+
+static const char * const state_strings[] = {"SIT_IDLE", "FIND_NEUTRAL", "DIVE", "RISE", "FLOAT_LEVEL", "FLOAT_BROADCAST",
+    "EMERGENCY_CLIMB", "MULTI_DIVE", "MULTI_RISE", "KEYBOARD", "CHECK_TUNING", "POSITION_DIVE", "POSITION_RISE"};
+static const int num_state_strings = sizeof(state_strings) / sizeof(state_strings[0]);
+
+static int field_decimals[NUM_FIELDS];
+
+static double now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static unsigned rnd_state = 12345;
+static unsigned rnd() {
+    rnd_state = rnd_state * 1103515245u + 12345u;
+    return rnd_state >> 8;
+}
+
+// the line the old formatCSVLine printed
+static int sprintfLine(const Record & record, char * line_buffer) {
+    int length = sprintf(line_buffer, "%16s,%.2d,%10d", state_strings[record.state % num_state_strings], record.state, (int)record.time);
+    
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        double value = (record.field[i] == -32768) ? NAN : record.field[i] / powers_of_ten[field_decimals[i]];
+        length += sprintf(line_buffer + length, ",%0*.*f", LOG_CSV_FIELD_WIDTH, field_decimals[i], value);
+    }
+    
+    line_buffer[length++] = '\n';
+    line_buffer[length] = 0;
+    
+    return length;
+}
+
+// the line formatCSVLine prints now, same steps
+static int putFixedLine(const Record & record, char * line_buffer) {
+    const char * state_string = state_strings[record.state % num_state_strings];
+    int state_length = strlen(state_string);
+    int length = (state_length < LOG_CSV_STATE_WIDTH) ? LOG_CSV_STATE_WIDTH - state_length : 0;
+    
+    memset(line_buffer, ' ', length);
+    memcpy(line_buffer + length, state_string, state_length);
+    length += state_length;
+    
+    line_buffer[length++] = ',';
+    length += putFixed(line_buffer + length, record.state, LOG_CSV_STATE_NUMBER_WIDTH, 0, '0');
+    line_buffer[length++] = ',';
+    length += putFixed(line_buffer + length, record.time, LOG_CSV_TIME_WIDTH, 0, ' ');
+    
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        line_buffer[length++] = ',';
+        length += putScaledInt16(line_buffer + length, record.field[i], LOG_CSV_FIELD_WIDTH, field_decimals[i]);
+    }
+    
+    line_buffer[length++] = '\n';
+    line_buffer[length] = 0;
+    
+    return length;
+}
+
+static int mismatch(const char * what, const char * got, int got_length, const char * expected, int shown) {
+    if (shown < 5)
+        printf("  %s: putFixed \"%.*s\" sprintf \"%s\"\n", what, got_length, got, expected);
+    
+    return 1;
+}
+
+static int checkFields() {
+    char got[40], expected[40];
+    int bad = 0;
+    
+    for (int decimals = 0; decimals < 4; decimals++) {
+        for (int value = -32768; value <= 32767; value++) {
+            int length = putScaledInt16(got, (int16_t)value, LOG_CSV_FIELD_WIDTH, decimals);
+            double expected_value = (value == -32768) ? NAN : value / powers_of_ten[decimals];
+            int expected_length = sprintf(expected, "%0*.*f", LOG_CSV_FIELD_WIDTH, decimals, expected_value);
+            
+            if (length != expected_length or memcmp(got, expected, length))
+                bad += mismatch("field", got, length, expected, bad);
+        }
+    }
+    
+    for (int state = 0; state < 256; state++) {
+        int length = putFixed(got, state, LOG_CSV_STATE_NUMBER_WIDTH, 0, '0');
+        int expected_length = sprintf(expected, "%.2d", state);
+        
+        if (length != expected_length or memcmp(got, expected, length))
+            bad += mismatch("St#", got, length, expected, bad);
+    }
+    
+    const int32_t times[] = {0, 1, -1, 9, 10, -10, 12345, -12345, 999999999, 1000000000, 1551154422, -2147483647 - 1, 2147483647};
+    
+    for (unsigned i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+        int length = putFixed(got, times[i], LOG_CSV_TIME_WIDTH, 0, ' ');
+        int expected_length = sprintf(expected, "%10d", (int)times[i]);
+        
+        if (length != expected_length or memcmp(got, expected, length))
+            bad += mismatch("TimeSec", got, length, expected, bad);
+    }
+    
+    printf("fields (4 x 65536 values), St# and TimeSec: %d mismatches\n", bad);
+    
+    return bad;
+}
+
+// any int16 (NaN included) in one field out of six, small negatives and positives in the rest
+static void randomRecords(Record * records, bool typical) {
+    for (int k = 0; k < NUM_RECORDS; k++) {
+        records[k].state = rnd() % num_state_strings;
+        records[k].time = 1551154422 + k;
+        
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            int kind = rnd() % 6;
+            
+            if (typical)
+                records[k].field[i] = (int16_t)((int)(rnd() % 4000) - 500);
+            else if (kind == 0)
+                records[k].field[i] = (int16_t)((int)(rnd() % 65536) - 32768);
+            else if (kind == 1)
+                records[k].field[i] = (int16_t)-(int)(rnd() % 3000);
+            else
+                records[k].field[i] = (int16_t)(rnd() % 3000);
+        }
+    }
+}
+
+static int checkLines(Record * records) {
+    char got[400], expected[400];
+    int bad = 0, full_length = 0;
+    
+    randomRecords(records, false);
+    
+    for (int k = 0; k < NUM_RECORDS; k++) {
+        int length = putFixedLine(records[k], got);
+        int expected_length = sprintfLine(records[k], expected);
+        
+        if (length != expected_length or memcmp(got, expected, length))
+            bad += mismatch("line", got, length, expected, bad);
+        
+        if (length == LOG_CSV_LINE_LENGTH + 1)
+            full_length++;
+    }
+    
+    printf("%d random CSV lines: %d mismatches, %d are %d characters + newline\n", NUM_RECORDS, bad, full_length, LOG_CSV_LINE_LENGTH);
+    
+    return bad;
+}
+
+static void timeLines(Record * records) {
+    char line_buffer[400];
+    volatile int total = 0;
+    const int reps = 10;
+    
+    randomRecords(records, true);
+    
+    //first pass warms the caches, the second is printed
+    for (int pass = 0; pass < 2; pass++) {
+        double t0 = now();
+        
+        for (int rep = 0; rep < reps; rep++)
+            for (int k = 0; k < NUM_RECORDS; k++)
+                total += sprintfLine(records[k], line_buffer);
+        
+        double t1 = now();
+        
+        for (int rep = 0; rep < reps; rep++)
+            for (int k = 0; k < NUM_RECORDS; k++)
+                total += putFixedLine(records[k], line_buffer);
+        
+        double t2 = now();
+        
+        if (pass)
+            printf("CSV line: sprintf %.2f us/record, putFixed %.2f us/record, %.1fx faster\n",
+                (t1 - t0) / NUM_RECORDS / reps * 1e6, (t2 - t1) / NUM_RECORDS / reps * 1e6, (t1 - t0) / (t2 - t1));
+    }
+}
+
+int main(int argc, char ** argv) {
+    static Record records[NUM_RECORDS];
+    
+    //0 to 3 decimals like telemetry_log_fields
+    for (int i = 0; i < NUM_FIELDS; i++)
+        field_decimals[i] = i % 4;
+    
+    int bad = checkFields() + checkLines(records);
+    
+    if (bad) {
+        printf("FAILED, putFixed/putScaledInt16 don't print the sprintf characters\n");
+        return 1;
+    }
+    
+    if (argc < 2 or strcmp(argv[1], "check"))
+        timeLines(records);
+    
+    return 0;
+}
@@ -0,0 +1,10 @@
+// Host build of LogFormat: the only parts of mbed.h it uses are the C headers.
+#ifndef STUB_MBED_H
+#define STUB_MBED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#endif
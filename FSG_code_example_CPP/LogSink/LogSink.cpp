@@ -0,0 +1,469 @@
+/*******************************************************************************
+Title:            LogSink.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+Extra destinations for the log (SD card, XBee, RAM ring).  MbedLogger formats
+each record once, writes the block to the MBED segment file like it always has
+and then hands the same bytes to every enabled sink with write().  write() only
+copies the bytes into the sink's own queue, the sink writes them out later in
+service() (main loop slack), at most service_bytes per call.  A slow or missing
+SD card therefore only fills the SD sink's queue, it never holds up the MBED
+file or the other sinks.
+
+Each chunk in the queue has a LogSinkChunk header in front of it (segment,
+format, flags, length) so a file sink opens and closes the same LOG### segments
+as the MBED log.  When a chunk doesn't fit the sink's policy decides: drop the
+new chunk (files) or drop the oldest chunks (radio, RAM ring).  A data chunk
+always leaves room for one close marker so the end of a dive is never lost.
+
+The SD card sink uses FatFs directly (stdio can't preallocate or trim a file).
+A segment file gets its clusters allocated up front when it is opened, so
+logging never grows the FAT cluster chain, and the log bytes are staged and
+written SD_LOG_WRITE_BYTES at a time at sector boundaries, which FatFs passes
+straight to the card as one multi-sector write (no read-modify-write of a
+partial sector).  Closing the file writes the last partial sector and cuts the
+unused preallocated space off again.
+
+*******************************************************************************/
+
+#include "LogSink.hpp"
+#include "StaticDefs.hpp"
+
+LogSink::LogSink(const char * name, char * queue, unsigned int queue_size, int policy, int service_bytes) {
+    _name = name;
+    _queue = queue;
+    _queue_size = queue_size;
+    _policy = policy;
+    _service_bytes = service_bytes;
+    _enabled = false;
+    _whole_segments = false;
+    _segment_started = false;
+    
+    _head = 0;
+    _tail = 0;
+    
+    memset(&_chunk, 0, sizeof(_chunk));
+    _chunk_remaining = 0;
+    _file_open = false;
+    _open_segment = -1;
+    _open_format = -1;
+    _close_queued = true;   //nothing open yet
+    
+    _high_water_mark = 0;
+    _bytes_written = 0;
+    _bytes_dropped = 0;
+    _chunks_dropped = 0;
+    _error_count = 0;
+    _max_service_us = 0;
+}
+
+bool LogSink::write(int segment, int log_format, int flags, const char * bytes, int length) {
+    if (!_enabled)
+        return false;
+    
+    //a file sink turned on in the middle of a segment (or that lost the start of one) waits for the next one
+    if (flags & LOG_SINK_NEW_SEGMENT)
+        _segment_started = false;
+    else if (_whole_segments and !_segment_started)
+        return false;
+    
+    //always leave room for the close marker that ends the segment
+    unsigned int needed = LOG_SINK_CHUNK_HEADER + length + LOG_SINK_CHUNK_HEADER;
+    
+    if (needed > _queue_size) {
+        _bytes_dropped += length;
+        _chunks_dropped++;
+        return false;
+    }
+    
+    if (_policy == LOG_SINK_DROP_OLDEST) {
+        while (_queue_size - getQueueCount() < needed)
+            dropOldestChunk();
+    }
+    else if (_queue_size - getQueueCount() < needed) {
+        _bytes_dropped += length;
+        _chunks_dropped++;
+        return false;
+    }
+    
+    LogSinkChunk chunk;
+    chunk.segment = segment;
+    chunk.log_format = log_format;
+    chunk.flags = flags;
+    chunk.length = length;
+    
+    const char * header = (const char *)&chunk;
+    
+    for (int i = 0; i < LOG_SINK_CHUNK_HEADER; i++)
+        _queue[(_head + i) & (_queue_size - 1)] = header[i];
+    
+    for (int i = 0; i < length; i++)
+        _queue[(_head + LOG_SINK_CHUNK_HEADER + i) & (_queue_size - 1)] = bytes[i];
+    
+    _head += LOG_SINK_CHUNK_HEADER + length;
+    _close_queued = false;
+    
+    if (flags & LOG_SINK_NEW_SEGMENT)
+        _segment_started = true;
+    
+    if (getQueueCount() > _high_water_mark)
+        _high_water_mark = getQueueCount();
+    
+    return true;
+}
+
+void LogSink::closeSegment() {
+    if (!_enabled or _close_queued)
+        return;
+    
+    //write() kept room for this unless the oldest chunks can be dropped
+    while (_queue_size - getQueueCount() < LOG_SINK_CHUNK_HEADER)
+        dropOldestChunk();
+    
+    LogSinkChunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.flags = LOG_SINK_CLOSE;
+    
+    const char * header = (const char *)&chunk;
+    
+    for (int i = 0; i < LOG_SINK_CHUNK_HEADER; i++)
+        _queue[(_head + i) & (_queue_size - 1)] = header[i];
+    
+    _head += LOG_SINK_CHUNK_HEADER;
+    _close_queued = true;
+}
+
+void LogSink::service() {
+    if (!_enabled or _service_bytes == 0)
+        return;
+    
+    unsigned int start_us = us_ticker_read();
+    int budget = _service_bytes;
+    
+    while (budget > 0) {
+        //start the next chunk
+        if (_chunk_remaining == 0) {
+            if (getQueueCount() < LOG_SINK_CHUNK_HEADER)
+                break;  //nothing queued
+            
+            copyFromQueue(_tail, (char *)&_chunk, LOG_SINK_CHUNK_HEADER);
+            _tail += LOG_SINK_CHUNK_HEADER;
+            
+            if (_chunk.flags & LOG_SINK_CLOSE) {
+                if (_file_open)
+                    closeSegmentFile();
+                _file_open = false;
+                continue;
+            }
+            
+            _chunk_remaining = _chunk.length;
+            
+            //new segment (or the same one again after a close)
+            if (!_file_open or (_chunk.flags & LOG_SINK_NEW_SEGMENT) or _chunk.segment != _open_segment or _chunk.log_format != _open_format) {
+                if (_file_open)
+                    closeSegmentFile();
+                
+                _file_open = openSegmentFile(_chunk.segment, _chunk.log_format, _chunk.flags & LOG_SINK_NEW_SEGMENT);
+                _open_segment = _chunk.segment;
+                _open_format = _chunk.log_format;
+                
+                if (!_file_open) {
+                    //lose this chunk, one try per call so a missing card costs one open at a time
+                    _error_count++;
+                    _bytes_dropped += _chunk_remaining;
+                    _chunks_dropped++;
+                    _tail += _chunk_remaining;
+                    _chunk_remaining = 0;
+                    break;
+                }
+            }
+        }
+        
+        //the contiguous part of the chunk (up to the end of the queue array)
+        unsigned int position = _tail & (_queue_size - 1);
+        int length = _chunk_remaining;
+        
+        if (length > budget)
+            length = budget;
+        if (length > (int)(_queue_size - position))
+            length = _queue_size - position;
+        
+        int written = writeBytes(_queue + position, length);
+        
+        if (written < 0) {
+            //skip the rest of the chunk, the file is opened again for the next one
+            _error_count++;
+            _bytes_dropped += _chunk_remaining;
+            _tail += _chunk_remaining;
+            _chunk_remaining = 0;
+            closeSegmentFile();
+            _file_open = false;
+            break;
+        }
+        
+        if (written == 0)
+            break;  //sink is busy
+        
+        _tail += written;
+        _chunk_remaining -= written;
+        _bytes_written += written;
+        budget -= written;
+    }
+    
+    unsigned int service_us = us_ticker_read() - start_us;
+    if (service_us > _max_service_us)
+        _max_service_us = service_us;
+}
+
+void LogSink::setEnabled(bool enabled) {
+    if (enabled == _enabled)
+        return;
+    
+    if (!enabled)
+        emptyQueue();
+    
+    _enabled = enabled;
+    _segment_started = false;
+}
+
+bool LogSink::getEnabled() {
+    return _enabled;
+}
+
+const char * LogSink::getName() {
+    return _name;
+}
+
+void LogSink::printStatus() {
+    serialPrint("  %-6s %s, queued %u of %u bytes (max %u), written %u, dropped %u bytes in %u chunks, errors %u, slowest call %u us\n\r", _name, _enabled ? "ON " : "OFF", getQueueCount(), _queue_size, _high_water_mark, _bytes_written, _bytes_dropped, _chunks_dropped, _error_count, _max_service_us);
+}
+
+unsigned int LogSink::getQueueCount() {
+    return _head - _tail;
+}
+
+void LogSink::copyFromQueue(unsigned int position, char * bytes, int length) {
+    for (int i = 0; i < length; i++)
+        bytes[i] = _queue[(position + i) & (_queue_size - 1)];
+}
+
+// make room: the rest of the chunk being serviced goes first, then whole chunks
+void LogSink::dropOldestChunk() {
+    if (_chunk_remaining > 0) {
+        _tail += _chunk_remaining;
+        _bytes_dropped += _chunk_remaining;
+        _chunk_remaining = 0;
+    }
+    else {
+        LogSinkChunk chunk;
+        copyFromQueue(_tail, (char *)&chunk, LOG_SINK_CHUNK_HEADER);
+        _tail += LOG_SINK_CHUNK_HEADER + chunk.length;
+        _bytes_dropped += chunk.length;
+    }
+    
+    _chunks_dropped++;
+}
+
+void LogSink::emptyQueue() {
+    _tail = _head;
+    _chunk_remaining = 0;
+    _close_queued = true;
+    
+    if (_file_open)
+        closeSegmentFile();
+    _file_open = false;
+}
+
+SdLogSink::SdLogSink(const char * name, char * queue, unsigned int queue_size, char * sector_buffer)
+    : LogSink(name, queue, queue_size, LOG_SINK_DROP_NEWEST, LOG_SINK_FILE_BYTES) {
+    _whole_segments = true;
+    
+    memset(&_file, 0, sizeof(_file));
+    _sector_buffer = sector_buffer;
+    _buffered = 0;
+    _write_position = 0;
+    _allocated = 0;
+    _writes_since_sync = 0;
+    
+    _sector_writes = 0;
+    _preallocations = 0;
+    _max_write_us = 0;
+    _max_preallocate_us = 0;
+}
+
+void SdLogSink::printStatus() {
+    LogSink::printStatus();
+    serialPrint("         %u sector writes (%d bytes each, slowest %u us), %u preallocations (slowest %u us)\n\r", _sector_writes, SD_LOG_WRITE_BYTES, _max_write_us, _preallocations, _max_preallocate_us);
+}
+
+bool SdLogSink::openSegmentFile(int segment, int log_format, bool new_segment) {
+    string file_name_string = MbedLogger::getSegmentFileName(SD_LOG_FATFS_DRIVE, segment, log_format);
+    
+    if (f_open(&_file, file_name_string.c_str(), FA_READ | FA_WRITE | (new_segment ? FA_CREATE_ALWAYS : FA_OPEN_ALWAYS)) != FR_OK)
+        return false;
+    
+    //a segment that was closed (and trimmed) is appended to from the start of its last sector
+    uint32_t data_length = f_size(&_file);
+    
+    _write_position = data_length - (data_length % SD_LOG_SECTOR_BYTES);
+    _buffered = data_length - _write_position;
+    _allocated = data_length;
+    _writes_since_sync = 0;
+    
+    if (_buffered > 0) {
+        UINT bytes_read = 0;
+        
+        if (f_lseek(&_file, _write_position) != FR_OK or f_read(&_file, _sector_buffer, _buffered, &bytes_read) != FR_OK or (int)bytes_read != _buffered) {
+            f_close(&_file);
+            return false;
+        }
+    }
+    
+    if (!preallocate(data_length + SD_LOG_PREALLOCATE_BYTES)) {
+        f_close(&_file);
+        return false;
+    }
+    
+    return true;
+}
+
+int SdLogSink::writeBytes(const char * bytes, int length) {
+    if (length > SD_LOG_WRITE_BYTES - _buffered)
+        length = SD_LOG_WRITE_BYTES - _buffered;
+    
+    memcpy(_sector_buffer + _buffered, bytes, length);
+    _buffered += length;
+    
+    if (_buffered == SD_LOG_WRITE_BYTES and !writeSectors())
+        return -1;
+    
+    return length;
+}
+
+// the last partial sector, then the preallocated space after the data is freed again
+void SdLogSink::closeSegmentFile() {
+    UINT bytes_written = 0;
+    
+    if (_buffered > 0)
+        f_write(&_file, _sector_buffer, _buffered, &bytes_written);
+    
+    f_truncate(&_file);
+    f_close(&_file);
+    
+    _buffered = 0;
+}
+
+// allocate the clusters up to file_size now (FatFs grows a file opened for writing when it seeks past the end),
+// a full card just means the rest is allocated while writing like a normal file
+bool SdLogSink::preallocate(uint32_t file_size) {
+    unsigned int start_us = us_ticker_read();
+    
+    if (f_lseek(&_file, file_size) != FR_OK)
+        return false;
+    
+    _allocated = f_size(&_file);
+    _preallocations++;
+    
+    //back to where the next sectors go
+    if (f_lseek(&_file, _write_position) != FR_OK)
+        return false;
+    
+    unsigned int preallocate_us = us_ticker_read() - start_us;
+    if (preallocate_us > _max_preallocate_us)
+        _max_preallocate_us = preallocate_us;
+    
+    return true;
+}
+
+bool SdLogSink::writeSectors() {
+    //more than a segment (out of segment numbers), preallocate some more
+    if (_write_position + SD_LOG_WRITE_BYTES > _allocated and !preallocate(_write_position + SD_LOG_PREALLOCATE_BYTES))
+        return false;
+    
+    unsigned int start_us = us_ticker_read();
+    
+    UINT bytes_written = 0;
+    if (f_write(&_file, _sector_buffer, SD_LOG_WRITE_BYTES, &bytes_written) != FR_OK or bytes_written != SD_LOG_WRITE_BYTES)
+        return false;
+    
+    _write_position += SD_LOG_WRITE_BYTES;
+    _buffered = 0;
+    _sector_writes++;
+    
+    if (++_writes_since_sync >= SD_LOG_SYNC_WRITES) {
+        _writes_since_sync = 0;
+        f_sync(&_file);
+    }
+    
+    unsigned int write_us = us_ticker_read() - start_us;
+    if (write_us > _max_write_us)
+        _max_write_us = write_us;
+    
+    return true;
+}
+
+RadioLogSink::RadioLogSink(const char * name, char * queue, unsigned int queue_size)
+    : LogSink(name, queue, queue_size, LOG_SINK_DROP_OLDEST, LOG_SINK_FILE_BYTES) {
+}
+
+int RadioLogSink::writeBytes(const char * bytes, int length) {
+    //the XBee is carrying a log download or sequence upload, raw log bytes would land between its packets
+    //(the queue keeps the newest chunks until it is over)
+    if (mbedLogger().isTransferRunning())
+        return 0;
+    
+    int room = xbee().txBufferGetSize(0) - xbee().txBufferGetCount() - LOG_SINK_RADIO_RESERVE;
+    
+    if (room <= 0)
+        return 0;
+    
+    if (length > room)
+        length = room;
+    
+    //never waits on the radio, the rest stays queued for the next service
+    return xbee().writeNb((const uint8_t *)bytes, length);
+}
+
+// nothing is serviced (service_bytes 0), the queue just keeps the newest chunks
+RamLogSink::RamLogSink(const char * name, char * queue, unsigned int queue_size)
+    : LogSink(name, queue, queue_size, LOG_SINK_DROP_OLDEST, 0) {
+}
+
+int RamLogSink::writeBytes(const char * bytes, int length) {
+    return 0;
+}
+
+void RamLogSink::print() {
+    serialPrint("\n\rRAM LOG (%u bytes):\n\r", getQueueCount());
+    
+    unsigned int position = _tail;
+    
+    while (_head - position >= LOG_SINK_CHUNK_HEADER) {
+        LogSinkChunk chunk;
+        copyFromQueue(position, (char *)&chunk, LOG_SINK_CHUNK_HEADER);
+        position += LOG_SINK_CHUNK_HEADER;
+        
+        for (int i = 0; i < chunk.length; i++) {
+            char c;
+            copyFromQueue(position + i, &c, 1);
+            
+            if (chunk.log_format == LOG_FORMAT_BINARY) {
+                serialPrint("%02X%s", (uint8_t)c, ((i % 32) == 31) ? "\n\r" : " ");
+            }
+            else if (c == '\n') {
+                serialPrint("\n\r");
+            }
+            else {
+                serialPrint("%c", c);
+            }
+        }
+        
+        if (chunk.log_format == LOG_FORMAT_BINARY) {
+            serialPrint("\n\r");
+        }
+        
+        position += chunk.length;
+    }
+}
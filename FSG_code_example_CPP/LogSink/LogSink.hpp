@@ -0,0 +1,143 @@
+#ifndef LOGSINK_HPP
+#define LOGSINK_HPP
+
+#include "mbed.h"
+#include "ff.h"         //FatFs (FATFileSystem library), the SD card sink uses it directly
+#include <string>
+using namespace std;
+
+#define LOG_SINK_MAX_SINKS      4       //sinks MbedLogger can fan out to
+#define LOG_SINK_CHUNK_HEADER   6       //sizeof(LogSinkChunk)
+#define LOG_SINK_FILE_BYTES     512     //most bytes a file sink writes per service() call (one SD block)
+#define LOG_SINK_RADIO_RESERVE  64      //radio sink leaves this much of the XBee transmit buffer for the menus
+
+#define SD_LOG_FATFS_DRIVE      "0:/"   //FatFs drive of the SD card (the only FAT volume, LocalFileSystem isn't one)
+#define SD_LOG_SECTOR_BYTES     512
+#define SD_LOG_WRITE_BYTES      1024    //SD card writes are always two whole sectors at a sector boundary
+#define SD_LOG_PREALLOCATE_BYTES    266240  //260 KB, a full segment (LOG_SEGMENT_MAX_BYTES) and its last block
+#define SD_LOG_SYNC_WRITES      32      //update the directory entry every 32 KB (the data is safe if the power goes)
+
+//chunk flags
+#define LOG_SINK_NEW_SEGMENT    0x01    //first bytes of a segment (heading or file header), start the file over
+#define LOG_SINK_CLOSE          0x02    //no bytes, close the file once everything queued before it is written
+
+//what happens when a sink's queue can't take the next chunk
+enum {
+    LOG_SINK_DROP_NEWEST,               //keep what is queued, drop the new chunk (files: no holes in the middle)
+    LOG_SINK_DROP_OLDEST                //throw away the oldest chunks to make room (radio, RAM ring: newest data wins)
+};
+
+//queued in front of every chunk of log bytes
+struct LogSinkChunk {
+    uint16_t segment;               // LOG### the bytes belong to
+    uint8_t  log_format;            // LOG_FORMAT_CSV or LOG_FORMAT_BINARY
+    uint8_t  flags;                 // LOG_SINK_NEW_SEGMENT, LOG_SINK_CLOSE
+    uint16_t length;                // bytes after the header
+};
+
+class LogSink {
+public:
+    LogSink(const char * name, char * queue, unsigned int queue_size, int policy, int service_bytes);
+    virtual ~LogSink() {}
+    
+    bool write(int segment, int log_format, int flags, const char * bytes, int length);  //queue encoded log bytes (never waits)
+    void closeSegment();                //close the file after the bytes queued so far
+    void service();                     //main loop slack: pass at most service_bytes of the queue on
+    
+    void setEnabled(bool enabled);      //a disabled sink takes nothing and its queue is emptied
+    bool getEnabled();
+    const char * getName();
+    virtual void printStatus();
+    
+protected:
+    //the sink itself, service() calls these
+    virtual bool openSegmentFile(int segment, int log_format, bool new_segment) { return true; }
+    virtual int writeBytes(const char * bytes, int length) = 0;    //bytes taken (0 = busy, try later), -1 on an error
+    virtual void closeSegmentFile() {}
+    
+    unsigned int getQueueCount();
+    void copyFromQueue(unsigned int position, char * bytes, int length);   //position is a free running count like _tail
+    
+    unsigned int _head;             //bytes put in the queue (free running, only write() changes it)
+    unsigned int _tail;             //bytes taken out
+    unsigned int _queue_size;       //MUST be a power of two
+    bool _whole_segments;           //only start taking bytes at the start of a segment (files need the heading)
+    
+private:
+    void dropOldestChunk();
+    void emptyQueue();
+    
+    const char * _name;
+    char * _queue;
+    int _policy;
+    int _service_bytes;
+    bool _enabled;
+    
+    LogSinkChunk _chunk;            //chunk being serviced...
+    int _chunk_remaining;           //...and its bytes still in the queue
+    bool _file_open;
+    int _open_segment;
+    int _open_format;
+    bool _close_queued;             //don't queue a second close marker in a row
+    bool _segment_started;          //has had the start of the segment being logged
+    
+    unsigned int _high_water_mark;
+    unsigned int _bytes_written;
+    unsigned int _bytes_dropped;
+    unsigned int _chunks_dropped;
+    unsigned int _error_count;
+    unsigned int _max_service_us;   //slowest service() call
+};
+
+// segment files on the SD card, same names as the MBED log segments.  Each file is preallocated when it is
+// opened and written a whole number of sectors at a time, then trimmed to the data when it is closed.
+class SdLogSink : public LogSink {
+public:
+    SdLogSink(const char * name, char * queue, unsigned int queue_size, char * sector_buffer);
+    
+    void printStatus();
+    
+protected:
+    bool openSegmentFile(int segment, int log_format, bool new_segment);
+    int writeBytes(const char * bytes, int length);
+    void closeSegmentFile();
+    
+private:
+    bool preallocate(uint32_t file_size);
+    bool writeSectors();
+    
+    FIL _file;
+    char * _sector_buffer;          //SD_LOG_WRITE_BYTES waiting to be written...
+    int _buffered;
+    uint32_t _write_position;       //...at this file offset (always a multiple of SD_LOG_SECTOR_BYTES)
+    uint32_t _allocated;            //file size with the preallocated space
+    int _writes_since_sync;
+    
+    unsigned int _sector_writes;
+    unsigned int _preallocations;
+    unsigned int _max_write_us;     //slowest f_write
+    unsigned int _max_preallocate_us;
+};
+
+// live log over the XBee, only what fits in the MODSERIAL transmit buffer (never waits for the radio),
+// nothing while a log download or sequence upload has the XBee
+class RadioLogSink : public LogSink {
+public:
+    RadioLogSink(const char * name, char * queue, unsigned int queue_size);
+    
+protected:
+    int writeBytes(const char * bytes, int length);
+};
+
+// the newest log bytes kept in RAM (nothing is written anywhere, print() shows them)
+class RamLogSink : public LogSink {
+public:
+    RamLogSink(const char * name, char * queue, unsigned int queue_size);
+    
+    void print();                       //CSV lines as text, binary records as hex
+    
+protected:
+    int writeBytes(const char * bytes, int length);
+};
+
+#endif
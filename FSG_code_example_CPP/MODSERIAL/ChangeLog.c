@@ -1,4 +1,14 @@
 /* $Id:$
+1.34    17th October 2026
+    * TX and RX buffers are single producer/single consumer rings. buffer_in and
+      buffer_out run freely and only one side writes each, buffer_count is gone
+      and so are the __disable_irq() sections around it. Buffer sizes are
+      rounded up to a power of two so slots are found by masking.
+
+1.33    17th October 2026
+    * Added write()/writeNb() and read()/readNb() to move blocks of bytes
+      through the TX/RX buffers with at most two memcpy()s.
+
 1.32    12th October 2013
     * Improved claim documentation: http://mbed.org/questions/1817/Redirect-stdout-via-MODSERIAL-is-this-po/ by http://mbed.org/users/WiredHome/
 
@@ -32,14 +32,15 @@ MODSERIAL::flushBuffer(IrqType type)
     switch(type) {
         case TxIrq: DISABLE_TX_IRQ; break;
         case RxIrq: DISABLE_RX_IRQ; break;
+        default: break;
     }
     buffer_in[type]       = 0;
     buffer_out[type]      = 0;
-    buffer_count[type]    = 0;
     buffer_overflow[type] = 0;  
     switch(type) {
         case TxIrq: RESET_TX_FIFO; break;
         case RxIrq: RESET_RX_FIFO; break;
+        default: break;
     }
     MODSERIAL_IRQ_REG = irq_req;
 }
@@ -39,11 +39,12 @@ MODSERIAL::__getc(bool block)
     if (block) { while ( MODSERIAL_RX_BUFFER_EMPTY ) ; } // Blocks.
     else if ( MODSERIAL_RX_BUFFER_EMPTY ) return -1;
     
-    int c = buffer[RxIrq][buffer_out[RxIrq]];
-    buffer_out[RxIrq]++;
-    if (buffer_out[RxIrq] >= buffer_size[RxIrq]) {
-        buffer_out[RxIrq] = 0;
-    }
+    // We are the only writer of buffer_out and isr_rx() the only
+    // writer of buffer_in, so no IRQs need masking here. The byte
+    // is read before buffer_out moves past it.
+    uint32_t out = buffer_out[RxIrq];
+    int c = buffer[RxIrq][out & MODSERIAL_BUFFER_MASK(RxIrq)];
+    buffer_out[RxIrq] = out + 1;
     
     // If we have made space in the RX Buffer then copy over
     // any characters in the RX FIFO that my reside there.
@@ -56,9 +57,6 @@ MODSERIAL::__getc(bool block)
         MODSERIAL_IRQ_REG = irq_reg;
     }
     
-    __disable_irq();
-    buffer_count[RxIrq]--;   
-    __enable_irq();
     return c;
 }
 
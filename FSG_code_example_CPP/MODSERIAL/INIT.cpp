@@ -44,19 +44,17 @@ MODSERIAL::init( int txSize, int rxSize, PinName rx )
 
     
     if ( _base != NULL ) {
-        buffer_size[RxIrq]     = rxSize;
+        buffer_size[RxIrq]     = ringSize(rxSize);
         buffer[RxIrq]          = rxSize > 0 ? (char *)malloc(buffer_size[RxIrq]) : (char *)NULL;
         buffer_in[RxIrq]       = 0;
         buffer_out[RxIrq]      = 0;
-        buffer_count[RxIrq]    = 0;
         buffer_overflow[RxIrq] = 0;
         Serial::attach( callback(this, &MODSERIAL::isr_rx), Serial::RxIrq );        
         
-        buffer_size[TxIrq]     = txSize;
+        buffer_size[TxIrq]     = ringSize(txSize);
         buffer[TxIrq]          = txSize > 0 ? (char *)malloc(buffer_size[TxIrq]) : (char *)NULL;
         buffer_in[TxIrq]       = 0;
         buffer_out[TxIrq]      = 0;
-        buffer_count[TxIrq]    = 0;
         buffer_overflow[TxIrq] = 0;
         Serial::attach( callback(this, &MODSERIAL::isr_tx_true), Serial::TxIrq );
     }
@@ -42,12 +42,9 @@ MODSERIAL::isr_rx(void)
         }
         else {
             if (buffer[RxIrq] != (char *)NULL) {
-                buffer[RxIrq][buffer_in[RxIrq]] = rxc;
-                buffer_count[RxIrq]++; 
-                buffer_in[RxIrq]++;
-                if (buffer_in[RxIrq] >= buffer_size[RxIrq]) {
-                    buffer_in[RxIrq] = 0;
-                }
+                uint32_t in = buffer_in[RxIrq];
+                buffer[RxIrq][in & MODSERIAL_BUFFER_MASK(RxIrq)] = rxc;
+                buffer_in[RxIrq] = in + 1;
             }  
             _isr[RxIrq].call(&this->callbackInfo); 
         }
@@ -35,12 +35,9 @@ void MODSERIAL::isr_tx(bool doCallback)
         }
 
         while (! MODSERIAL_TX_BUFFER_EMPTY && MODSERIAL_WRITABLE ) {
-            MODSERIAL_WRITE_REG = txc = (uint8_t)(buffer[TxIrq][buffer_out[TxIrq]]);
-            buffer_count[TxIrq]--;
-            buffer_out[TxIrq]++;
-            if (buffer_out[TxIrq] >= buffer_size[TxIrq]) {
-                buffer_out[TxIrq] = 0;
-            }
+            uint32_t out = buffer_out[TxIrq];
+            MODSERIAL_WRITE_REG = txc = (uint8_t)(buffer[TxIrq][out & MODSERIAL_BUFFER_MASK(TxIrq)]);
+            buffer_out[TxIrq] = out + 1;
             if (doCallback) _isr[TxIrq].call(&this->callbackInfo);
         }
 
@@ -31,9 +31,15 @@
 #include "MODSERIAL_NUCLEO_F401RE.h"
 #include "MODSERIAL_PAC_F401RB.h"
 
-#define MODSERIAL_TX_BUFFER_EMPTY (buffer_count[TxIrq]==0)
-#define MODSERIAL_RX_BUFFER_EMPTY (buffer_count[RxIrq]==0)
-#define MODSERIAL_TX_BUFFER_FULL  (buffer_count[TxIrq]==buffer_size[TxIrq])
-#define MODSERIAL_RX_BUFFER_FULL  (buffer_count[RxIrq]==buffer_size[RxIrq])
+// buffer_in and buffer_out run freely (they wrap at 2^32, not at the
+// buffer size) and buffer sizes are powers of two, so the count is the
+// difference and a slot is the index masked with size - 1.
+#define MODSERIAL_BUFFER_COUNT(t) ((int)(buffer_in[t] - buffer_out[t]))
+#define MODSERIAL_BUFFER_MASK(t)  ((uint32_t)buffer_size[t] - 1)
+
+#define MODSERIAL_TX_BUFFER_EMPTY (buffer_in[TxIrq]==buffer_out[TxIrq])
+#define MODSERIAL_RX_BUFFER_EMPTY (buffer_in[RxIrq]==buffer_out[RxIrq])
+#define MODSERIAL_TX_BUFFER_FULL  (MODSERIAL_BUFFER_COUNT(TxIrq)==buffer_size[TxIrq])
+#define MODSERIAL_RX_BUFFER_FULL  (MODSERIAL_BUFFER_COUNT(RxIrq)==buffer_size[RxIrq])
 
 #endif
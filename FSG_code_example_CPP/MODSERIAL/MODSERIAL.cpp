@@ -78,15 +78,12 @@ int MODSERIAL::rxDiscardLastChar( void )
 {
     // This function can only be called indirectly from
     // an rxCallback function. Therefore, we know we 
-    // just placed a char into the buffer.
-    char c = buffer[RxIrq][buffer_in[RxIrq]];
+    // just placed a char into the buffer. Being in the
+    // RX IRQ we are also the only writer of buffer_in.
+    char c = buffer[RxIrq][buffer_in[RxIrq] & MODSERIAL_BUFFER_MASK(RxIrq)];
     
-    if (buffer_count[RxIrq]) {        
-        buffer_count[RxIrq]--;
+    if (! MODSERIAL_RX_BUFFER_EMPTY ) {        
         buffer_in[RxIrq]--;
-        if (buffer_in[RxIrq] < 0) {
-            buffer_in[RxIrq] = buffer_size[RxIrq] - 1;
-        }
     }
     
     return (int)c;
@@ -107,7 +104,7 @@ bool MODSERIAL::claim (FILE *stream) {
         return false;
     }
     
-    delete(path);
+    delete [] path;
     
     //No buffering
     setvbuf(stdout, NULL, _IONBF, buffer_size[TxIrq]);
@@ -497,7 +497,7 @@ public:
      * @ingroup API
      * @return The number of bytes in the TX buffer
      */
-    int txBufferGetCount(void)    { return buffer_count[TxIrq]; }
+    int txBufferGetCount(void)    { return (int)(buffer_in[TxIrq] - buffer_out[TxIrq]); }
     
     /**
      * Function: rxBufferGetCount
@@ -507,7 +507,7 @@ public:
      * @ingroup API
      * @return The number of bytes in the RX buffer
      */
-    int rxBufferGetCount(void)    { return buffer_count[RxIrq]; }
+    int rxBufferGetCount(void)    { return (int)(buffer_in[RxIrq] - buffer_out[RxIrq]); }
     
     /**
      * Function: txBufferGetSize
@@ -573,6 +573,7 @@ public:
      * Function: txBufferSetSize
      *  
      * Change the TX buffer size.
+     * The size is rounded up to a power of two.
      *
      * @see Result
      * @ingroup API
@@ -586,6 +587,7 @@ public:
      * Function: rxBufferSetSize
      *  
      * Change the RX buffer size.
+     * The size is rounded up to a power of two.
      *
      * @see Result
      * @ingroup API
@@ -599,6 +601,7 @@ public:
      * Function: txBufferSetSize
      *  
      * Change the TX buffer size.
+     * The size is rounded up to a power of two.
      * Always performs a memory sanity check, halting the Mbed on failure.
      *
      * @see Result
@@ -612,6 +615,7 @@ public:
      * Function: rxBufferSetSize
      *  
      * Change the RX buffer size.
+     * The size is rounded up to a power of two.
      * Always performs a memory sanity check, halting the Mbed on failure.
      *
      * @see Result
@@ -661,6 +665,62 @@ public:
      */
     int getc()   { return __getc(true);  }
     
+    /**
+     * Function: write
+     *
+     * Copy a block of bytes into the TX buffer. The bytes go in with at most
+     * two memcpy()s instead of one putc() call per byte.
+     *
+     * This function blocks (if the TX buffer fills the function waits for
+     * space until every byte has been queued).
+     *
+     * @ingroup API
+     * @param const uint8_t *data The bytes to send.
+     * @param size_t length The number of bytes to send.
+     * @return The number of bytes queued (always length).
+     */
+    int write(const uint8_t *data, size_t length) { return __write(data, (int)length, true); }
+    
+    /**
+     * Function: writeNb
+     *
+     * Like write() but is non-blocking. Only as many bytes as fit in the TX
+     * buffer are queued, the rest are left for the caller to send later.
+     *
+     * @ingroup API
+     * @param const uint8_t *data The bytes to send.
+     * @param size_t length The number of bytes to send.
+     * @return The number of bytes queued, 0 if the TX buffer is full.
+     */
+    int writeNb(const uint8_t *data, size_t length) { return __write(data, (int)length, false); }
+    
+    /**
+     * Function: read
+     *
+     * Copy a block of bytes out of the RX buffer with at most two memcpy()s.
+     *
+     * This function blocks (it waits until length bytes have arrived).
+     *
+     * @ingroup API
+     * @param uint8_t *data The destination buffer address.
+     * @param size_t length The number of bytes to read.
+     * @return The number of bytes read (always length).
+     */
+    int read(uint8_t *data, size_t length) { return __read(data, (int)length, true); }
+    
+    /**
+     * Function: readNb
+     *
+     * Like read() but is non-blocking. Only the bytes already in the RX
+     * buffer are copied out.
+     *
+     * @ingroup API
+     * @param uint8_t *data The destination buffer address.
+     * @param size_t length The maximum number of bytes to read.
+     * @return The number of bytes read, 0 if the RX buffer is empty.
+     */
+    int readNb(uint8_t *data, size_t length) { return __read(data, (int)length, false); }
+    
     /**
      * Function: txGetLastChar
      *
@@ -843,29 +903,26 @@ private:
     volatile char *buffer[2];
     
     /**
-     * Buffer in pointers.
+     * Buffer in indexes. They count every byte ever put in and are
+     * only written by the producer (putc/write for TX, isr_rx for RX).
      * @ingroup INTERNALS
      */
-    volatile int   buffer_in[2];
+    volatile uint32_t buffer_in[2];
     
     /**
-     * Buffer out pointers.
+     * Buffer out indexes. They count every byte ever taken out and are
+     * only written by the consumer (isr_tx for TX, getc/read for RX).
+     * The number of bytes in a buffer is buffer_in - buffer_out.
      * @ingroup INTERNALS
      */
-    volatile int   buffer_out[2];
+    volatile uint32_t buffer_out[2];
     
     /**
-     * Buffer lengths.
+     * Buffer lengths, always a power of two.
      * @ingroup INTERNALS
      */
     volatile int   buffer_size[2];
     
-    /**
-     * Buffer content counters.
-     * @ingroup INTERNALS
-     */
-    volatile int   buffer_count[2];
-    
     /**
      * Buffer overflow.
      * @ingroup INTERNALS
@@ -919,6 +976,22 @@ private:
      */
     int __putc(int c, bool);
     
+    /**
+     * Put a block of bytes into the TX buffer
+     * @ingroup INTERNALS
+     * @param bool True to block (wait for space in the TX buffer if full)
+     * @return The number of bytes put in the buffer
+     */
+    int __write(const uint8_t *data, int length, bool);
+    
+    /**
+     * Get a block of bytes from the RX buffer
+     * @ingroup INTERNALS
+     * @param bool True to block (wait until length bytes have arrived)
+     * @return The number of bytes taken from the buffer
+     */
+    int __read(uint8_t *data, int length, bool);
+    
     /**
      * Function: _putc 
      * Overloaded virtual function.
@@ -956,6 +1029,18 @@ private:
      */
     void moveRingBuffer(char * newBuffer, IrqType type);
     
+    /** 
+     * Function: ringSize
+     * The buffer size used for a requested size, the next power of two.
+     * @ingroup INTERNALS
+     */
+    static int ringSize(int size) {
+        if (size <= 0) return 0;
+        int ring = 1;
+        while (ring < size) ring <<= 1;
+        return ring;
+    }
+    
     
 
 
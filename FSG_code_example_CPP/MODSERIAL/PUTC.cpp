@@ -63,15 +63,12 @@ MODSERIAL::__putc(int c, bool block) {
             _isr[TxOvIrq].call(&this->callbackInfo);
             return -1;
         }
-        DISABLE_TX_IRQ;
-        buffer[TxIrq][buffer_in[TxIrq]] = c;
-        __disable_irq();
-        buffer_count[TxIrq]++;
-        __enable_irq();
-        buffer_in[TxIrq]++;
-        if (buffer_in[TxIrq] >= buffer_size[TxIrq]) {
-            buffer_in[TxIrq] = 0;
-        }            
+        // We are the only writer of buffer_in and isr_tx() the only
+        // writer of buffer_out, so no IRQs need masking here. The byte
+        // is stored before buffer_in moves past it.
+        uint32_t in = buffer_in[TxIrq];
+        buffer[TxIrq][in & MODSERIAL_BUFFER_MASK(TxIrq)] = c;
+        buffer_in[TxIrq] = in + 1;
         ENABLE_TX_IRQ;        
     }
       
@@ -0,0 +1,81 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include <string.h>
+#include "MODSERIAL.h"
+#include "MACROS.h"
+
+namespace AjK {
+
+int
+MODSERIAL::__read(uint8_t *data, int length, bool block) {
+
+    // If no buffer is in use fall back to standard RX FIFO usage,
+    // one byte at a time, the same as __getc() does.
+    if (buffer_size[RxIrq] == 0 || buffer[RxIrq] == (char *)NULL) {
+        for (int i = 0; i < length; i++) data[i] = (uint8_t)__getc(true);
+        return length;
+    }
+
+    int count = 0;
+
+    while (count < length) {
+        uint32_t out = buffer_out[RxIrq];
+        int available = (int)(buffer_in[RxIrq] - out);
+        if (available == 0) {
+            if (! block) break;
+            continue; // Blocks.
+        }
+
+        // Copy out with at most two memcpy()s, one up to the end of the
+        // ring and one from its start. We are the only writer of
+        // buffer_out so no IRQs need masking.
+        int chunk = length - count;
+        if (chunk > available) chunk = available;
+        int start = out & MODSERIAL_BUFFER_MASK(RxIrq);
+        int first = buffer_size[RxIrq] - start;
+        if (first > chunk) first = chunk;
+        const char *ring = (const char *)buffer[RxIrq];
+        memcpy(data + count, ring + start, first);
+        memcpy(data + count + first, ring, chunk - first);
+
+        // The bytes have to be copied before buffer_out hands
+        // their slots back to isr_rx(), which may run at any time.
+        __DMB();
+        buffer_out[RxIrq] = out + chunk;
+        count += chunk;
+
+        // We have made space in the RX buffer, copy over any
+        // characters that may be waiting in the RX FIFO.
+        // Temporarily disable the RX IRQ so that we do not
+        // re-enter it under interrupts.
+        uint32_t irq_reg = MODSERIAL_IRQ_REG;
+        DISABLE_RX_IRQ;
+        isr_rx();
+        MODSERIAL_IRQ_REG = irq_reg;
+    }
+
+    return count;
+}
+
+}; // namespace AjK ends
@@ -31,6 +31,10 @@ MODSERIAL::resizeBuffer(int size, IrqType type, bool memory_check)
     // Make sure the ISR cannot use the buffers while we are manipulating them.
     NVIC_DisableIRQ(_IRQ);
     
+    // Slots are found by masking the ring indexes with size - 1,
+    // so the buffer is the next power of two up from the request.
+    size = ringSize(size);
+    
     // If the requested size is the same as the current size there's nothing to do,
     // just continue to use the same buffer as it's fine as it is.
     if (buffer_size[type] == size)
@@ -40,7 +44,8 @@ MODSERIAL::resizeBuffer(int size, IrqType type, bool memory_check)
     }
     
     // is new buffer is big enough?
-    if (size <= buffer_count[type])
+    int count = MODSERIAL_BUFFER_COUNT(type);
+    if (size <= count)
     {
         NVIC_EnableIRQ(_IRQ);  
         return BufferOversize;
@@ -55,6 +60,7 @@ MODSERIAL::resizeBuffer(int size, IrqType type, bool memory_check)
         if (memory_check)
             error("Failed to allocate memory for %s buffer", type == TxIrq ? "TX" : "RX");
             
+        NVIC_EnableIRQ(_IRQ);
         return NoMemory;
     }
     
@@ -66,7 +72,7 @@ MODSERIAL::resizeBuffer(int size, IrqType type, bool memory_check)
         
     buffer[type]      = newBuffer;
     buffer_size[type] = size;
-    buffer_in[type]   = buffer_count[type];
+    buffer_in[type]   = count;
     buffer_out[type]  = 0;    
     
     // Start the ISR system again with the new buffers.
@@ -76,21 +82,18 @@ MODSERIAL::resizeBuffer(int size, IrqType type, bool memory_check)
 
 void MODSERIAL::moveRingBuffer(char * newBuffer, IrqType type)
 {   
-    // copy old buffer content to new one
-    if(buffer_in[type] > buffer_out[type])      
-    {   // content in the middle of the ring buffer
-        memcpy(&newBuffer[0], (char*)&buffer[type][buffer_out[type]], buffer_count[type]);
-    }  
-    else if(buffer_in[type] < buffer_out[type]) 
-    {   // content split, free space in the middle
-        // copy last part of the old buffer
-        int end_count= buffer_size[type] - buffer_out[type];
-        memcpy(&newBuffer[0], (char*)&buffer[type][buffer_out[type]], end_count);
-        
-        // copy first part of old buffer
-        memcpy(&newBuffer[end_count], (char*)buffer[type], buffer_in[type]);
-    }
-    // else old buffer empty
+    // copy old buffer content to new one, it may be split
+    // with the last part at the start of the old buffer
+    int count = MODSERIAL_BUFFER_COUNT(type);
+    int out = buffer_out[type] & MODSERIAL_BUFFER_MASK(type);
+    int end_count = buffer_size[type] - out;
+    if (end_count > count) end_count = count;
+    
+    // copy last part of the old buffer
+    memcpy(&newBuffer[0], (char*)&buffer[type][out], end_count);
+    
+    // copy first part of old buffer
+    memcpy(&newBuffer[end_count], (char*)buffer[type], count - end_count);
 }
 
 }; // namespace AjK ends
@@ -0,0 +1,212 @@
+// MODSERIAL on the host against the fake UART in stub/mbed.h.  First checks that putc/write/writeNb and
+// getc/read/readNb pass random data through the TX and RX buffers unchanged, then times the block copies
+// against the byte loops they replaced (radio packet sizes) and the interrupt handlers per byte.
+// Host numbers only compare the two ways of doing it, the LPC1768 is slower at both.
+#define protected public
+#define private public
+#include "MODSERIAL.h"
+#undef protected
+#undef private
+#include <time.h>
+#include <assert.h>
+using namespace AjK;
+
+static double now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static unsigned rnd_state = 12345;
+static unsigned rnd() {
+    rnd_state = rnd_state * 1103515245u + 12345u;
+    return rnd_state >> 8;
+}
+
+// the UART takes whatever the TX FIFO has room for
+static void drain(MODSERIAL & s, unsigned room) {
+    fake_uart.tx_room = room;
+    s.isr_tx(false);
+    fake_uart.tx_room = 0;
+}
+
+static void checkTransmit(MODSERIAL & s) {
+    std::vector<uint8_t> in;
+    uint8_t buf[300];
+    
+    fake_uart.keep = true;
+    fake_uart.out.clear();
+    
+    for (int iter = 0; iter < 200000; iter++) {
+        int n = rnd() % 300;
+        for (int i = 0; i < n; i++)
+            buf[i] = rnd();
+        
+        int op = rnd() % 3;
+        if (op == 0) {
+            for (int i = 0; i < n; i++)
+                s.putc(buf[i]);
+            in.insert(in.end(), buf, buf + n);
+        }
+        else if (op == 1) {
+            fake_uart.tx_room = rnd() % 3;     //write waits for the UART when the buffer is full
+            assert(s.write(buf, n) == n);
+            in.insert(in.end(), buf, buf + n);
+            fake_uart.tx_room = 0;
+        }
+        else {
+            int written = s.writeNb(buf, n);
+            assert(written >= 0 and written <= n);
+            in.insert(in.end(), buf, buf + written);
+        }
+        
+        assert(s.txBufferGetCount() <= s.txBufferGetSize(0));
+        drain(s, rnd() % 400);
+    }
+    
+    drain(s, 1u << 30);
+    assert(s.txBufferEmpty());
+    assert(in == fake_uart.out);
+    printf("TX stream ok: %u bytes\n", (unsigned)in.size());
+}
+
+static void checkReceive(MODSERIAL & s) {
+    std::vector<uint8_t> in, out;
+    uint8_t buf[512];
+    
+    for (int iter = 0; iter < 200000; iter++) {
+        int n = rnd() % 100;
+        for (int i = 0; i < n and s.rxBufferGetCount() + (int)fake_uart.rx.size() < 500; i++) {
+            uint8_t c = rnd();
+            in.push_back(c);
+            fake_uart_receive(&c, 1);
+        }
+        s.isr_rx();
+        
+        int want = rnd() % 200;
+        int op = rnd() % 3;
+        if (op == 0) {
+            int got = s.readNb(buf, want);
+            out.insert(out.end(), buf, buf + got);
+        }
+        else if (op == 1) {
+            if (want > s.rxBufferGetCount())
+                want = s.rxBufferGetCount();
+            assert(s.read(buf, want) == want);
+            out.insert(out.end(), buf, buf + want);
+        }
+        else {
+            for (int i = 0; i < want and !s.rxBufferEmpty(); i++)
+                out.push_back((uint8_t)s.getc());
+        }
+    }
+    
+    int got;
+    s.isr_rx();
+    while ((got = s.readNb(buf, sizeof(buf))) > 0) {
+        out.insert(out.end(), buf, buf + got);
+        s.isr_rx();
+    }
+    
+    assert(in == out);
+    printf("RX stream ok: %u bytes\n", (unsigned)in.size());
+}
+
+int main() {
+    MODSERIAL s(USBTX, USBRX, 4096, 512);     //LOG_TRANSMIT_TX_BUFFER
+    
+    checkTransmit(s);
+    checkReceive(s);
+    
+    fake_uart.keep = false;
+    
+    uint8_t packet[2052];
+    for (int i = 0; i < (int)sizeof(packet); i++)
+        packet[i] = rnd();
+    
+    //acknowledgement, line packet, compressed block: queued while the radio is busy, then the UART takes it
+    int sizes[] = { 14, 263, 2052 };
+    for (int k = 0; k < 3; k++) {
+        int length = sizes[k];
+        int reps = 20000000 / length;
+        double t_putc = 0, t_write = 0;
+        
+        for (int r = 0; r < reps; r++) {
+            double t0 = now();
+            for (int i = 0; i < length; i++)
+                s.putc(packet[i]);
+            t_putc += now() - t0;
+            drain(s, 1u << 30);
+            
+            t0 = now();
+            s.write(packet, length);
+            t_write += now() - t0;
+            drain(s, 1u << 30);
+        }
+        
+        double bytes = (double)reps * length;
+        printf("%4d byte packets: putc loop %.2f ns/byte, write %.2f ns/byte (%.1fx)\n", length, t_putc / bytes * 1e9, t_write / bytes * 1e9, t_putc / t_write);
+    }
+    
+    {
+        //sequence upload packet out of the RX buffer
+        MODSERIAL r(USBTX, USBRX, 256, 4096);
+        uint8_t buf[2052];
+        int length = 263, reps = 50000;
+        double t_getc = 0, t_read = 0;
+        
+        for (int k = 0; k < reps; k++) {
+            fake_uart_receive(packet, length);
+            r.isr_rx();
+            double t0 = now();
+            for (int i = 0; i < length; i++)
+                buf[i] = r.getc();
+            t_getc += now() - t0;
+            
+            fake_uart_receive(packet, length);
+            r.isr_rx();
+            t0 = now();
+            r.read(buf, length);
+            t_read += now() - t0;
+        }
+        
+        double bytes = (double)reps * length;
+        printf(" 263 byte reads:   getc loop %.2f ns/byte, read  %.2f ns/byte (%.1fx)\n", t_getc / bytes * 1e9, t_read / bytes * 1e9, t_getc / t_read);
+    }
+    
+    {
+        //16 bytes per RX interrupt into the buffer, 16 bytes per TX interrupt out of it (the UART FIFO depth)
+        MODSERIAL u(USBTX, USBRX, 256, 256);
+        uint8_t buf[16];
+        int reps = 2000000;
+        double t_rx = 0, t_tx = 0, t_putc = 0, t_getc = 0;
+        
+        for (int k = 0; k < reps; k++) {
+            fake_uart_receive(packet, 16);
+            double t0 = now();
+            u.isr_rx();
+            t_rx += now() - t0;
+            
+            t0 = now();
+            for (int i = 0; i < 16; i++)
+                buf[i] = u.getc();
+            t_getc += now() - t0;
+            
+            fake_uart.tx_room = 0;
+            t0 = now();
+            for (int i = 0; i < 16; i++)
+                u.putc(buf[i]);
+            t_putc += now() - t0;
+            
+            fake_uart.tx_room = 16;
+            t0 = now();
+            u.isr_tx(true);
+            t_tx += now() - t0;
+        }
+        
+        double bytes = reps * 16.0;
+        printf("per byte: isr_rx %.2f ns, isr_tx %.2f ns, putc %.2f ns, getc %.2f ns\n", t_rx / bytes * 1e9, t_tx / bytes * 1e9, t_putc / bytes * 1e9, t_getc / bytes * 1e9);
+    }
+    
+    return 0;
+}
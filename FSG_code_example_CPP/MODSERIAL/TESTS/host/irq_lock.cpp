@@ -0,0 +1,30 @@
+// the interrupt "lock" of the stress test (see irq_lock/MODSERIAL_LPC1768.h)
+#include "mbed.h"
+#include <pthread.h>
+#include <sched.h>
+
+volatile uint32_t fake_ier = 0;
+
+// recursive spinlock (a futex mutex starves the main code thread)
+static volatile pthread_t lock_owner;
+static volatile int lock_depth = 0;
+static volatile int lock_word = 0;
+
+void fake_irq_lock() {
+    if (lock_depth and pthread_equal(lock_owner, pthread_self())) {
+        lock_depth++;
+        return;
+    }
+    
+    while (__sync_lock_test_and_set(&lock_word, 1))
+        while (lock_word)
+            sched_yield();
+    
+    lock_owner = pthread_self();
+    lock_depth = 1;
+}
+
+void fake_irq_unlock() {
+    if (--lock_depth == 0)
+        __sync_lock_release(&lock_word);
+}
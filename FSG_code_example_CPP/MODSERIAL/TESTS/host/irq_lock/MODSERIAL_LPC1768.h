@@ -0,0 +1,34 @@
+// Device/MODSERIAL_LPC1768.h for the threaded stress test (found first on the include path).
+// IER changes go through the lock the "ISR" thread holds while it runs, so once DISABLE_TX_IRQ or
+// DISABLE_RX_IRQ returns no handler is running or can start, as on the real single core.
+#if defined(TARGET_LPC1768)
+
+void fake_irq_lock();
+void fake_irq_unlock();
+extern volatile uint32_t fake_ier;
+
+struct FakeIER {
+    operator uint32_t() { return fake_ier; }
+    FakeIER & operator=(uint32_t v) { fake_irq_lock(); fake_ier = v; fake_irq_unlock(); return *this; }
+    FakeIER & operator&=(uint32_t v) { fake_irq_lock(); fake_ier &= v; fake_irq_unlock(); return *this; }
+    FakeIER & operator|=(uint32_t v) { fake_irq_lock(); fake_ier |= v; fake_irq_unlock(); return *this; }
+};
+
+#define MODSERIAL_IRQ_REG (FakeIER())
+#define DISABLE_TX_IRQ MODSERIAL_IRQ_REG &= ~(1U << 1)     //1U, unsigned long is 64 bits on the host
+#define DISABLE_RX_IRQ MODSERIAL_IRQ_REG &= ~(1U << 0)
+#define ENABLE_TX_IRQ MODSERIAL_IRQ_REG |= (1UL << 1)
+#define ENABLE_RX_IRQ MODSERIAL_IRQ_REG |= (1UL << 0)
+
+#define RESET_TX_FIFO
+#define RESET_RX_FIFO
+
+#define MODSERIAL_READ_REG ((LPC_UART_TypeDef*)_base)->RBR
+#define MODSERIAL_WRITE_REG ((LPC_UART_TypeDef*)_base)->THR
+#define MODSERIAL_READABLE ((((LPC_UART_TypeDef*)_base)->LSR & (1UL<<0)) != 0)
+#define MODSERIAL_WRITABLE ((((LPC_UART_TypeDef*)_base)->LSR & (1UL<<5)) != 0)
+
+#define RX_IRQ_ENABLED true
+#define TX_IRQ_ENABLED true
+
+#endif
@@ -0,0 +1,52 @@
+// txBufferSetSize while bytes are queued: random writeNb, resizes (rounded up to powers of two, refused when
+// the queued bytes don't fit) and UART drains, the bytes must come out in order with none lost
+#define protected public
+#define private public
+#include "MODSERIAL.h"
+#undef protected
+#undef private
+#include <assert.h>
+using namespace AjK;
+
+static unsigned rnd_state = 7;
+static unsigned rnd() {
+    rnd_state = rnd_state * 1103515245u + 12345u;
+    return rnd_state >> 8;
+}
+
+int main() {
+    fake_uart.keep = true;
+    
+    MODSERIAL s(USBTX, USBRX, 100, 100);
+    assert(s.txBufferGetSize(0) == 128);
+    
+    int sizes[] = { 64, 128, 256, 1000, 4608 };
+    std::vector<uint8_t> in;
+    uint8_t buf[300];
+    int resizes = 0;
+    
+    for (int k = 0; k < 20000; k++) {
+        int n = rnd() % 300;
+        for (int i = 0; i < n; i++)
+            buf[i] = rnd() >> 8;
+        
+        int written = s.writeNb(buf, n);
+        in.insert(in.end(), buf, buf + written);
+        
+        if (s.txBufferSetSize(sizes[rnd() % 5], false) == MODSERIAL::Ok)
+            resizes++;
+        assert((s.txBufferGetSize(0) & (s.txBufferGetSize(0) - 1)) == 0);
+        
+        fake_uart.tx_room = rnd() % 200;
+        s.isr_tx(false);
+        fake_uart.tx_room = 0;
+    }
+    
+    fake_uart.tx_room = 1u << 30;
+    s.isr_tx(false);
+    
+    assert(in == fake_uart.out);
+    printf("resize ok: %d resizes, %u bytes\n", resizes, (unsigned)in.size());
+    
+    return 0;
+}
@@ -0,0 +1,205 @@
+// Two threads on one MODSERIAL.  The main code thread is the firmware's main loop: it queues random bursts with
+// putc/__putc/write/writeNb and reads with getc/read/readNb.  The "ISR" thread runs isr_tx and isr_rx while
+// their IER bits are set, holding the IRQ lock so the main code can't run inside a handler, while the fake
+// UART sends and receives random amounts.  At the end the bytes out of the UART must be the bytes queued and
+// the bytes read must be the bytes received.
+//
+//   modserial_stress [seconds] [TX buffer] [RX buffer]
+#define protected public
+#define private public
+#include "MODSERIAL.h"
+#undef protected
+#undef private
+#include <pthread.h>
+#include <sched.h>
+#include <assert.h>
+#include <time.h>
+using namespace AjK;
+
+void fake_irq_lock();
+void fake_irq_unlock();
+extern volatile uint32_t fake_ier;
+
+static MODSERIAL *s;
+static volatile bool stop_producer = false, stop_isr = false, rx_final = false;
+static std::vector<uint8_t> tx_in, rx_in, rx_out;
+static volatile unsigned long long rx_target = 50000000ULL;
+static volatile unsigned long long isr_runs = 0;
+
+struct Rnd {
+    unsigned v;
+    Rnd(unsigned seed) : v(seed) {}
+    unsigned next() { v = v * 1103515245u + 12345u; return v >> 8; }
+};
+
+static double now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void sleepMs(int ms) {
+    timespec d = { 0, ms * 1000000L };
+    nanosleep(&d, 0);
+}
+
+static void produce(Rnd & r) {
+    uint8_t buf[600];
+    int n = r.next() % 600;
+    for (int i = 0; i < n; i++)
+        buf[i] = r.next();
+    
+    switch (r.next() % 4) {
+        case 0:
+            for (int i = 0; i < n; i++)
+                s->putc(buf[i]);
+            tx_in.insert(tx_in.end(), buf, buf + n);
+            break;
+        case 1:
+            //non-blocking putc, stops at the first byte that doesn't fit
+            for (int i = 0; i < n; i++) {
+                if (s->__putc(buf[i], false) != 0)
+                    break;
+                tx_in.push_back(buf[i]);
+            }
+            break;
+        case 2:
+            s->write(buf, n);
+            tx_in.insert(tx_in.end(), buf, buf + n);
+            break;
+        default: {
+            int written = s->writeNb(buf, n);
+            tx_in.insert(tx_in.end(), buf, buf + written);
+            break;
+        }
+    }
+    
+    assert(s->txBufferGetCount() >= 0 and s->txBufferGetCount() <= s->buffer_size[SerialBase::TxIrq]);
+}
+
+static void consume(Rnd & r) {
+    uint8_t buf[600];
+    int n = r.next() % 600;
+    
+    switch (r.next() % 3) {
+        case 0:
+            for (int i = 0; i < n and !s->rxBufferEmpty(); i++)
+                rx_out.push_back((uint8_t)s->getc());
+            break;
+        case 1: {
+            if (n > s->rxBufferGetCount())
+                n = s->rxBufferGetCount();
+            assert(s->read(buf, n) == n);
+            rx_out.insert(rx_out.end(), buf, buf + n);
+            break;
+        }
+        default: {
+            int got = s->readNb(buf, n);
+            rx_out.insert(rx_out.end(), buf, buf + got);
+            break;
+        }
+    }
+    
+    assert(s->rxBufferGetCount() >= 0 and s->rxBufferGetCount() <= s->buffer_size[SerialBase::RxIrq]);
+}
+
+static void *mainCode(void *) {
+    Rnd r(1);
+    
+    while (!stop_producer) {
+        produce(r);
+        consume(r);
+        if (r.next() % 4 == 0)
+            sched_yield();
+    }
+    
+    while (!rx_final or rx_out.size() < rx_target)
+        consume(r);
+    
+    return 0;
+}
+
+static void *isr(void *) {
+    Rnd r(3);
+    
+    while (!stop_isr) {
+        fake_irq_lock();
+        
+        //the UART sent some bytes, there is room in the TX FIFO again
+        if (r.next() % 2)
+            fake_uart.tx_room = r.next() % 17;
+        if (fake_ier & 2)
+            s->isr_tx(true);
+        
+        //some bytes arrive, only as many as the RX buffer can take so none are dropped
+        if ((fake_ier & 1) and rx_in.size() < rx_target) {
+            int n = r.next() % 17;
+            int room = s->buffer_size[SerialBase::RxIrq] - s->rxBufferGetCount() - fake_uart.rx_avail;
+            if (n > room)
+                n = room;
+            for (int i = 0; i < n and rx_in.size() < rx_target; i++) {
+                uint8_t c = r.next();
+                rx_in.push_back(c);
+                fake_uart_receive(&c, 1);
+            }
+            s->isr_rx();
+        }
+        
+        isr_runs++;
+        fake_irq_unlock();
+        
+        //main code runs between interrupts
+        for (volatile unsigned spin = r.next() % 2000; spin; spin--)
+            ;
+        if (r.next() % 16 == 0)
+            sched_yield();      //one CPU, hand over before the time slice ends
+    }
+    
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 5;
+    int tx_size = argc > 2 ? atoi(argv[2]) : 256;
+    int rx_size = argc > 3 ? atoi(argv[3]) : 256;
+    
+    fake_uart.keep = true;
+    fake_uart.uart_drains = true;   //the UART keeps sending while the main code polls, as the real one does
+    s = new MODSERIAL(USBTX, USBRX, tx_size, rx_size);
+    fake_ier = 1;                   //RX IRQ on, the TX IRQ comes on with the first queued byte
+    printf("buffers TX %d RX %d, %.0f s\n", s->txBufferGetSize(0), s->rxBufferGetSize(0), seconds);
+    
+    pthread_t main_thread, isr_thread;
+    pthread_create(&isr_thread, 0, isr, 0);
+    pthread_create(&main_thread, 0, mainCode, 0);
+    
+    double t0 = now();
+    while (now() - t0 < seconds)
+        sleepMs(10);
+    
+    //nothing more to send, the ISR empties the TX buffer and stops receiving, the main code reads the rest
+    rx_target = 0;
+    stop_producer = true;
+    while (!s->txBufferEmpty())
+        sleepMs(1);
+    
+    fake_irq_lock();
+    rx_target = rx_in.size();
+    rx_final = true;
+    fake_irq_unlock();
+    pthread_join(main_thread, 0);
+    
+    //the last produce() may have queued more after the first wait
+    while (!s->txBufferEmpty())
+        sleepMs(1);
+    stop_isr = true;
+    pthread_join(isr_thread, 0);
+    
+    bool tx_ok = (tx_in == fake_uart.out);
+    bool rx_ok = (rx_in == rx_out);
+    printf("%.1f s, %llu ISR passes\n", now() - t0, (unsigned long long)isr_runs);
+    printf("TX %u bytes in, %u out, %s\n", (unsigned)tx_in.size(), (unsigned)fake_uart.out.size(), tx_ok ? "identical" : "DIFFERENT");
+    printf("RX %u bytes in, %u out, %s\n", (unsigned)rx_in.size(), (unsigned)rx_out.size(), rx_ok ? "identical" : "DIFFERENT");
+    
+    return (tx_ok and rx_ok) ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// Host build of MODSERIAL: the parts of mbed.h it uses, and a fake LPC1768 UART.
+// THR/RBR/LSR are objects, so a write to THR is a byte leaving the UART and a read of RBR takes one from the
+// receive FIFO.  The test decides how many bytes the TX FIFO can take (tx_room) and what arrives (rx).
+#ifndef STUB_MBED_H
+#define STUB_MBED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <deque>
+#include <vector>
+
+#ifndef TARGET_LPC1768
+#define TARGET_LPC1768 1
+#endif
+
+enum PinName { p9 = 9, p10, p13 = 13, p14, p27 = 27, p28, USBTX, USBRX, NC };
+typedef int IRQn_Type;
+enum { UART0_IRQn, UART1_IRQn, UART2_IRQn, UART3_IRQn };
+
+struct FakeUart {
+    std::deque<uint8_t> rx;         //bytes in the RX FIFO
+    volatile int rx_avail;          //rx.size(), read by the LSR
+    volatile unsigned tx_room;      //bytes the TX FIFO can take before the LSR reports it full
+    volatile unsigned lsr_reads;
+    bool uart_drains;               //the TX FIFO empties again after a few LSR reads (the UART keeps sending while code polls)
+    bool keep;                      //keep the bytes sent in out (off for the benchmark)
+    std::vector<uint8_t> out;
+    unsigned long long sent;
+};
+extern FakeUart fake_uart;
+
+struct RegTHR {
+    RegTHR & operator=(uint32_t v) {
+        __sync_synchronize();
+        if (fake_uart.keep)
+            fake_uart.out.push_back((uint8_t)v);
+        fake_uart.sent++;
+        if (fake_uart.tx_room)
+            __sync_fetch_and_sub(&fake_uart.tx_room, 1);
+        __sync_synchronize();
+        return *this;
+    }
+};
+
+struct RegRBR {
+    operator uint32_t() {
+        uint8_t c = fake_uart.rx.front();
+        fake_uart.rx.pop_front();
+        __sync_fetch_and_sub(&fake_uart.rx_avail, 1);
+        return c;
+    }
+};
+
+struct RegLSR {
+    operator uint32_t() {
+        if (fake_uart.uart_drains and !fake_uart.tx_room and (__sync_add_and_fetch(&fake_uart.lsr_reads, 1) & 7) == 0)
+            __sync_bool_compare_and_swap(&fake_uart.tx_room, 0, 16);
+        return (fake_uart.rx_avail ? 1 : 0) | (fake_uart.tx_room ? (1u << 5) : 0) | (1u << 6);
+    }
+};
+
+struct LPC_UART_TypeDef {
+    RegRBR RBR;
+    RegTHR THR;
+    volatile uint32_t IER, FCR;
+    RegLSR LSR;
+};
+extern LPC_UART_TypeDef *LPC_UART0, *LPC_UART1, *LPC_UART2, *LPC_UART3;
+
+// push bytes into the RX FIFO
+inline void fake_uart_receive(const uint8_t * bytes, int length) {
+    for (int i = 0; i < length; i++) {
+        fake_uart.rx.push_back(bytes[i]);
+        __sync_fetch_and_add(&fake_uart.rx_avail, 1);
+    }
+}
+
+inline void NVIC_DisableIRQ(IRQn_Type) {}
+inline void NVIC_EnableIRQ(IRQn_Type) {}
+inline void __disable_irq() { __asm__ volatile("" ::: "memory"); }
+inline void __enable_irq() { __asm__ volatile("" ::: "memory"); }
+inline uint32_t __get_PRIMASK() { return 0; }
+inline void __set_PRIMASK(uint32_t) {}
+inline void __DMB() { __sync_synchronize(); }
+void error(const char *, ...);
+
+template<typename R> class Callback {
+public:
+    Callback() {}
+    Callback(void (*)()) {}
+    template<typename T> Callback(T *, void (T::*)()) {}
+};
+template<typename T> Callback<void()> callback(T * o, void (T::*m)()) { return Callback<void()>(o, m); }
+inline Callback<void()> callback(void (*f)()) { return Callback<void()>(f); }
+
+class FileBase {
+public:
+    const char * getName();
+};
+
+class Stream : public FileBase {
+public:
+    int printf(const char *, ...);
+    int putc(int c);
+    int getc();
+protected:
+    virtual int _putc(int) = 0;
+    virtual int _getc() = 0;
+    virtual ssize_t write(const void *, size_t);
+    virtual ssize_t read(void *, size_t);
+};
+
+struct serial_t_wrap { int index; };
+
+class SerialBase {
+public:
+    enum IrqType { RxIrq = 0, TxIrq };
+    enum Parity { None = 0, Odd, Even, Forced1, Forced0 };
+    void baud(int) {}
+    void format(int = 8, Parity = None, int = 1) {}
+    int readable();
+    int writeable();
+    void attach(Callback<void()>, IrqType type = RxIrq);
+protected:
+    serial_t_wrap _serial;
+};
+
+class Serial : public SerialBase, public Stream {
+public:
+    Serial(PinName, PinName, const char * name = NULL);
+    Serial(PinName, PinName, int);
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2010 Andy Kirkham
+ 
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+ 
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+ 
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include <string.h>
+#include "MODSERIAL.h"
+#include "MACROS.h"
+
+namespace AjK {
+
+int
+MODSERIAL::__write(const uint8_t *data, int length, bool block) {
+
+    // If no buffer is in use fall back to standard TX FIFO usage,
+    // one byte at a time, the same as __putc() does.
+    if (buffer[TxIrq] == (char *)NULL || buffer_size[TxIrq] == 0) {
+        for (int i = 0; i < length; i++) __putc(data[i], true);
+        return length;
+    }
+
+    int written = 0;
+
+    // Nothing is queued so the TX IRQ is off, feed the TX FIFO
+    // directly until it is full, just like __putc() does for one byte.
+    while (written < length && MODSERIAL_TX_BUFFER_EMPTY && MODSERIAL_WRITABLE) {
+        MODSERIAL_WRITE_REG = (uint32_t)data[written++];
+    }
+
+    while (written < length) {
+        uint32_t in = buffer_in[TxIrq];
+        int space = buffer_size[TxIrq] - (int)(in - buffer_out[TxIrq]);
+        if (space == 0) {
+            if (! block) break;
+            // Blocks! Poll isr_tx() to move bytes into the TX FIFO,
+            // see __putc() for why we do not just wait for the IRQ.
+            // The TX IRQ is off so that isr_tx() has one caller.
+            uint32_t irq_reg = MODSERIAL_IRQ_REG; DISABLE_TX_IRQ;
+            isr_tx(false);
+            MODSERIAL_IRQ_REG = irq_reg;
+            continue;
+        }
+
+        // Copy as much as fits with at most two memcpy()s, one up to
+        // the end of the ring and one from its start. We are the only
+        // writer of buffer_in so no IRQs need masking.
+        int chunk = length - written;
+        if (chunk > space) chunk = space;
+        int start = in & MODSERIAL_BUFFER_MASK(TxIrq);
+        int first = buffer_size[TxIrq] - start;
+        if (first > chunk) first = chunk;
+        char *ring = (char *)buffer[TxIrq];
+        memcpy(ring + start, data + written, first);
+        memcpy(ring, data + written + first, chunk - first);
+
+        // The bytes have to be in the ring before buffer_in
+        // moves past them, isr_tx() may run at any time.
+        __DMB();
+        buffer_in[TxIrq] = in + chunk;
+        written += chunk;
+        ENABLE_TX_IRQ;
+    }
+
+    return written;
+}
+
+}; // namespace AjK ends
@@ -0,0 +1,78 @@
+#ifndef LOGRECORD_HPP
+#define LOGRECORD_HPP
+
+#include "mbed.h"
+
+//log file formats (CSV is the original 254 character line, binary is the packed record below)
+enum {
+    LOG_FORMAT_CSV,
+    LOG_FORMAT_BINARY
+};
+
+//binary log file, decode with FSG_binary_log_decoder/FSG_binary_log_to_csv.py
+#define BINARY_LOG_VERSION      4           //v4: DELTA records (v3: variable length records, only the fields due are written, v2: 64 bit microsecond time stamps)
+#define BINARY_LOG_NUM_FIELDS   32          //same as _data_log, column order of _heading_string
+#define BINARY_LOG_SYNC         0xA5        //first byte of every record (used to resync on a bad record)
+#define BINARY_LOG_TYPE_DATA    0x01        //field mask + the fields in it
+#define BINARY_LOG_TYPE_EPOCH   0x02        //wall time anchor, written when the time is set and at the start of each segment
+#define BINARY_LOG_TYPE_DELTA   0x03        //varint changes since the last record (see MbedLogger::encodeDeltaRecord)
+
+//record in the file: sync, type, length, state, time_us_low, time_us_high (12 bytes), payload, sequence, crc (4 bytes)
+#define BINARY_LOG_RECORD_HEADER    12
+#define BINARY_LOG_RECORD_TRAILER   4
+#define BINARY_LOG_MAX_RECORD       (BINARY_LOG_RECORD_HEADER + 4 + 2 * BINARY_LOG_NUM_FIELDS + BINARY_LOG_RECORD_TRAILER)     //84 bytes, every field
+#define BINARY_LOG_ALL_FIELDS       0xFFFFFFFF  //field mask with every field (32 fields)
+
+//written once at the start of every binary log file (little-endian, same as the LPC1768)
+struct BinaryLogFileHeader {
+    char     magic[4];                              // "FSGB"
+    uint16_t version;                               // BINARY_LOG_VERSION
+    uint16_t header_size;                           // sizeof(BinaryLogFileHeader)
+    uint16_t record_size;                           // BINARY_LOG_MAX_RECORD (each record has its own length)
+    uint16_t num_fields;                            // BINARY_LOG_NUM_FIELDS
+    uint8_t  decimals[BINARY_LOG_NUM_FIELDS];       // field[i] is stored as round(value * 10^decimals[i])
+    uint16_t crc;                                   // CRC16 of the bytes above
+};
+
+//one sample waiting in the log buffer, MbedLogger::encodeBinaryRecord() packs it for the file
+//(DATA in the file: field_mask then the int16 of every field in the mask, EPOCH: epoch_seconds)
+//the time is split in two 32 bit words so the struct has no 8 byte alignment padding
+struct BinaryLogRecord {
+    uint8_t  sync;                                  // BINARY_LOG_SYNC
+    uint8_t  type;                                  // BINARY_LOG_TYPE_DATA or BINARY_LOG_TYPE_EPOCH
+    uint8_t  length;                                // length in the file (set by encodeBinaryRecord)
+    uint8_t  state;                                 // state machine state (St#)
+    uint32_t time_us_low;                           // microseconds since power up (systemClock), low word
+    uint32_t time_us_high;                          // high word
+    uint32_t field_mask;                            // DATA: bit n set if field n is written to the binary log
+    union {
+        int16_t field[BINARY_LOG_NUM_FIELDS];       // DATA: scaled _data_log values (saturate at +/-32767), always all of them (CSV line)
+        struct {
+            uint32_t epoch_seconds;                 // EPOCH: wall time (seconds since 1970) at time_us, rest of the union is zero
+        } epoch;
+    };
+    uint16_t sequence;                              // data record counter, rolls over (used to spot dropped records)
+};
+
+//what is in one log segment (one line of SEGMENTS.TXT)
+struct LogSegmentInfo {
+    int segment;                    // LOG### number
+    int log_format;                 // LOG_FORMAT_CSV or LOG_FORMAT_BINARY
+    unsigned int start_time;        // wall time (seconds) of the first record
+    unsigned int end_time;          // wall time (seconds) of the last record
+    int first_state;
+    int last_state;
+    unsigned int state_mask;        // bit n set if state n was recorded
+    unsigned int record_count;
+    unsigned int byte_count;        // file size including the heading/file header
+};
+
+//which CSV lines to transmit (0 = no limit on start_time/end_time/state_mask)
+struct LogQuery {
+    unsigned int start_time;        // wall time (seconds), same as TimeSec
+    unsigned int end_time;
+    unsigned int state_mask;        // bit n set to transmit state n
+    int decimation;                 // every Nth matching line (1 = all of them)
+};
+
+#endif
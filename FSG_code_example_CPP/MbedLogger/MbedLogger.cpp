@@ -11,19 +11,202 @@ Also used to transmit data from the MBED over the XBee radio to a receiver.
 
 And receive dive sequence files from the transmit/receiver program.
 
+Log files can be written as the original fixed-length CSV lines or as packed
+binary records (BinaryLogRecord, see MbedLogger.hpp).  The binary records skip
+the 35 float conversions in fprintf and are about 3.4x smaller.  Copy a LOG###.BIN
+off the MBED drive and run FSG_binary_log_to_csv.py to get the CSV file back.
+
+Logging is split in two so the file system never holds up the state machine:
+recordData() only samples into a record and pushes it into a RAM ring buffer
+(LogBuffer), and drainLogBuffer() writes whole blocks to the file later when
+the main loop has slack (halfway between FSM ticks).
+
+The log is split into segments LOG000 to LOG999 (.csv or .BIN).  A new segment
+is started for every dive (startNewLogSegment) and when a segment gets bigger
+than LOG_SEGMENT_MAX_BYTES.  SEGMENTS.TXT is an append-only index with one line
+per segment close (start/end time, first/last state, states seen, records and
+bytes).  A segment can be closed more than once, the last line for it wins.
+
+The logged columns (names, getters and decimals) come from telemetry_log_fields
+(TelemetryFields), sampleData/formatCSVLine/the binary writers loop over it.
+formatCSVLine prints the record's scaled integers with putFixed (LogFormat) instead of
+sprintf (no float conversions, same characters as the old "%06.1f" columns).
+Both formats hold round(value * 10^decimals) in an int16: a value outside the
+range listed in telemetry_log_fields is logged at the limit and counted
+(printLogBufferStats), so a column is 7 characters at most and the line fits
+LOG_CSV_MAX_LINE (a negative value with decimals is 7, every other line is 254).
+
+Binary records only carry the fields that are due (the table rate column):
+fast fields every FSM tick while recording (recordFastData, 10 Hz), slow fields
+with every log_function record (1 Hz) and gains/settings only when they change.
+The first record of each segment and every LOG_FULL_RECORD_INTERVAL-th 1 Hz
+record have every field, so a segment decodes on its own and a dropped change
+is fixed within a minute.  The CSV line always has every field at 1 Hz (the
+fixed line length is part of the transmit protocol).
+
+With delta encoding on (setDeltaEncoding) a binary DATA record is written as a
+DELTA record instead: the time and the fields that changed since the last
+record written, as zig-zag varints of the difference.  A full DATA record
+(keyframe) is still written every LOG_KEYFRAME_INTERVAL records and at the
+start of a segment, the decoder can start at any keyframe.
+
+Records are time stamped in microseconds since power up (systemClock, 64 bit).
+setLogTime() saves the wall time at that moment (the epoch).  The binary log
+gets an EPOCH record at the start of every segment and whenever the time is set,
+so the host can turn the microsecond stamps back into wall time.  The CSV
+TimeSec column is calculated the same way when the line is written.
+
+The PC can send a log query (time window, set of states, decimation) before
+asking for packets (startLogTransmit).  Packet n is then the n-th CSV
+line that matches, read from all the CSV segments in order.  Segments that the
+segment index says are outside the window/states are not read at all.
+
+The log download and the sequence file upload run from the main loop
+(serviceLogTransmit, serviceSequenceReceive), each call handles one request or
+packet and only queues as many packets as the XBee TX buffer has room for, so
+the state machine and logging keep running.  They have their own file pointers,
+the log file stays open.
+
+A segment only gets its SEGMENTS.TXT line when it is closed, so at boot a last
+segment without one was open when the power went.  initializeLogFile() scans
+it (binary: sync, length and CRC16 of every record, CSV: every line whole with
+all its columns), cuts it back to the last good record and adds its index line.
+The CSV line can't carry a CRC, its 254 characters are all columns and the
+packet length is one byte.
+
 *******************************************************************************/
 
 #include "MbedLogger.hpp"
+#include "LogFormat.hpp"
 #include "StaticDefs.hpp"
-
-//print to both serial ports using this macro
-#define serialPrint(fmt, ...) pc().printf(fmt, ##__VA_ARGS__);xbee().printf(fmt, ##__VA_ARGS__)
+#include <stddef.h>     //offsetof
+#include "us_ticker_api.h"  //us_ticker_read() for timing the block writes
 
   //Timer t;    //used to test time to create packet    //timing debug
 
+// CRC16 lookup table (calcCrc16, calcCrcOne/calcCrcTwo and the Python programs)
+static const uint16_t crc16_table[256] = {0, 49345, 49537, 320, 49921, 960, 640, 49729, 50689, 1728, 1920, 51009, 1280, 50625, 50305,  1088, 52225,  3264,  3456, 52545,  3840, 53185, 52865,  3648,  2560, 51905, 52097,  2880, 51457,  2496,  2176, 51265, 55297,  6336,  6528, 55617,  6912, 56257, 55937,  6720,  7680, 57025, 57217,  8000, 56577,  7616,  7296, 56385,  5120, 54465, 54657,  5440, 55041,  6080,  5760, 54849, 53761,  4800,  4992, 54081,  4352, 53697, 53377,  4160, 61441, 12480, 12672, 61761, 13056, 62401, 62081, 12864, 13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529, 15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089, 64001, 15040, 15232, 64321, 14592, 63937, 63617, 14400, 10240, 59585, 59777, 10560, 60161, 11200, 10880, 59969, 60929, 11968, 12160, 61249, 11520, 60865, 60545, 11328, 58369,  9408,  9600, 58689,  9984, 59329, 59009,  9792,  8704, 58049, 58241,  9024, 57601,  8640,  8320, 57409, 40961, 24768, 24960, 41281, 25344, 41921, 41601, 25152, 26112, 42689, 42881, 26432, 42241, 26048, 25728, 42049, 27648, 44225, 44417, 27968, 44801, 28608, 28288, 44609, 43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688, 30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681, 48641, 32448, 32640, 48961, 32000, 48577, 48257, 31808, 46081, 29888, 30080, 46401, 30464, 47041, 46721, 30272, 29184, 45761, 45953, 29504, 45313, 29120, 28800, 45121, 20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441, 38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568, 39937, 23744, 23936, 40257, 24320, 40897, 40577, 24128, 23040, 39617, 39809, 23360, 39169, 22976, 22656, 38977, 34817, 18624, 18816, 35137, 19200, 35777, 35457, 19008, 19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905, 17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369, 33281, 17088, 17280, 33601, 16640, 33217, 32897, 16448};
+
+// unsigned LEB128: 7 bits per byte, low bits first, top bit set if another byte follows
+static int putVarint(uint8_t * buffer, uint32_t value) {
+    int length = 0;
+    
+    while (value >= 0x80) {
+        buffer[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (uint8_t)value;
+    
+    return length;
+}
+
+// zig-zag so small negative deltas are small numbers too (0, -1, 1, -2 ... -> 0, 1, 2, 3 ...)
+static uint32_t zigZag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+// putVarint backwards, returns the number of bytes read (0 if it runs past max_length)
+static int getVarint(const uint8_t * buffer, int max_length, uint32_t * value) {
+    *value = 0;
+    
+    for (int i = 0; i < max_length and i < 5; i++) {
+        *value |= (uint32_t)(buffer[i] & 0x7F) << (7 * i);
+        
+        if (!(buffer[i] & 0x80))
+            return i + 1;
+    }
+    
+    return 0;
+}
+
 MbedLogger::MbedLogger(string file_system_input_string) {
     _file_system_string = file_system_input_string;
-    _full_file_path_string = _file_system_string + "LOG000.csv";    //use multiple logs in the future? (after file size is too large)  
+    _index_file_path_string = _file_system_string + "SEGMENTS.TXT";
+    _log_format = LOG_FORMAT_CSV;
+    _binary_record_sequence = 0;
+    
+    _fp = NULL;
+    _close_requested = false;
+    _blocks_written = 0;
+    _write_error_count = 0;
+    _last_drain_us = 0;
+    _max_drain_us = 0;
+    _clamped_count = 0;
+    _file_skipped_count = 0;
+    
+    _log_sink_count = 0;
+    
+    _current_segment = 0;
+    _transmit_segment = 0;
+    _transmit_format = LOG_FORMAT_CSV;
+    _new_segment_requested = false;
+    resetSegmentInfo();
+    
+    _epoch_seconds = 0;             //until setLogTime, TimeSec is seconds since power up
+    _epoch_time_us = 0;
+    
+    //binary log rate classes from the telemetry field table
+    _fast_field_mask = 0;
+    _slow_field_mask = 0;
+    _change_field_mask = 0;
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        if (telemetry_log_fields[i].rate == TELEMETRY_RATE_FAST)
+            _fast_field_mask |= (1UL << i);
+        else if (telemetry_log_fields[i].rate == TELEMETRY_RATE_SLOW)
+            _slow_field_mask |= (1UL << i);
+        else
+            _change_field_mask |= (1UL << i);
+        
+        _data_log[i] = 0;
+        _last_logged_field[i] = 0;
+    }
+    _fast_logging = true;
+    _slow_records_since_full = 0;
+    
+    _delta_encoding = false;
+    _records_since_keyframe = 0;
+    _encoded_time_us = 0;
+    memset(_encoded_field, 0, sizeof(_encoded_field));
+    
+    _query_active = false;
+    _query_segment = -1;
+    _query_line = 0;
+    _query_packet = 0;
+    _query_lines = 0;
+    _query_matches = 0;
+    _query_done = true;
+    memset(&_query, 0, sizeof(_query));
+    memset(_query_skip_segment, 0, sizeof(_query_skip_segment));
+    _window_active = false;
+    _window_next_packet = 0;
+    _window_send_count = 0;
+    memset(_window_sent_at, 0, sizeof(_window_sent_at));
+    _window_compressed = false;
+    _window_total = 0;
+    _window_first_missing = 0;
+    _window_received_mask = 0;
+    _window_limit = 0;
+    memset(_window_resend, 0, sizeof(_window_resend));
+    _transmit_fp = NULL;
+    _transmit_running = false;
+    _transmit_restore_buffer = false;
+    _transmit_trace_categories = 0;
+    _transmit_last_byte_us = 0;
+    _transmit_state = HEADER_117;
+    _transmit_bytes = 0;
+    _transmit_request_packet = 0;
+    _parity_group = 0;
+    _parity_first = 0;
+    _parity_count = 0;
+    _parity_length = 0;
+    _parity_due = false;
+    _upload_fp = NULL;
+    _upload_running = false;
+    _upload_last_byte_us = 0;
+    _upload_last_ack_us = 0;
+    _upload_window = LOG_UPLOAD_WINDOW;
+    resetUpload();
+    
     _file_transmission = true;
     _confirmed_packet_number = 0;   //must set this to zero
     _transmit_counter = 0;
@@ -34,8 +217,13 @@ MbedLogger::MbedLogger(string file_system_input_string) {
     
     _log_file_line_counter = 0;     //used to set timer in finite state machine based on size of log
     
-    //heading string is 254 bytes long, FIXED LENGTH
-    _heading_string = "StateStr,St#,TimeSec,DepthCmd,DepthFt,PitchCmd,PitchDeg,RudderPWM,RudderCmdDeg,HeadDeg,bceCmd,bce_mm,battCmd,batt_mm,PitchRateDegSec,depthrate_fps,SystemAmps,SystemVolts,AltChRd,IntPSI,BCE_p,BCi,BCd,BATT_p,BTi,BTd,DEPTH_p,Di,Dd,PITCH_p,Pi,Pd,HEAD_p,Hi,Hd\n";
+    //heading string is 254 bytes long, FIXED LENGTH (column names from telemetry_log_fields)
+    _heading_string = "StateStr,St#,TimeSec";
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        _heading_string += ",";
+        _heading_string += telemetry_log_fields[i].name;
+    }
+    _heading_string += "\n";
     _transmit_packet_num = 0;
     _fsm_transmit_complete = false;
     _end_transmit_packet = false;
@@ -45,179 +233,1175 @@ MbedLogger::MbedLogger(string file_system_input_string) {
 
 //this function has to be called for the time to function correctly
 void MbedLogger::setLogTime() {
+    setLogTime(1551154422);   // Set RTC time to Tuesday, 01 JAN 2019 08:00 AM
+}
+
+// set the RTC and anchor the microsecond time stamps to it
+void MbedLogger::setLogTime(time_t epoch_seconds) {
     serialPrint("\n%s log time set.\n\r", _file_system_string.c_str());
-    set_time(1551154422);   // Set RTC time to Tuesday, 01 JAN 2019 08:00 AM
+    set_time(epoch_seconds);
+    
+    _epoch_time_us = systemClock().read_us();
+    _epoch_seconds = epoch_seconds;
+    
+    //segment already open, put the new anchor in it (a new segment starts with one anyway)
+    if (_fp and _log_format == LOG_FORMAT_BINARY) {
+        BinaryLogRecord record;
+        fillEpochRecord(record);
+        _log_buffer.push(record);
+    }
+}
+
+// wall time (seconds since 1970) of a microsecond time stamp
+unsigned int MbedLogger::getWallTime(uint64_t time_us) {
+    return getWallTime(time_us, _epoch_seconds, _epoch_time_us);
 }
 
+// same with another epoch (the one in a binary log file)
+unsigned int MbedLogger::getWallTime(uint64_t time_us, unsigned int epoch_seconds, uint64_t epoch_time_us) {
+    int64_t delta_us = (int64_t)(time_us - epoch_time_us);
+    
+    //round down for time stamps before the epoch too
+    int64_t delta_seconds = (delta_us >= 0) ? (delta_us / 1000000) : -((-delta_us + 999999) / 1000000);
+    
+    return (unsigned int)(epoch_seconds + delta_seconds);
+}
+
+// find the last log segment on the file system, the next recording starts a new one after it
+// (the segment file itself is created when the first records are written)
 void MbedLogger::initializeLogFile() {
-    string file_name_string = _file_system_string + "LOG000.csv";
     serialPrint("%s file system init\n\r", _file_system_string.c_str());
     
-    //try to open this file...
-    _fp = fopen(file_name_string.c_str(), "r");
+    int last_segment = findLastLogSegment();
+    
+    //not in the index: it was being written when the power went
+    if (last_segment >= 0 and !isSegmentIndexed(last_segment))
+        recoverLogSegment(last_segment);
+    
+    if (last_segment < 0) {
+        _current_segment = 0;
+        _transmit_segment = 0;
+        _transmit_format = _log_format;
+    }
+    else {
+        _current_segment = (last_segment < LOG_MAX_SEGMENT) ? last_segment + 1 : LOG_MAX_SEGMENT;
+        setTransmitSegment(last_segment);
+    }
+    
+    resetSegmentInfo();
+    
+    //out of segment numbers, keep appending to the last one
+    if (last_segment == LOG_MAX_SEGMENT) {
+        _segment_info.byte_count = getFileSize(getLogFileName());
+        _segment_header_sent = (_segment_info.byte_count > 0);
+    }
+    
+    serialPrint("%s last log segment: %d, next log segment: %s\n\r", _file_system_string.c_str(), last_segment, getLogFileName().c_str());
+}
+
+// highest LOG### number in the directory (-1 if there are no log files)
+int MbedLogger::findLastLogSegment() {
+    DIR *dir;
+    struct dirent *dp;
+    int last_segment = -1;
+    
+    if ( NULL == (dir = opendir( _file_system_string.c_str() )) )
+        return -1;
+    
+    while ( NULL != (dp = readdir( dir )) ) {
+        int segment = getLogSegmentNumber(dp->d_name);
+        
+        if (segment > last_segment)
+            last_segment = segment;
+    }
+    
+    closedir(dir);
+    
+    return last_segment;
+}
+
+// true if SEGMENTS.TXT has a line for the segment (it was closed at least once)
+bool MbedLogger::isSegmentIndexed(int segment) {
+    FILE *index_fp = fopen(_index_file_path_string.c_str(), "r");
+    
+    if (!index_fp)
+        return false;
+    
+    char line_buffer[100];
+    bool indexed = false;
+    
+    while (!indexed and fgets(line_buffer, sizeof(line_buffer), index_fp) != NULL)
+        indexed = (getLogSegmentNumber(line_buffer) == segment);
+    
+    fclose(index_fp);
+    
+    return indexed;
+}
+
+// Cut a segment that wasn't closed back to its last good record (a brown-out can leave half a
+// block or garbage at the end) and add it to the index so the download counts are right again
+void MbedLogger::recoverLogSegment(int segment) {
+    LogSegmentInfo info;
+    memset(&info, 0, sizeof(info));
+    info.segment = segment;
+    info.first_state = -1;
+    info.last_state = -1;
+    
+    //either format, whichever file is there
+    info.log_format = LOG_FORMAT_BINARY;
+    string file_name_string = getSegmentFileName(segment, info.log_format);
+    FILE *segment_fp = fopen(file_name_string.c_str(), "rb");
+    
+    if (!segment_fp) {
+        info.log_format = LOG_FORMAT_CSV;
+        file_name_string = getSegmentFileName(segment, info.log_format);
+        segment_fp = fopen(file_name_string.c_str(), "rb");
+    }
+    
+    if (!segment_fp)
+        return;
+    
+    unsigned int start_us = us_ticker_read();
+    
+    fseek(segment_fp, 0, SEEK_END);
+    unsigned int file_size = ftell(segment_fp);
+    fseek(segment_fp, 0, SEEK_SET);
+    
+    unsigned int valid_length = (info.log_format == LOG_FORMAT_BINARY) ? scanBinarySegment(segment_fp, info) : scanCSVSegment(segment_fp, info);
+    
+    fclose(segment_fp);
+    
+    info.byte_count = valid_length;
+    
+    if (valid_length < file_size and !truncateLogFile(file_name_string, valid_length)) {
+        TRACE(TRACE_LOG, TRACE_ERROR, "MbedLogger: could not cut %s back to %u bytes\n\r", file_name_string.c_str(), valid_length);
+        return;
+    }
+    
+    if (info.record_count > 0)
+        appendSegmentIndex(info);
+    
+    TRACE(TRACE_LOG, TRACE_WARN, "MbedLogger: %s was not closed, %u records kept, %u bytes cut (%u ms)\n\r", file_name_string.c_str(), info.record_count, file_size - valid_length, (us_ticker_read() - start_us) / 1000);
+}
+
+// a record that was read back from a segment file
+void MbedLogger::addToSegmentInfo(LogSegmentInfo & info, int state, unsigned int wall_time) {
+    if (info.record_count == 0) {
+        info.start_time = wall_time;
+        info.first_state = state;
+    }
+    
+    info.end_time = wall_time;
+    info.last_state = state;
+    info.state_mask |= (1 << (state & 0x1F));
+    info.record_count++;
+}
+
+// heading and whole lines (newline, every column, state number and time), returns the length that is good
+unsigned int MbedLogger::scanCSVSegment(FILE * segment_fp, LogSegmentInfo & info) {
+    char line_buffer[LOG_CSV_MAX_LINE + 2];
+    unsigned int valid_length = 0;
+    
+    while (fgets(line_buffer, sizeof(line_buffer), segment_fp) != NULL) {
+        int length = strlen(line_buffer);
+        
+        //a line cut off by the power going (or zeros where the block never got written)
+        if (length == 0 or line_buffer[length - 1] != '\n')
+            break;
+        
+        int commas = 0;
+        for (int i = 0; i < length; i++) {
+            if (line_buffer[i] == ',')
+                commas++;
+        }
+        
+        if (commas != BINARY_LOG_NUM_FIELDS + 2)
+            break;
+        
+        if (valid_length == 0) {
+            //heading
+            if (strncmp(line_buffer, "StateStr,", 9) != 0)
+                break;
+        }
+        else {
+            int state;
+            unsigned int wall_time;
+            
+            //a field column can be wider than LOG_CSV_FIELD_WIDTH (a big negative value), the columns in front of them can't
+            if (!parseCSVLine(line_buffer, &state, &wall_time))
+                break;
+            
+            addToSegmentInfo(info, state, wall_time);
+        }
+        
+        valid_length += length;
+    }
+    
+    return valid_length;
+}
+
+// file header, then records with a good sync byte, length and CRC16 (stops at the first bad one),
+// returns the length that is good
+unsigned int MbedLogger::scanBinarySegment(FILE * segment_fp, LogSegmentInfo & info) {
+    BinaryLogFileHeader file_header;
+    
+    if (fread(&file_header, 1, sizeof(file_header), segment_fp) != sizeof(file_header) or memcmp(file_header.magic, "FSGB", 4) != 0 or
+        file_header.version != BINARY_LOG_VERSION or file_header.crc != calcCrc16((const uint8_t *)&file_header, offsetof(BinaryLogFileHeader, crc)))
+        return 0;
+    
+    uint8_t * buffer = (uint8_t *)_block_buffer;   //nothing is being logged yet
+    unsigned int buffer_offset = sizeof(file_header);  //file offset of buffer[0]
+    int buffered = 0;
+    int position = 0;
+    
+    unsigned int epoch_seconds = 0;
+    uint64_t epoch_time_us = 0;
+    uint64_t last_time_us = 0;
+    
+    while (1) {
+        //keep a whole record in the buffer
+        if (buffered - position < BINARY_LOG_MAX_RECORD) {
+            memmove(buffer, buffer + position, buffered - position);
+            buffer_offset += position;
+            buffered -= position;
+            position = 0;
+            buffered += fread(buffer + buffered, 1, LOG_BLOCK_BYTES - buffered, segment_fp);
+        }
+        
+        uint8_t * record = buffer + position;
+        int available = buffered - position;
+        
+        if (available < 4 or record[0] != BINARY_LOG_SYNC)
+            break;
+        
+        int length = record[2];
+        
+        if (length < 9 or length > BINARY_LOG_MAX_RECORD or length > available)
+            break;
+        
+        uint16_t crc;
+        memcpy(&crc, record + length - 2, 2);
+        
+        if (crc != calcCrc16(record, length - 2))
+            break;
+        
+        uint32_t time_us_words[2];
+        
+        if (record[1] == BINARY_LOG_TYPE_DATA or record[1] == BINARY_LOG_TYPE_EPOCH) {
+            if (length < BINARY_LOG_RECORD_HEADER + 4 + BINARY_LOG_RECORD_TRAILER)
+                break;
+            
+            memcpy(time_us_words, record + 4, 8);
+            uint64_t time_us = ((uint64_t)time_us_words[1] << 32) | time_us_words[0];
+            
+            if (record[1] == BINARY_LOG_TYPE_EPOCH) {
+                memcpy(&epoch_seconds, record + BINARY_LOG_RECORD_HEADER, 4);
+                epoch_time_us = time_us;
+            }
+            else {
+                last_time_us = time_us;
+                addToSegmentInfo(info, record[3], getWallTime(last_time_us, epoch_seconds, epoch_time_us));
+            }
+        }
+        else if (record[1] == BINARY_LOG_TYPE_DELTA) {
+            uint32_t delta_time_us;
+            
+            if (getVarint(record + 4, length - 7, &delta_time_us) == 0)
+                break;
+            
+            last_time_us += delta_time_us;
+            addToSegmentInfo(info, record[3], getWallTime(last_time_us, epoch_seconds, epoch_time_us));
+        }
+        else {
+            break;
+        }
+        
+        position += length;
+    }
+    
+    return buffer_offset + position;
+}
+
+// LocalFileSystem can't truncate a file, so the good part is copied out and back
+bool MbedLogger::truncateLogFile(const string & file_name_string, unsigned int length) {
+    string temp_file_string = _file_system_string + "LOGTMP.TMP";
+    
+    bool copied = copyFileBytes(file_name_string, temp_file_string, length) and copyFileBytes(temp_file_string, file_name_string, length);
+    
+    remove(temp_file_string.c_str());
+    
+    return copied;
+}
+
+bool MbedLogger::copyFileBytes(const string & from_file_string, const string & to_file_string, unsigned int length) {
+    FILE *from_fp = fopen(from_file_string.c_str(), "rb");
+    
+    if (!from_fp)
+        return false;
+    
+    FILE *to_fp = fopen(to_file_string.c_str(), "wb");
+    
+    if (!to_fp) {
+        fclose(from_fp);
+        return false;
+    }
+    
+    unsigned int copied = 0;
+    
+    while (copied < length) {
+        unsigned int block_length = (length - copied < LOG_BLOCK_BYTES) ? length - copied : LOG_BLOCK_BYTES;
+        
+        if (fread(_block_buffer, 1, block_length, from_fp) != block_length or fwrite(_block_buffer, 1, block_length, to_fp) != block_length)
+            break;
+        
+        copied += block_length;
+    }
+    
+    fclose(from_fp);
+    fclose(to_fp);
+    
+    return (copied == length);
+}
+
+// LOG###.csv or LOG###.BIN file name to segment number (-1 if it isn't a log file)
+int MbedLogger::getLogSegmentNumber(const char * file_name) {
+    if (strncmp(file_name, "LOG", 3) != 0)
+        return -1;
+    
+    if (file_name[3] < '0' or file_name[3] > '9')
+        return -1;
+    
+    return strtol(file_name + 3, NULL, 10);
+}
+
+string MbedLogger::getSegmentFileName(int segment, int log_format) {
+    return getSegmentFileName(_file_system_string, segment, log_format);
+}
+
+// same segment names on any file system (the SD card log sink uses these too)
+string MbedLogger::getSegmentFileName(const string & file_system_string, int segment, int log_format) {
+    char file_name[20];
+    
+    //8.3 file names on the MBED (LocalFileSystem)
+    if (log_format == LOG_FORMAT_BINARY)
+        sprintf(file_name, "LOG%03d.BIN", segment);
+    else
+        sprintf(file_name, "LOG%03d.csv", segment);
+    
+    return file_system_string + file_name;
+}
+
+// start the next segment before the next record is written (call when a dive starts)
+void MbedLogger::startNewLogSegment() {
+    _new_segment_requested = true;
+}
+
+int MbedLogger::getCurrentSegment() {
+    return _current_segment;
+}
+
+// segment used by printCurrentLogFile and the data transmission (defaults to the newest)
+void MbedLogger::setTransmitSegment(int segment) {
+    if (segment < 0)
+        segment = 0;
+    if (segment > LOG_MAX_SEGMENT)
+        segment = LOG_MAX_SEGMENT;
+    
+    _transmit_segment = segment;
+    _transmit_format = getSegmentFormat(segment);
+}
+
+int MbedLogger::getTransmitSegment() {
+    return _transmit_segment;
+}
+
+string MbedLogger::getTransmitFileName() {
+    return getSegmentFileName(_transmit_segment, _transmit_format);
+}
+
+// only CSV segments can be printed and transmitted (their lines are the packets)
+bool MbedLogger::isTransmitSegmentBinary() {
+    if (_transmit_format != LOG_FORMAT_BINARY)
+        return false;
+    
+    serialPrint("MbedLogger: %s is a binary segment, copy it off the MBED drive and decode it with FSG_binary_log_to_csv.py\n\r", getTransmitFileName().c_str());
+    
+    return true;
+}
+
+// format a segment was recorded in: its last SEGMENTS.TXT line, the recording format for the
+// segment being recorded, otherwise whichever file is there
+int MbedLogger::getSegmentFormat(int segment) {
+    int log_format = -1;
+    FILE *index_fp = fopen(_index_file_path_string.c_str(), "r");
+    
+    if (index_fp) {
+        char line_buffer[100];
+        
+        while (fgets(line_buffer, sizeof(line_buffer), index_fp) != NULL) {
+            if (getLogSegmentNumber(line_buffer) == segment)
+                log_format = (strncmp(line_buffer + 6, ".BIN", 4) == 0) ? LOG_FORMAT_BINARY : LOG_FORMAT_CSV;
+        }
+        
+        fclose(index_fp);
+    }
+    
+    if (log_format >= 0)
+        return log_format;
+    
+    if (segment == _current_segment)
+        return _log_format;
+    
+    FILE *segment_fp = fopen(getSegmentFileName(segment, LOG_FORMAT_BINARY).c_str(), "rb");
+    
+    if (segment_fp) {
+        fclose(segment_fp);
+        return LOG_FORMAT_BINARY;
+    }
+    
+    return LOG_FORMAT_CSV;
+}
+
+void MbedLogger::resetSegmentInfo() {
+    _segment_info.segment = _current_segment;
+    _segment_info.log_format = _log_format;
+    _segment_info.start_time = 0;
+    _segment_info.end_time = 0;
+    _segment_info.first_state = -1;
+    _segment_info.last_state = -1;
+    _segment_info.state_mask = 0;
+    _segment_info.record_count = 0;
+    _segment_info.byte_count = 0;
+    _segment_header_sent = false;
+    _file_full_record_due = true;
+}
+
+// open the current segment (a new one is created, one that has been written to is appended to)
+void MbedLogger::openLogSegment() {
+    string file_name_string = getLogFileName();
+    
+    if (_segment_info.byte_count == 0) {
+        _fp = fopen(file_name_string.c_str(), (_log_format == LOG_FORMAT_BINARY) ? "wb" : "w");
+        
+        if (_fp) {
+            TRACE(TRACE_LOG, TRACE_INFO, "MbedLogger: started log segment %s\n\r", file_name_string.c_str());
+        }
+    }
+    else {
+        _fp = fopen(file_name_string.c_str(), (_log_format == LOG_FORMAT_BINARY) ? "ab" : "a");
+    }
+    
+    if (_fp) {
+        _transmit_segment = _current_segment;   //newest data
+        _transmit_format = _log_format;
+    }
+}
+
+// start of a new segment: the heading (CSV) or file header (binary), returns the length
+int MbedLogger::fillSegmentHeader(char * buffer) {
+    int length;
+    
+    if (_log_format == LOG_FORMAT_BINARY) {
+        fillBinaryLogHeader((BinaryLogFileHeader *)buffer);
+        
+        //every segment starts with the wall time anchor so it can be decoded on its own
+        BinaryLogRecord epoch_record;
+        fillEpochRecord(epoch_record);
+        length = sizeof(BinaryLogFileHeader) + encodeBinaryRecord(epoch_record, 0, (uint8_t *)buffer + sizeof(BinaryLogFileHeader));
+    }
+    else {
+        length = _heading_string.length();
+        memcpy(buffer, _heading_string.c_str(), length);
+    }
+    
+    return length;
+}
+
+// close the segment file and record it in the index (the index only changes while the file is open)
+void MbedLogger::closeLogSegment() {
+    closeLogSinkSegments();     //after the bytes they already have
+    
+    if (!_fp)
+        return;
+    
+    closeLogFile();
+    
+    if (_segment_info.record_count > 0)
+        appendSegmentIndex(_segment_info);
+}
+
+// move on to the next segment (the current one is reused if nothing was written to it yet)
+void MbedLogger::rotateLogSegment() {
+    if (_segment_info.record_count == 0)
+        return;
+    
+    closeLogSegment();
+    
+    if (_current_segment < LOG_MAX_SEGMENT) {
+        _current_segment++;
+        resetSegmentInfo();
+    }
+    else {
+        //keep the segment info so the last segment is appended to, not overwritten
+        TRACE(TRACE_LOG, TRACE_WARN, "MbedLogger: out of log segments, appending to %s\n\r", getLogFileName().c_str());
+    }
+}
+
+void MbedLogger::updateSegmentInfo(LogSegmentInfo & segment_info, const BinaryLogRecord & record) {
+    if (segment_info.record_count == 0) {
+        segment_info.start_time = getWallTime(getRecordTime(record));
+        segment_info.first_state = record.state;
+    }
+    
+    segment_info.end_time = getWallTime(getRecordTime(record));
+    segment_info.last_state = record.state;
+    segment_info.state_mask |= (1 << (record.state & 0x1F));
+    segment_info.record_count++;
+}
+
+// one line per segment close: file,start,end,first_state,last_state,state_mask,records,bytes
+void MbedLogger::appendSegmentIndex(const LogSegmentInfo & segment_info) {
+    FILE *index_fp = fopen(_index_file_path_string.c_str(), "a");
+    
+    if (!index_fp) {
+        _write_error_count++;
+        return;
+    }
+    
+    string file_name_string = getSegmentFileName(segment_info.segment, segment_info.log_format);
+    
+    fprintf(index_fp, "%s,%u,%u,%d,%d,%04X,%u,%u\n", file_name_string.c_str() + _file_system_string.length(),
+        segment_info.start_time, segment_info.end_time, segment_info.first_state, segment_info.last_state,
+        segment_info.state_mask, segment_info.record_count, segment_info.byte_count);
+    
+    fclose(index_fp);
+}
+
+// print the segment index (SEGMENTS.TXT)
+void MbedLogger::printSegmentIndex() {
+    FILE *index_fp = fopen(_index_file_path_string.c_str(), "r");
+    
+    if (!index_fp) {
+        serialPrint("\n\rNo log segment index (%s)\n\r", _index_file_path_string.c_str());
+        return;
+    }
+    
+    char line_buffer[100];
+    char file_name[16];
+    LogSegmentInfo info;
+    
+    serialPrint("\n\rLOG SEGMENT INDEX (last line for a segment is the latest):\n\r");
+    serialPrint("  file           start (s)     end (s)   states (first/last/seen)  records      bytes\n\r");
+    
+    while (fgets(line_buffer, sizeof(line_buffer), index_fp) != NULL) {
+        if (sscanf(line_buffer, "%15[^,],%u,%u,%d,%d,%x,%u,%u", file_name, &info.start_time, &info.end_time,
+                   &info.first_state, &info.last_state, &info.state_mask, &info.record_count, &info.byte_count) == 8) {
+            serialPrint("  %-12s %10u  %10u   %2d / %2d / %04X          %7u  %9u\n\r", file_name, info.start_time, info.end_time,
+                info.first_state, info.last_state, info.state_mask, info.record_count, info.byte_count);
+        }
+    }
+    
+    fclose(index_fp);
+    
+    serialPrint("  current segment: %s (%u records), transmit segment: %s\n\r", getLogFileName().c_str(), _segment_info.record_count, getTransmitFileName().c_str());
+}
+
+void MbedLogger::setLogFormat(int log_format) {
+    if (log_format == _log_format)
+        return;
+    
+    //don't switch formats in the middle of a segment
+    flushLogBuffer();
+    rotateLogSegment();
+    
+    _log_format = log_format;
+    _segment_info.log_format = _log_format;
+}
+
+int MbedLogger::getLogFormat() {
+    return _log_format;
+}
+
+// file name of the segment being recorded
+string MbedLogger::getLogFileName() {
+    return getSegmentFileName(_current_segment, _log_format);
+}
+
+// CRC16 of a byte array, crc/256 and crc%256 are the same as calcCrcOne() and calcCrcTwo()
+int MbedLogger::calcCrc16(const uint8_t * buffer, int length, int crc) {
+    for (int i = 0; i < length; i++)
+        crc = (crc16_table[(buffer[i] ^ crc) & 0xff] ^ (crc >> 8)) & 0xFFFF;
+    
+    return crc;
+}
+
+void MbedLogger::fillBinaryLogHeader(BinaryLogFileHeader * file_header) {
+    BinaryLogFileHeader header;
+    memset(&header, 0, sizeof(header));
+    
+    memcpy(header.magic, "FSGB", 4);
+    header.version = BINARY_LOG_VERSION;
+    header.header_size = sizeof(BinaryLogFileHeader);
+    header.record_size = BINARY_LOG_MAX_RECORD;
+    header.num_fields = BINARY_LOG_NUM_FIELDS;
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++)
+        header.decimals[i] = telemetry_log_fields[i].decimals;
+    header.crc = calcCrc16((const uint8_t *)&header, offsetof(BinaryLogFileHeader, crc));
+    
+    memcpy(file_header, &header, sizeof(header));     //the block buffer isn't aligned
+}
+
+void MbedLogger::closeLogFile() {
+    led4() = 1;
+    
+    if (_fp == NULL){
+        TRACE(TRACE_LOG, TRACE_INFO, "MbedLogger: (%s) LOG FILE WAS ALREADY CLOSED!\n\r", _file_system_string.c_str());
+    }
+    
+    else {
+        TRACE(TRACE_LOG, TRACE_INFO, "MbedLogger: (%s) CLOSING LOG FILE!\n\r", _file_system_string.c_str());
+        
+        //close file
+        fclose(_fp);
+                
+        _fp = NULL;     //set pointer to zero
+    }    
+}
+
+// Record data or close the file to regain access to the file system
+// (no file I/O here, drainLogBuffer() opens/writes/closes the file)
+void MbedLogger::appendLogFile(int current_state, int option) {
+    //option one means write to file
+    
+    if (option == 1) {
+        //record data using the recordData function (takes in the state integer)
+        recordData(current_state);
+    }
+    
+    else {
+        //closed by drainLogBuffer() once everything in the buffer is written
+        _close_requested = true;
+    }
+}
+
+// Write one block of buffered records to the log file.  Call this from the main loop
+// when there is slack (not on an FSM tick), each call is at most LOG_BLOCK_BYTES of I/O.
+// The block is formatted once, the log sinks get a copy of it (they write it in serviceLogSinks).
+// The fwrite itself still blocks (LocalFileSystem has no other kind of write), LOG_BLOCK_BYTES is what
+// bounds it, the slowest block is in printLogBufferStats.
+void MbedLogger::drainLogBuffer() {
+    if (_log_buffer.getCount() == 0) {
+        //everything written, close the file if logging stopped
+        if (_close_requested) {
+            _close_requested = false;
+            closeLogSegment();
+        }
+        return;
+    }
+    
+    unsigned int start_us = us_ticker_read();
+    
+    //new dive or this segment is full
+    if (_new_segment_requested or (_segment_info.byte_count >= LOG_SEGMENT_MAX_BYTES and _current_segment < LOG_MAX_SEGMENT)) {
+        _new_segment_requested = false;
+        rotateLogSegment();
+    }
+    
+    if (!_fp)
+        openLogSegment();
     
-    //if the file is empty, create this.
     if (!_fp) {
-        _fp = fopen(file_name_string.c_str(), "w");     //write,print,close
-        //fprintf(_fp,"state_string,state_ID,timer,depth_cmd,depth_ft,pitch_cmd,pitch_deg,bce_cmd,bce_mm,batt_cmd,batt_mm,pitchRate_degs,depthRate_fps\nempty log file!\n");
-        fprintf(_fp,_heading_string.c_str());
-        closeLogFile();
+        _write_error_count++;
+        
+        //records wait in the buffer for the file (the PC can have /local mounted), the sinks only get them
+        //ahead of the file when the buffer is about to overflow, and those records are lost from the file
+        if (!getLogSinksEnabled() or _log_buffer.getCount() < LOG_BUFFER_SIZE - LOG_SINK_ONLY_MARGIN)
+            return;
+    }
+    
+    //The heading/file header goes to the MBED file and to the sinks the first time each of them gets bytes of the
+    //segment.  The MBED file can fail to open while the sinks go on, byte_count only counts what is in the MBED file
+    //(a segment whose MBED file never opened is created with its header when it does open).
+    bool file_header = (_fp and _segment_info.byte_count == 0);
+    bool sink_header = !_segment_header_sent;
+    int header_length = (file_header or sink_header) ? fillSegmentHeader(_block_buffer) : 0;
+    
+    //fill the block with whole records (CSV lines are checked against the longest possible line)
+    //the segment info only counts them once the block is in the MBED file (SEGMENTS.TXT describes the file)
+    int block_length = header_length;
+    LogSegmentInfo block_info = _segment_info;
+    bool full_record = _file_full_record_due;
+    int block_records = 0;
+    
+    while (_log_buffer.getCount() > 0) {
+        BinaryLogRecord * record = _log_buffer.front();
+        
+        int record_bytes;
+        
+        //the CSV line has the wall time in it, EPOCH records only go in the binary log
+        if (record->type != BINARY_LOG_TYPE_DATA and _log_format != LOG_FORMAT_BINARY) {
+            _log_buffer.pop();
+            continue;
+        }
+        
+        if (_log_format == LOG_FORMAT_BINARY) {
+            if (block_length + BINARY_LOG_MAX_RECORD > LOG_BLOCK_BYTES)
+                break;
+            
+            //first data record in the file (or after records it missed) has every field, the decoder starts with nothing
+            uint32_t extra_fields = (record->type == BINARY_LOG_TYPE_DATA and full_record) ? BINARY_LOG_ALL_FIELDS : 0;
+            record_bytes = encodeBinaryRecord(*record, extra_fields, (uint8_t *)_block_buffer + block_length);
+            
+            if (record->type == BINARY_LOG_TYPE_DATA)
+                full_record = false;
+        }
+        else {
+            if (block_length + LOG_CSV_MAX_LINE > LOG_BLOCK_BYTES)
+                break;
+            
+            record_bytes = formatCSVLine(*record, _block_buffer + block_length);
+        }
+        
+        block_length += record_bytes;
+        
+        if (record->type == BINARY_LOG_TYPE_DATA) {
+            updateSegmentInfo(block_info, *record);
+            block_records++;
+        }
+        
+        _log_buffer.pop();
+    }
+    
+    if (_fp) {
+        int skip = file_header ? 0 : header_length;
+        int written = fwrite(_block_buffer + skip, 1, block_length - skip, _fp);
+        
+        if (written == block_length - skip) {
+            _segment_info = block_info;
+            _file_full_record_due = full_record;
+        }
+        else {
+            _write_error_count++;
+            _file_skipped_count += block_records;
+            _file_full_record_due = true;
+        }
+        
+        _segment_info.byte_count += written;
+        _blocks_written++;
+    }
+    else {
+        _file_skipped_count += block_records;
+        _file_full_record_due = true;
+    }
+    
+    int sink_skip = sink_header ? 0 : header_length;
+    writeLogSinks(sink_header ? LOG_SINK_NEW_SEGMENT : 0, _block_buffer + sink_skip, block_length - sink_skip);
+    _segment_header_sent = true;
+    
+    _last_drain_us = us_ticker_read() - start_us;
+    if (_last_drain_us > _max_drain_us)
+        _max_drain_us = _last_drain_us;
+}
+
+// Write out everything in the buffer and close the file (used before the log file is read, sent or erased)
+void MbedLogger::flushLogBuffer() {
+    while (_log_buffer.getCount() > 0) {
+        drainLogBuffer();
+        
+        if (!_fp)
+            break;  //file system not available, don't hang here
+    }
+    
+    _close_requested = false;
+    closeLogSegment();
+}
+
+void MbedLogger::printLogBufferStats() {
+    serialPrint("\n\rLOG BUFFER (%s): %d of %d records waiting (max %d)\n\r", getLogFileName().c_str(), _log_buffer.getCount(), LOG_BUFFER_SIZE, _log_buffer.getHighWaterMark());
+    serialPrint("  records logged: %u, dropped: %u, buffer overflows: %u, values at the field range limit: %u\n\r", _log_buffer.getPushCount(), _log_buffer.getDropCount(), _log_buffer.getOverflowCount(), _clamped_count);
+    serialPrint("  records only in the log sinks (no log file): %u\n\r", _file_skipped_count);
+    serialPrint("  blocks written: %u, write errors: %u, last block: %u us, slowest block: %u us\n\r", _blocks_written, _write_error_count, _last_drain_us, _max_drain_us);
+    
+    printLogSinkStatus();
+}
+
+// another destination for the formatted log (enable it with LogSink::setEnabled)
+void MbedLogger::addLogSink(LogSink * sink) {
+    if (_log_sink_count < LOG_SINK_MAX_SINKS)
+        _log_sinks[_log_sink_count++] = sink;
+}
+
+// Pass queued bytes on to the sinks.  Call this from the main loop when there is slack
+// (each sink does at most its own share of I/O, a slow SD card only fills its own queue).
+void MbedLogger::serviceLogSinks() {
+    for (int i = 0; i < _log_sink_count; i++)
+        _log_sinks[i]->service();
+}
+
+void MbedLogger::printLogSinkStatus() {
+    serialPrint("LOG SINKS (%d):\n\r", _log_sink_count);
+    
+    for (int i = 0; i < _log_sink_count; i++) {
+        serialPrint("  %d:", i + 1);
+        _log_sinks[i]->printStatus();
+    }
+}
+
+LogSink * MbedLogger::getLogSink(int sink_number) {
+    if (sink_number < 1 or sink_number > _log_sink_count)
+        return NULL;
+    
+    return _log_sinks[sink_number - 1];
+}
+
+void MbedLogger::writeLogSinks(int flags, const char * bytes, int length) {
+    for (int i = 0; i < _log_sink_count; i++)
+        _log_sinks[i]->write(_current_segment, _log_format, flags, bytes, length);
+}
+
+void MbedLogger::closeLogSinkSegments() {
+    for (int i = 0; i < _log_sink_count; i++)
+        _log_sinks[i]->closeSegment();
+}
+
+bool MbedLogger::getLogSinksEnabled() {
+    for (int i = 0; i < _log_sink_count; i++) {
+        if (_log_sinks[i]->getEnabled())
+            return true;
+    }
+    
+    return false;
+}
+
+// Get the current time from the mbed
+int MbedLogger::getSystemTime() {
+    time_t seconds = time(NULL);    // Time as seconds since January 1, 1970
+    return seconds;
+}
+
+// Sample the data into a record and put it in the log buffer (the file is written by drainLogBuffer)
+void MbedLogger::recordData(int current_state) {
+    uint64_t data_log_time_us = systemClock().read_us();        //microseconds since power up (64 bit, doesn't roll over)
+    
+    sampleData();
+    
+    //fast and slow fields, gains only if they changed (every field now and then)
+    uint32_t field_mask = _fast_field_mask | _slow_field_mask;
+    
+    if (++_slow_records_since_full >= LOG_FULL_RECORD_INTERVAL) {
+        _slow_records_since_full = 0;
+        field_mask = BINARY_LOG_ALL_FIELDS;
+    }
+    
+    BinaryLogRecord record;
+    fillBinaryRecord(record, current_state, data_log_time_us, field_mask);
+    
+    _log_buffer.push(record);       //dropped (and counted) if the buffer is full
+}
+
+// Sample only the fast fields (binary log, every FSM tick between the 1 Hz records while recording)
+void MbedLogger::recordFastData(int current_state) {
+    if (!_fast_logging or _log_format != LOG_FORMAT_BINARY)
+        return;     //the CSV line has a fixed layout, it stays at 1 Hz
+    
+    uint64_t data_log_time_us = systemClock().read_us();
+    
+    sampleFields(_fast_field_mask);
+    
+    BinaryLogRecord record;
+    fillBinaryRecord(record, current_state, data_log_time_us, _fast_field_mask);
+    
+    _log_buffer.push(record);
+}
+
+void MbedLogger::setFastLogging(bool fast_logging) {
+    _fast_logging = fast_logging;
+}
+
+bool MbedLogger::getFastLogging() {
+    return _fast_logging;
+}
+
+void MbedLogger::sampleData() {
+    sampleFields(BINARY_LOG_ALL_FIELDS);
+}
+
+// read the fields in field_mask into _data_log (the others keep their last reading)
+void MbedLogger::sampleFields(uint32_t field_mask) {
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        if (field_mask & (1UL << i))
+            _data_log[i] = telemetry_log_fields[i].getter();
+    }
+}
+
+// state names indexed by the StateMachine state enumeration (SIT_IDLE = 0 ... MANUAL_TUNING)
+static const char * const log_state_strings[] = {
+    "________SIT_IDLE",
+    "____CHECK_TUNING",
+    "____FIND_NEUTRAL",
+    "____________DIVE",
+    "____________RISE",
+    "___POSITION_DIVE",
+    "___POSITION_RISE",
+    "_____FLOAT_LEVEL",
+    "_FLOAT_BROADCAST",
+    "_EMERGENCY_CLIMB",
+    "______MULTI_DIVE",
+    "______MULTI_RISE",
+    "________KEYBOARD",
+    "_____TX_MBED_LOG",
+    "RECEIVE_SEQUENCE",
+    "_____MANUAL_TUNE"      //new 02/13/2019
+};
+
+const char * MbedLogger::getStateString(int current_state) {
+    if (current_state < 0 or current_state >= (int)(sizeof(log_state_strings) / sizeof(log_state_strings[0])))
+        return "";
+    
+    return log_state_strings[current_state];
+}
+
+// Print one CSV log line from a record into line_buffer (needs LOG_CSV_MAX_LINE bytes), returns the length
+int MbedLogger::formatCSVLine(const BinaryLogRecord & record, char * line_buffer) {
+    //this format is used for data transmission, each line needs to be 254 characters long (not counting newline char)
+    //verified that the old single sprintf generated the correct line length of 254 using SOLELY an mbed 08/16/2018
+    //same characters as sprintf("%16s,%.2d,%10d") and ",%06.*f" per column, but about 10x faster on a host build (no float printf)
+    //the widths are the LOG_CSV_ layout in MbedLogger.hpp, parseCSVLine reads the line back with them
+    const char * state_string = getStateString(record.state);
+    int state_length = strlen(state_string);
+    int length = (state_length < LOG_CSV_STATE_WIDTH) ? LOG_CSV_STATE_WIDTH - state_length : 0;
+    
+    memset(line_buffer, ' ', length);
+    memcpy(line_buffer + length, state_string, state_length);
+    length += state_length;
+    
+    line_buffer[length++] = ',';
+    length += putFixed(line_buffer + length, record.state, LOG_CSV_STATE_NUMBER_WIDTH, 0, '0');
+    line_buffer[length++] = ',';
+    length += putFixed(line_buffer + length, (int)getWallTime(getRecordTime(record)), LOG_CSV_TIME_WIDTH, 0, ' ');
+    
+    //every column is zero padded to 6 characters with the decimals from telemetry_log_fields
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        line_buffer[length++] = ',';
+        length += putScaledInt16(line_buffer + length, record.field[i], LOG_CSV_FIELD_WIDTH, telemetry_log_fields[i].decimals);
     }
-    else
-        closeLogFile();   //close the opened read file
+    
+    line_buffer[length++] = '\n';
+    line_buffer[length] = 0;
+    
+    return length;
 }
 
-void MbedLogger::closeLogFile() {
-    led4() = 1;
+// state number and TimeSec of a CSV log line, false if the columns in front of the fields aren't where formatCSVLine puts them
+bool MbedLogger::parseCSVLine(const char * line_buffer, int * state, unsigned int * wall_time) {
+    if (line_buffer[LOG_CSV_STATE_NUMBER_OFFSET - 1] != ',' or line_buffer[LOG_CSV_TIME_OFFSET - 1] != ',' or line_buffer[LOG_CSV_FIELDS_OFFSET] != ',')
+        return false;
     
-    if (_fp == NULL){
-        serialPrint("MbedLogger: (%s) LOG FILE WAS ALREADY CLOSED!\n\r", _file_system_string.c_str());
-    }
+    char * state_end;
+    char * time_end;
+    *state = strtol(line_buffer + LOG_CSV_STATE_NUMBER_OFFSET, &state_end, 10);
+    *wall_time = strtoul(line_buffer + LOG_CSV_TIME_OFFSET, &time_end, 10);
     
-    else {
-        serialPrint("MbedLogger: (%s) CLOSING LOG FILE!\n\r", _file_system_string.c_str());
+    return (state_end == line_buffer + LOG_CSV_TIME_OFFSET - 1 and time_end == line_buffer + LOG_CSV_FIELDS_OFFSET);
+}
+
+// field_mask is the fields due now, the on-change fields that changed since they were last logged are added
+void MbedLogger::fillBinaryRecord(BinaryLogRecord & record, int current_state, uint64_t data_log_time_us, uint32_t field_mask) {
+    record.sync = BINARY_LOG_SYNC;
+    record.type = BINARY_LOG_TYPE_DATA;
+    record.length = 0;      //set when it is written
+    record.state = current_state;
+    record.time_us_low = (uint32_t)data_log_time_us;
+    record.time_us_high = (uint32_t)(data_log_time_us >> 32);
+    
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        record.field[i] = scaleToInt16(_data_log[i], telemetry_log_fields[i].decimals);
         
-        //close file
-        fclose(_fp);
-                
-        _fp = NULL;     //set pointer to zero
-    }    
+        if (record.field[i] == 32767 or record.field[i] == -32767)
+            _clamped_count++;
+        
+        //compare the scaled values so noise below the logged precision is not a change
+        if ((_change_field_mask & (1UL << i)) and record.field[i] != _last_logged_field[i])
+            field_mask |= (1UL << i);
+        
+        if (field_mask & (1UL << i))
+            _last_logged_field[i] = record.field[i];
+    }
+    
+    record.field_mask = field_mask;
+    record.sequence = _binary_record_sequence++;
 }
 
-// Open the file for reading or close the file to regain access to the file system
-void MbedLogger::appendLogFile(int current_state, int option) {
-    //option one means write to file
+// Pack a record the way it goes in the binary file (only the fields in its mask plus extra_fields), returns the length
+int MbedLogger::encodeBinaryRecord(const BinaryLogRecord & record, uint32_t extra_fields, uint8_t * buffer) {
+    int length = BINARY_LOG_RECORD_HEADER;
     
-    if (option == 1) {
-        if (!_fp) {     //if not present
-            _fp = fopen(_full_file_path_string.c_str(), "a");
+    if (record.type == BINARY_LOG_TYPE_DATA) {
+        uint32_t field_mask = record.field_mask | extra_fields;
+        
+        if (_delta_encoding) {
+            if (field_mask != BINARY_LOG_ALL_FIELDS and ++_records_since_keyframe < LOG_KEYFRAME_INTERVAL) {
+                length = encodeDeltaRecord(record, field_mask, buffer);
+                if (length > 0)
+                    return length;
+            }
+            
+            //keyframe
+            field_mask = BINARY_LOG_ALL_FIELDS;
+            length = BINARY_LOG_RECORD_HEADER;
         }
         
-        //record data using the recordData function (takes in the state integer)
-        recordData(current_state);
+        if (field_mask == BINARY_LOG_ALL_FIELDS)
+            _records_since_keyframe = 0;
+        
+        //the next delta is against what was written here
+        for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+            if (field_mask & (1UL << i))
+                _encoded_field[i] = record.field[i];
+        }
+        _encoded_time_us = getRecordTime(record);
+        
+        memcpy(buffer + length, &field_mask, 4);
+        length += 4;
+        
+        for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+            if (field_mask & (1UL << i)) {
+                memcpy(buffer + length, &record.field[i], 2);
+                length += 2;
+            }
+        }
     }
-    
     else {
-        closeLogFile();
+        memcpy(buffer + length, &record.epoch.epoch_seconds, 4);
+        length += 4;
     }
+    
+    length += BINARY_LOG_RECORD_TRAILER;
+    
+    //sync, type, length, state, time (same layout as the struct)
+    memcpy(buffer, &record, BINARY_LOG_RECORD_HEADER);
+    buffer[2] = length;
+    
+    memcpy(buffer + length - 4, &record.sequence, 2);
+    
+    uint16_t crc = calcCrc16(buffer, length - 2);
+    memcpy(buffer + length - 2, &crc, 2);
+    
+    return length;
 }
 
-// Get the current time from the mbed
-int MbedLogger::getSystemTime() {
-    time_t seconds = time(NULL);    // Time as seconds since January 1, 1970
-    return seconds;
+// DELTA record: sync, type, length, state, then varints of the time since the last record, the mask of
+// the fields that changed and zig-zag(field - last written value) for each, low byte of the sequence, CRC
+// returns 0 if the delta won't fit in BINARY_LOG_MAX_RECORD (write a keyframe instead)
+int MbedLogger::encodeDeltaRecord(const BinaryLogRecord & record, uint32_t field_mask, uint8_t * buffer) {
+    uint64_t delta_time_us = getRecordTime(record) - _encoded_time_us;
+    if (delta_time_us > 0xFFFFFFFFULL)
+        return 0;   //more than 71 minutes since the last record
+    
+    //only the fields that are due and changed
+    uint32_t changed_mask = 0;
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        if ((field_mask & (1UL << i)) and record.field[i] != _encoded_field[i])
+            changed_mask |= (1UL << i);
+    }
+    
+    //worst case is 3 bytes per field, 32 fields would be 113 bytes so build it in a scratch buffer
+    uint8_t delta_buffer[4 + 5 + 5 + 3 * BINARY_LOG_NUM_FIELDS + 3];
+    int length = 4;
+    
+    length += putVarint(delta_buffer + length, (uint32_t)delta_time_us);
+    length += putVarint(delta_buffer + length, changed_mask);
+    
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        if (changed_mask & (1UL << i))
+            length += putVarint(delta_buffer + length, zigZag((int32_t)record.field[i] - (int32_t)_encoded_field[i]));
+    }
+    
+    length += 3;    //sequence (low byte) and CRC
+    
+    if (length > BINARY_LOG_MAX_RECORD)
+        return 0;
+    
+    delta_buffer[0] = BINARY_LOG_SYNC;
+    delta_buffer[1] = BINARY_LOG_TYPE_DELTA;
+    delta_buffer[2] = length;
+    delta_buffer[3] = record.state;
+    delta_buffer[length - 3] = (uint8_t)record.sequence;
+    
+    uint16_t crc = calcCrc16(delta_buffer, length - 2);
+    memcpy(delta_buffer + length - 2, &crc, 2);
+    
+    memcpy(buffer, delta_buffer, length);
+    
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        if (changed_mask & (1UL << i))
+            _encoded_field[i] = record.field[i];
+    }
+    _encoded_time_us = getRecordTime(record);
+    
+    return length;
 }
 
-void MbedLogger::recordData(int current_state) {
-    int data_log_time = mbedLogger().getSystemTime();                 //read the system timer to get unix timestamp
-    
-    _data_log[0] = depthLoop().getCommand();        //depth command
-    _data_log[1] = depthLoop().getPosition();       //depth reading (filtered depth)
-    _data_log[2] = pitchLoop().getCommand();        //pitch command
-    _data_log[3] = pitchLoop().getPosition();       //pitch reading (filtered pitch)
-    _data_log[4] = rudder().getSetPosition_pwm();      //rudder command PWM
-    _data_log[5] = rudder().getSetPosition_deg();      //rudder command DEG
-    _data_log[6] = headingLoop().getPosition();     //heading reading (filtered heading)
-    
-    _data_log[7] = bce().getSetPosition_mm();       //BCE command
-    _data_log[8] = bce().getPosition_mm();          //BCE reading
-    _data_log[9] = batt().getSetPosition_mm();      //Batt command
-    _data_log[10] = batt().getPosition_mm();         //Batt reading    
-    _data_log[11] = pitchLoop().getVelocity();       // pitchRate_degs (degrees per second)
-    _data_log[12] = depthLoop().getVelocity();      // depthRate_fps (feet per second)
-    
-    _data_log[13] = sensors().getCurrentInput();      // i_in
-    _data_log[14] = sensors().getVoltageInput();      // v_in
-    _data_log[15] = sensors().getAltimeterChannelReadings();   // Altimeter Channel Readings
-    _data_log[16] = sensors().getInternalPressurePSI();   // int_press_PSI
-    
-    //BCE_p,i,d,freq,deadband
-    _data_log[17] = bce().getControllerP();
-    _data_log[18] = bce().getControllerI();
-    _data_log[19] = bce().getControllerD();
-    
-    _data_log[20] = batt().getControllerP();
-    _data_log[21] = batt().getControllerI();
-    _data_log[22] = batt().getControllerD();
-    
-    _data_log[23] = depthLoop().getControllerP();
-    _data_log[24] = depthLoop().getControllerI();
-    _data_log[25] = depthLoop().getControllerD();
-    
-    _data_log[26] = pitchLoop().getControllerP();
-    _data_log[27] = pitchLoop().getControllerI();
-    _data_log[28] = pitchLoop().getControllerD();
-    
-    _data_log[29] = headingLoop().getControllerP();
-    _data_log[30] = headingLoop().getControllerI();
-    _data_log[31] = headingLoop().getControllerD();
-    
-    string string_state;
-    if (current_state == SIT_IDLE)
-        string_state = "________SIT_IDLE";
-    else if (current_state == FIND_NEUTRAL)
-        string_state = "____FIND_NEUTRAL";
-    else if (current_state == DIVE)
-        string_state = "____________DIVE";
-    else if (current_state == RISE)
-        string_state = "____________RISE";
-    else if (current_state == FLOAT_LEVEL)
-        string_state = "_____FLOAT_LEVEL";
-    else if (current_state == FLOAT_BROADCAST)
-        string_state = "_FLOAT_BROADCAST";          
-    else if (current_state == EMERGENCY_CLIMB)
-        string_state = "_EMERGENCY_CLIMB";
-    else if (current_state == MULTI_DIVE)
-        string_state = "______MULTI_DIVE";
-    else if (current_state == MULTI_RISE)
-        string_state = "______MULTI_RISE";
-    else if (current_state == KEYBOARD)
-        string_state = "________KEYBOARD";
-    else if (current_state == CHECK_TUNING)
-        string_state = "____CHECK_TUNING";
-    else if (current_state == POSITION_DIVE)
-        string_state = "___POSITION_DIVE"; 
-    else if (current_state == POSITION_RISE)
-        string_state = "___POSITION_RISE";
-    else if (current_state == TX_MBED_LOG) 
-        string_state = "_____TX_MBED_LOG";
-    else if (current_state == RX_SEQUENCE) 
-        string_state = "RECEIVE_SEQUENCE";
-    else if (current_state == MANUAL_TUNING)    //new 02/13/2019
-        string_state = "_____MANUAL_TUNE";   
-        
-    string blank_space = ""; //to get consistent spacing in the file (had a nonsense char w/o this)
-    
-    //below this format is used for data transmission, each packet needs to be 254 characters long (not counting newline char)
-    
-    //verified that this generates the correct line length of 254 using SOLELY an mbed 08/16/2018
-    fprintf(_fp, "%16s,%.2d,%10d,%06.1f,%06.1f,%06.1f,%06.1f,%06.0f,%06.0f,%06.1f,%06.1f,%06.1f,%06.1f,%06.1f,%06.1f,%06.1f,%06.3f,%06.2f,%06.0f,%06.2f,%06.3f,%06.3f,%06.3f,%06.3f,%06.3f,%06.3f,%06.2f,%06.3f,%06.3f,%06.3f,%06.3f,%06.3f,%06.3f,%06.3f,%06.3f\n",
-    string_state.c_str(),current_state,data_log_time,
-    _data_log[0],_data_log[1],_data_log[2],_data_log[3],_data_log[4],_data_log[5],_data_log[6],_data_log[7],_data_log[8],_data_log[9],_data_log[10],_data_log[11],_data_log[12],_data_log[13],_data_log[14],_data_log[15],
-    _data_log[16],_data_log[17],_data_log[18],_data_log[19],_data_log[20],_data_log[21],_data_log[22],_data_log[23],_data_log[24],_data_log[25],_data_log[26],_data_log[27],_data_log[28],_data_log[29],_data_log[30],
-    _data_log[31]);
-
-    //each line in the file is 160 characters long text-wise, check this with a file read
+void MbedLogger::setDeltaEncoding(bool delta_encoding) {
+    if (delta_encoding == _delta_encoding)
+        return;
+    
+    //the encoding changes at a segment boundary (the next segment starts with a keyframe anyway)
+    flushLogBuffer();
+    rotateLogSegment();
+    
+    _delta_encoding = delta_encoding;
+}
+
+bool MbedLogger::getDeltaEncoding() {
+    return _delta_encoding;
+}
+
+// Wall time anchor: the wall time from setLogTime and the microsecond time stamp it was set at
+void MbedLogger::fillEpochRecord(BinaryLogRecord & record) {
+    memset(&record, 0, sizeof(record));
+    
+    record.sync = BINARY_LOG_SYNC;
+    record.type = BINARY_LOG_TYPE_EPOCH;
+    record.time_us_low = (uint32_t)_epoch_time_us;
+    record.time_us_high = (uint32_t)(_epoch_time_us >> 32);
+    record.epoch.epoch_seconds = _epoch_seconds;
+    record.sequence = _binary_record_sequence;      //not counted, only data records are numbered
+}
+
+uint64_t MbedLogger::getRecordTime(const BinaryLogRecord & record) {
+    return ((uint64_t)record.time_us_high << 32) | record.time_us_low;
 }
 
 int MbedLogger::getNumberOfPacketsInCurrentLog() {    
     //takes less than a second to complete, verified 7/24/2018
    
-    //open the file
-    string file_name_string = _file_system_string + "LOG000.csv";
-    _fp = fopen(file_name_string.c_str(), "r");
+    flushLogBuffer();   //everything recorded so far is in the file
+    
+    if (isTransmitSegmentBinary()) {
+        _total_number_of_packets = 0;
+        return 0;
+    }
+    
+    //open the file (not _fp, logging can go on during a download)
+    string file_name_string = getTransmitFileName();
+    FILE *fp = fopen(file_name_string.c_str(), "r");
     
-    fseek(_fp, 0L, SEEK_END);
+    if (!fp) {
+        serialPrint("MbedLogger: %s not found\n\r", file_name_string.c_str());
+        _total_number_of_packets = 0;
+        return 0;
+    }
+    
+    fseek(fp, 0L, SEEK_END);
        
-    size_t size = ftell(_fp);
-
-    //move the FILE pointer back to the start
-    fseek(_fp, 0, SEEK_SET);        // SEEK_SET is the beginning of file
+    size_t size = ftell(fp);
     
-    _total_number_of_packets = size/254;
+    //whole lines (heading is packet 0), each one is 254 characters and the newline
+    _total_number_of_packets = size / (LOG_CSV_LINE_LENGTH + 1);
     
     //CLOSE THE FILE
-    closeLogFile();
+    fclose(fp);
     
     return _total_number_of_packets;
 }
@@ -263,22 +1447,37 @@ void MbedLogger::printMbedDirectory() {
             
             loop++;
         }
+        
+        closedir(dir);
     }
+    
+    //segment times, states and sizes
+    printSegmentIndex();
 }
 
 //prints current log file to the screen (terminal)
 void MbedLogger::printCurrentLogFile() {
+    flushLogBuffer();   //everything recorded so far is in the file
+    
+    if (isTransmitSegmentBinary())
+        return;
+    
     //open the file for reading
-    string file_name_string = _file_system_string + "LOG000.csv";
+    string file_name_string = getTransmitFileName();
     
     _log_file_line_counter = 0;
 
     _fp = fopen(file_name_string.c_str(), "r");
+    
+    if (!_fp) {
+        serialPrint("\n\r%s not found\n\r", file_name_string.c_str());
+        return;
+    }
        
     char buffer[500];
     
     //read the file line-by-line and print that to the screen
-    serialPrint("\n\rCURRENT MBED LOG FILE /local/Log000.csv:\n\n\r");
+    serialPrint("\n\rCURRENT MBED LOG FILE %s:\n\n\r", file_name_string.c_str());
     while (!feof(_fp)) {
         // read in the line and make sure it was successful
         if (fgets(buffer,500,_fp) != NULL) {            //stops at new line
@@ -296,212 +1495,882 @@ void MbedLogger::printCurrentLogFile() {
 }
 
 void MbedLogger::transmitDataPacket() {
-    //WRITE the data (in bytes) to the serial port
-    for (_it=_data_packet.begin(); _it < _data_packet.end(); _it++) {
-        xbee().putc(*_it); //send integers over serial port one byte at a time
+    //WRITE the data (in bytes) to the serial port, copied into the TX buffer in one go
+    if (!_data_packet.empty())
+        xbee().write(&_data_packet[0], _data_packet.size());
+}
+
+//transmit log file with fixed length of characters to receiver program
+void MbedLogger::transmitPacketNumber(int line_number) {
+    int line_size = LOG_CSV_LINE_LENGTH;    //length of lines in the log file, EVERY LINE MUST BE THE SAME LENGTH
+    char line_buffer[LOG_CSV_LINE_LENGTH]; //line buffer used to read file line by line
+        
+    fseek(_transmit_fp,(line_size+1)*line_number,SEEK_SET);      //fseek must use the +1 to get the newline character
+           
+    //write over the internal _line_buffer               //start from the beginning and go to this position   
+    fread(line_buffer, 1, line_size, _transmit_fp);              //read the line (LOG_CSV_LINE_LENGTH characters, without the newline)
+    
+    //serialPrint("Debug (transmitPacketNumber): line_buffer <<%s>> (line size: %d)\n\r", line_buffer,line_size);
+    
+    //    createDataPacket requires _packet_number, _total_number_of_packets, _current_line_length (data packet size)
+    //    uses char _line_buffer[256] variable to hold characters read from the file
+    //    packs this into a vector for transmission                 
+    
+    //change the internal member variable for packet number, reorg this later
+    _packet_number = line_number;   
+    
+    createDataPacket(line_buffer, line_size);  //create the data packet from the _line_buffer (char array)
+
+    transmitDataPacket();   //transmit the assembled packet
+}
+
+// CRC bytes of _data_packet (the same calcCrc16 as every other packet and the binary log)
+int MbedLogger::calcCrcOne() {
+    if (_data_packet.empty())
+        return 0;
+    
+    return calcCrc16(&_data_packet[0], _data_packet.size()) / 256;   //second-to-last byte
+}
+
+int MbedLogger::calcCrcTwo() {
+    if (_data_packet.empty())
+        return 0;
+    
+    return calcCrc16(&_data_packet[0], _data_packet.size()) % 256;   //last byte
+}
+
+//new 6/27/2018, create data packet
+void MbedLogger::createDataPacket(char line_buffer_sent[], int line_length_sent) {     
+    // packet is 7565 0001 FFFF EEEE CC DATA DATA DATA ... CRC1 CRC2
+    
+    //CLEAR: Removes all elements from the vector (which are destroyed), leaving the container with a size of 0.
+    _data_packet.clear();
+    
+    //DATA PACKET HEADER
+    _data_packet.push_back(117);                             //0x75
+    _data_packet.push_back(101);                             //0x65    
+    
+    _data_packet.push_back(_packet_number/256);                //current packet number in 0x#### form
+    _data_packet.push_back(_packet_number%256);                //current packet number in 0x#### form
+    
+    _data_packet.push_back(_total_number_of_packets/256);                //total number of packets, 0x#### form
+    _data_packet.push_back(_total_number_of_packets%256);                //total number of packets, 0x#### form
+    
+    _data_packet.push_back(line_length_sent);
+
+    //serialPrint("DEBUG: Current line buffer: %s\n\r", _line_buffer);        //debug
+
+    //DATA FROM LINE READ (read string character by chracter)
+    for (int i = 0; i < line_length_sent; i++) {
+        _data_packet.push_back(line_buffer_sent[i]);
+    }
+    
+    //CRC CALCULATIONS BELOW
+    //character version of calculation messes up on null character 0x00, scrapped and using vector of integers
+
+    int crc_one = calcCrcOne();
+    int crc_two = calcCrcTwo();
+    
+    //place the crc bytes into the data packet that is transmitted
+    _data_packet.push_back(crc_one);
+    _data_packet.push_back(crc_two);
+    
+    //serialPrint("debug createDataPacket(char line_buffer_sent[], int line_length_sent)\n\r");
+}
+
+// PC requests are 0x75 0x65 packet# (2 bytes) CRC (2 bytes), the reply is that line of the transmit segment
+// a query packet (0x75 0x71, see receiveLogQuery) switches the requests to the matching lines until 0x10 0x10
+// a window acknowledgement (0x75 0x61, see receiveWindowAck) streams the segment instead of one line per request
+// an identity request (0x75 0x69, see receiveIdentityRequest) picks the segment and tells the PC if it can resume
+// the download runs from the main loop (serviceLogTransmit) so the state machine and logging keep going
+bool MbedLogger::startLogTransmit() {
+    if (isTransferRunning()) {
+        serialPrint("MbedLogger: a log download or sequence upload is running already\n\r");
+        return false;
+    }
+    
+    _query_active = false;
+    _window_active = false;
+    
+//GET TOTAL NUMBER OF PACKETS!
+    getNumberOfPacketsInCurrentLog();
+//GET TOTAL NUMBER OF PACKETS!
+    
+    //binary segment (already said so above)
+    if (_transmit_format == LOG_FORMAT_BINARY)
+        return false;
+        
+    //open the file
+    string file_name_string = getTransmitFileName();
+    _transmit_fp = fopen(file_name_string.c_str(), "r");
+    
+    if (!_transmit_fp)
+        return false;
+    
+    //packets wait in the TX buffer for the radio, a small buffer still works (a packet goes when it is empty)
+    xbee().txBufferSetSize(LOG_TRANSMIT_TX_BUFFER, false);
+    _transmit_restore_buffer = false;
+    
+    //status lines on the XBee would take the radio time and land between the packets
+    _transmit_trace_categories = trace().getPortCategories(TRACE_PORT_XBEE);
+    trace().setPortCategories(TRACE_PORT_XBEE, 0);
+    TRACE(TRACE_LOG, TRACE_DEBUG, "MbedLogger: log download of %s started (%d lines)\n\r", file_name_string.c_str(), _total_number_of_packets);
+    
+    //DEFAULT STATE
+    _transmit_state = HEADER_117;
+    _transmit_bytes = 0;
+    _transmit_last_byte_us = systemClock().read_us();
+    _transmit_running = true;
+    
+    return true;
+}
+
+// one step of the download: the next request from the PC, then window packets while the TX buffer has room
+void MbedLogger::serviceLogTransmit() {
+    //the TX buffer can only get smaller when the last packets have gone
+    if (_transmit_restore_buffer and xbee().txBufferGetCount() < MODSERIAL_DEFAULT_TX_BUFFER_SIZE) {
+        if (xbee().txBufferSetSize(MODSERIAL_DEFAULT_TX_BUFFER_SIZE, false) == MODSERIAL::Ok)
+            _transmit_restore_buffer = false;
+    }
+    
+    if (!_transmit_running)
+        return;
+    
+    uint64_t now_us = systemClock().read_us();
+    
+    if (xbee().readable()) {
+        _transmit_last_byte_us = now_us;
+        
+        if (!checkForTransmitRequest()) {
+            finishLogTransmit();
+            return;
+        }
+    }
+    
+    sendWindowPackets();
+    
+    if (now_us - _transmit_last_byte_us > (uint64_t)LOG_TRANSMIT_TIMEOUT_MS * 1000) {
+        serialPrint("MbedLogger: log transmit stopped, nothing from the PC for %d seconds\n\r", LOG_TRANSMIT_TIMEOUT_MS / 1000);
+        finishLogTransmit();
+    }
+}
+
+bool MbedLogger::isTransmittingLog() {
+    return _transmit_running;
+}
+
+bool MbedLogger::isTransferRunning() {
+    return _transmit_running or _upload_running;
+}
+
+// reads until a request is complete (and answered) or there are no more bytes, false when the PC ended the download
+bool MbedLogger::checkForTransmitRequest() {
+    while (xbee().readable()) {
+        //INCOMING BYTE
+        int current_byte = xbee().getc();
+        
+        //provide the next byte / state
+        
+        switch (_transmit_state) {
+            case HEADER_117:
+                if (current_byte == 0x75) { 
+                    _transmit_state = HEADER_101;
+                }
+                else if (current_byte == 0x10) {
+                    _transmit_state = END_TX_1;
+                }
+                break;
+            case HEADER_101:
+                if (current_byte == 0x65) { 
+                    _transmit_state = PACKET_NO_1;
+                }
+                else if (current_byte == 0x71) {    //'q' log query
+                    _transmit_state = QUERY_PACKET;
+                }
+                else if (current_byte == 0x61) {    //'a' window acknowledgement
+                    _transmit_state = ACK_PACKET;
+                }
+                else if (current_byte == 0x69) {    //'i' segment identity
+                    _transmit_state = IDENTITY_PACKET;
+                }
+                else if (current_byte != 0x75) {
+                    _transmit_state = HEADER_117;
+                }
+                
+                _transmit_request[0] = 0x75;
+                _transmit_request[1] = current_byte;
+                _transmit_bytes = 2;
+                break;
+            case PACKET_NO_1:
+                _transmit_request_packet = current_byte * 256;
+                _transmit_state = PACKET_NO_2;
+                break;
+            
+            case PACKET_NO_2:
+                _transmit_request_packet = _transmit_request_packet + current_byte;
+                _transmit_state = PACKET_CRC_ONE;
+                break;
+                
+            case PACKET_CRC_ONE:
+                _transmit_state = PACKET_CRC_TWO;
+                break;
+            
+            case PACKET_CRC_TWO:
+                _transmit_state = HEADER_117;
+                if (_query_active)
+                    transmitQueryPacket(_transmit_request_packet);
+                else
+                    transmitPacketNumber(_transmit_request_packet);
+                return true;
+            
+            case QUERY_PACKET:
+                _transmit_request[_transmit_bytes++] = current_byte;
+                
+                if (_transmit_bytes == LOG_QUERY_PACKET_SIZE) {
+                    _transmit_state = HEADER_117;
+                    receiveLogQuery(_transmit_request);
+                    return true;
+                }
+                break;
+            
+            case ACK_PACKET:
+                _transmit_request[_transmit_bytes++] = current_byte;
+                
+                if (_transmit_bytes == LOG_ACK_PACKET_SIZE) {
+                    _transmit_state = HEADER_117;
+                    receiveWindowAck(_transmit_request);
+                    return true;
+                }
+                break;
+            
+            case IDENTITY_PACKET:
+                _transmit_request[_transmit_bytes++] = current_byte;
+                
+                if (_transmit_bytes == LOG_IDENTITY_PACKET_SIZE) {
+                    _transmit_state = HEADER_117;
+                    receiveIdentityRequest(_transmit_request);
+                    return true;
+                }
+                break;
+                
+            case END_TX_1:
+                _transmit_state = END_TX_2;
+                break;
+            case END_TX_2:
+                _transmit_state = HEADER_117;
+                return false;
+            
+            default:
+                //reset state
+                _transmit_state = HEADER_117; //reset here
+                break;
+        }
+    }
+    
+    return true;
+}
+
+void MbedLogger::finishLogTransmit() {
+    //CLOSE THE FILE
+    if (_transmit_fp) {
+        fclose(_transmit_fp);
+        _transmit_fp = NULL;
+    }
+    
+    _query_active = false;
+    _window_active = false;
+    _transmit_running = false;
+    _transmit_restore_buffer = true;
+    
+    //before the XBee gets its categories back, the PC is still reading packets
+    TRACE(TRACE_LOG, TRACE_DEBUG, "MbedLogger: log download of %s finished\n\r", getTransmitFileName().c_str());
+    trace().setPortCategories(TRACE_PORT_XBEE, _transmit_trace_categories);
+}
+
+// 0x75 0x61, window (1 byte), first missing packet (2), received bitmap (4), flags (1), CRC (2), high byte first
+// bit n of the bitmap is packet first missing + 1 + n, flag bit 0 means the PC heard nothing for a while,
+// flag bit 1 asks for compressed blocks (see transmitCompressedBlock) instead of lines,
+// bits 4 to 7 for a parity packet after that many new packets (see transmitParityPacket, 0 or 1 for none)
+// no reply to a bad acknowledgement, the PC sends another one when the packets stop
+bool MbedLogger::receiveWindowAck(const uint8_t * packet) {
+    int crc = calcCrc16(packet, LOG_ACK_PACKET_SIZE - 2);
+    
+    if (packet[10] != crc / 256 or packet[11] != crc % 256)
+        return false;
+    
+    if (_query_active)      //queries are still one packet per request, the total isn't known up front
+        return false;
+    
+    int window = packet[2];
+    int first_missing = (packet[3] << 8) | packet[4];
+    uint32_t received_mask = ((uint32_t)packet[5] << 24) | (packet[6] << 16) | (packet[7] << 8) | packet[8];
+    bool resend_missing = packet[9] & 0x01;
+    bool compressed = packet[9] & 0x02;
+    int parity_group = packet[9] >> 4;
+    
+    serviceTransmitWindow(window, first_missing, received_mask, resend_missing, compressed, parity_group);
+    return true;
+}
+
+// selective repeat: mark the holes the PC reported to be sent again and move the window (sendWindowPackets sends them)
+// a hole is only sent again if the PC has a packet that was sent after it (lost, not still on the way) or it timed out
+void MbedLogger::serviceTransmitWindow(int window, int first_missing, uint32_t received_mask, bool resend_missing, bool compressed, int parity_group) {
+    if (window < 1)
+        window = 1;
+    if (window > LOG_WINDOW_MAX_PACKETS)
+        window = LOG_WINDOW_MAX_PACKETS;
+    
+    //first acknowledgement of the transfer, the PC has packets we never sent (it is resuming) or it changed the packets
+    if (!_window_active or first_missing > _window_next_packet or compressed != _window_compressed) {
+        _window_active = true;
+        _window_compressed = compressed;
+        _window_next_packet = first_missing;
+        _window_send_count = 0;
+        memset(_window_sent_at, 0, sizeof(_window_sent_at));
+        memset(_window_resend, 0, sizeof(_window_resend));
+        
+        if (_window_compressed)
+            _window_total = (_total_number_of_packets + LOG_COMPRESS_BLOCK_LINES - 1) / LOG_COMPRESS_BLOCK_LINES;
+        else
+            _window_total = _total_number_of_packets;
+        
+        _parity_count = 0;
+        _parity_due = false;
+    }
+    
+    if (parity_group != _parity_group) {
+        _parity_group = parity_group;
+        _parity_count = 0;
+        _parity_due = false;
+    }
+    
+    unsigned int received_sent_at = 0;      //when the latest packet the PC has was sent
+    for (int bit = 0; bit < LOG_WINDOW_MAX_PACKETS; bit++) {
+        if (received_mask & ((uint32_t)1 << bit)) {
+            unsigned int sent_at = _window_sent_at[(first_missing + 1 + bit) % (LOG_WINDOW_MAX_PACKETS + 1)];
+            if (sent_at > received_sent_at)
+                received_sent_at = sent_at;
+        }
+    }
+    
+    int last_sent = _window_next_packet;
+    if (last_sent > first_missing + 1 + LOG_WINDOW_MAX_PACKETS)
+        last_sent = first_missing + 1 + LOG_WINDOW_MAX_PACKETS;
+    
+    for (int packet = first_missing; packet < last_sent and packet < _window_total; packet++) {
+        int bit = packet - first_missing - 1;
+        
+        if (bit >= 0 and (received_mask & ((uint32_t)1 << bit)))
+            continue;
+        
+        //the PC can rebuild it when the parity packet of its group gets there
+        bool parity_to_come = (_parity_count > 0 and packet >= _parity_first and packet < _parity_first + _parity_count);
+        
+        int slot = packet % (LOG_WINDOW_MAX_PACKETS + 1);
+        
+        if (resend_missing or (_window_sent_at[slot] < received_sent_at and !parity_to_come))
+            _window_resend[slot] = true;
     }
+    
+    _window_first_missing = first_missing;
+    _window_received_mask = received_mask;
+    _window_limit = first_missing + window;
+    
+    sendWindowPackets();
 }
 
-//transmit log file with fixed length of characters to receiver program
-void MbedLogger::transmitPacketNumber(int line_number) {
-    int line_size = 254;    //length of lines in the log file, EVERY LINE MUST BE THE SAME LENGTH
-    char line_buffer[254]; //line buffer used to read file line by line
-        
-    fseek(_fp,(line_size+1)*line_number,SEEK_SET);      //fseek must use the +1 to get the newline character
-           
-    //write over the internal _line_buffer               //start from the beginning and go to this position   
-    fread(line_buffer, 1, line_size, _fp);              //read the line that is exactly 160 characters long
+// the holes first, then new packets until the window is full, as many as the TX buffer has room for
+// (the rest go on the next main loop tick, the radio is slower than the UART)
+void MbedLogger::sendWindowPackets() {
+    if (!_window_active)
+        return;
     
-    //serialPrint("Debug (transmitPacketNumber): line_buffer <<%s>> (line size: %d)\n\r", line_buffer,line_size);
+    if (!sendDueParityPacket())
+        return;
     
-    //    createDataPacket requires _packet_number, _total_number_of_packets, _current_line_length (data packet size)
-    //    uses char _line_buffer[256] variable to hold characters read from the file
-    //    packs this into a vector for transmission                 
+    int room = getWindowPacketRoom();
     
-    //change the internal member variable for packet number, reorg this later
-    _packet_number = line_number;   
+    int last_sent = _window_next_packet;
+    if (last_sent > _window_first_missing + 1 + LOG_WINDOW_MAX_PACKETS)
+        last_sent = _window_first_missing + 1 + LOG_WINDOW_MAX_PACKETS;
     
-    createDataPacket(line_buffer, line_size);  //create the data packet from the _line_buffer (char array)
-
-    transmitDataPacket();   //transmit the assembled packet
+    for (int packet = _window_first_missing; packet < last_sent and packet < _window_total; packet++) {
+        int slot = packet % (LOG_WINDOW_MAX_PACKETS + 1);
+        int bit = packet - _window_first_missing - 1;
+        
+        if (!_window_resend[slot] or (bit >= 0 and (_window_received_mask & ((uint32_t)1 << bit))))
+            continue;
+        
+        if (!hasTransmitRoom(room))
+            return;
+        
+        transmitWindowPacket(packet, false);
+        _window_sent_at[slot] = ++_window_send_count;
+        _window_resend[slot] = false;
+    }
+    
+    while (_window_next_packet < _window_total and _window_next_packet < _window_limit) {
+        int slot = _window_next_packet % (LOG_WINDOW_MAX_PACKETS + 1);
+        int bit = _window_next_packet - _window_first_missing - 1;
+        
+        //a resumed download has packets from the last session
+        if (bit < 0 or !(_window_received_mask & ((uint32_t)1 << bit))) {
+            if (!sendDueParityPacket() or !hasTransmitRoom(room))
+                return;
+            
+            transmitWindowPacket(_window_next_packet, true);
+            _window_sent_at[slot] = ++_window_send_count;
+        }
+        _window_resend[slot] = false;
+        _window_next_packet++;
+    }
 }
 
-
-// Using vector was faster in testing than passing the arrays
-int MbedLogger::calcCrcOne() {
-    //can't initialize the table in the constructor in c++
-    int crc_table [256] = {0, 49345, 49537, 320, 49921, 960, 640, 49729, 50689, 1728, 1920, 51009, 1280, 50625, 50305,  1088, 52225,  3264,  3456, 52545,  3840, 53185, 52865,  3648,  2560, 51905, 52097,  2880, 51457,  2496,  2176, 51265, 55297,  6336,  6528, 55617,  6912, 56257, 55937,  6720,  7680, 57025, 57217,  8000, 56577,  7616,  7296, 56385,  5120, 54465, 54657,  5440, 55041,  6080,  5760, 54849, 53761,  4800,  4992, 54081,  4352, 53697, 53377,  4160, 61441, 12480, 12672, 61761, 13056, 62401, 62081, 12864, 13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529, 15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089, 64001, 15040, 15232, 64321, 14592, 63937, 63617, 14400, 10240, 59585, 59777, 10560, 60161, 11200, 10880, 59969, 60929, 11968, 12160, 61249, 11520, 60865, 60545, 11328, 58369,  9408,  9600, 58689,  9984, 59329, 59009,  9792,  8704, 58049, 58241,  9024, 57601,  8640,  8320, 57409, 40961, 24768, 24960, 41281, 25344, 41921, 41601, 25152, 26112, 42689, 42881, 26432, 42241, 26048, 25728, 42049, 27648, 44225, 44417, 27968, 44801, 28608, 28288, 44609, 43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688, 30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681, 48641, 32448, 32640, 48961, 32000, 48577, 48257, 31808, 46081, 29888, 30080, 46401, 30464, 47041, 46721, 30272, 29184, 45761, 45953, 29504, 45313, 29120, 28800, 45121, 20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441, 38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568, 39937, 23744, 23936, 40257, 24320, 40897, 40577, 24128, 23040, 39617, 39809, 23360, 39169, 22976, 22656, 38977, 34817, 18624, 18816, 35137, 19200, 35777, 35457, 19008, 19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905, 17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369, 33281, 17088, 17280, 33601, 16640, 33217, 32897, 16448};
+// longest packet transmitWindowPacket can send (a parity packet waits for room of its own, see sendDueParityPacket)
+int MbedLogger::getWindowPacketRoom() {
+    if (_window_compressed)
+        return 10 + LOG_COMPRESS_BLOCK_LINES * (LOG_CSV_LINE_LENGTH + 1) + 2;
     
-    int crc = 0;
-    for (_it=_data_packet.begin(); _it < _data_packet.end(); _it++)
-        crc = (crc_table[(*_it ^ crc) & 0xff] ^ (crc >> 8)) & 0xFFFF;
-
-    return crc / 256; //second-to-last byte
+    return 7 + LOG_CSV_LINE_LENGTH + 2;
 }
 
-// Using vector was faster in testing than passing the arrays
-int MbedLogger::calcCrcTwo() {
-    int crc_table [256] = {0, 49345, 49537, 320, 49921, 960, 640, 49729, 50689, 1728, 1920, 51009, 1280, 50625, 50305,  1088, 52225,  3264,  3456, 52545,  3840, 53185, 52865,  3648,  2560, 51905, 52097,  2880, 51457,  2496,  2176, 51265, 55297,  6336,  6528, 55617,  6912, 56257, 55937,  6720,  7680, 57025, 57217,  8000, 56577,  7616,  7296, 56385,  5120, 54465, 54657,  5440, 55041,  6080,  5760, 54849, 53761,  4800,  4992, 54081,  4352, 53697, 53377,  4160, 61441, 12480, 12672, 61761, 13056, 62401, 62081, 12864, 13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529, 15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089, 64001, 15040, 15232, 64321, 14592, 63937, 63617, 14400, 10240, 59585, 59777, 10560, 60161, 11200, 10880, 59969, 60929, 11968, 12160, 61249, 11520, 60865, 60545, 11328, 58369,  9408,  9600, 58689,  9984, 59329, 59009,  9792,  8704, 58049, 58241,  9024, 57601,  8640,  8320, 57409, 40961, 24768, 24960, 41281, 25344, 41921, 41601, 25152, 26112, 42689, 42881, 26432, 42241, 26048, 25728, 42049, 27648, 44225, 44417, 27968, 44801, 28608, 28288, 44609, 43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688, 30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681, 48641, 32448, 32640, 48961, 32000, 48577, 48257, 31808, 46081, 29888, 30080, 46401, 30464, 47041, 46721, 30272, 29184, 45761, 45953, 29504, 45313, 29120, 28800, 45121, 20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441, 38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568, 39937, 23744, 23936, 40257, 24320, 40897, 40577, 24128, 23040, 39617, 39809, 23360, 39169, 22976, 22656, 38977, 34817, 18624, 18816, 35137, 19200, 35777, 35457, 19008, 19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905, 17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369, 33281, 17088, 17280, 33601, 16640, 33217, 32897, 16448};
+// parity packet of the last complete group, before any new packet (a new packet would start the next group)
+// false if it is still waiting for room in the TX buffer
+bool MbedLogger::sendDueParityPacket() {
+    if (!_parity_due)
+        return true;
     
-    int crc = 0;
-    for (_it=_data_packet.begin(); _it < _data_packet.end(); _it++)
-        crc = (crc_table[(*_it ^ crc) & 0xff] ^ (crc >> 8)) & 0xFFFF;
+    if (!hasTransmitRoom(7 + _parity_length + 2))
+        return false;
     
-    //serialPrint("DEBUG: calcCrcTwo string length: %d crc: %d\n\r", input_array.length(), crc % 256);
+    transmitParityPacket();
+    _parity_count = 0;
+    _parity_due = false;
+    
+    return true;
+}
 
-    return crc % 256; //last byte
+// write only waits for the radio if the packet doesn't fit (a TX buffer that couldn't be made bigger)
+bool MbedLogger::hasTransmitRoom(int bytes) {
+    return xbee().txBufferEmpty() or xbee().txBufferGetSize(0) - xbee().txBufferGetCount() >= bytes;
 }
 
-//new 6/27/2018, create data packet
-void MbedLogger::createDataPacket(char line_buffer_sent[], int line_length_sent) {     
-    // packet is 7565 0001 FFFF EEEE CC DATA DATA DATA ... CRC1 CRC2
+// add_to_parity for new packets, packets sent again aren't in a parity group
+void MbedLogger::transmitWindowPacket(int packet_number, bool add_to_parity) {
+    if (_window_compressed) {
+        transmitCompressedBlock(packet_number, add_to_parity);
+        return;
+    }
     
-    //CLEAR: Removes all elements from the vector (which are destroyed), leaving the container with a size of 0.
-    _data_packet.clear();
+    transmitPacketNumber(packet_number);
     
-    //DATA PACKET HEADER
-    _data_packet.push_back(117);                             //0x75
-    _data_packet.push_back(101);                             //0x65    
+    if (add_to_parity and _parity_group > 1) {
+        //line bytes of the packet in _data_packet (7 byte header), the compression buffers aren't used for lines
+        for (int i = 0; i < LOG_CSV_LINE_LENGTH; i++)
+            _transfer.download.compress_output[i] = _data_packet[7 + i];
+        
+        addToParity(packet_number, NULL, 0, _transfer.download.compress_output, LOG_CSV_LINE_LENGTH);
+    }
+}
+
+// XOR the packet into the parity group, a group is consecutive packets (a skipped packet starts a new one)
+void MbedLogger::addToParity(int packet_number, const uint8_t * header, int header_length, const uint8_t * data, int data_length) {
+    if (_parity_group < 2)
+        return;
+    
+    if (_parity_count == 0 or packet_number != _parity_first + _parity_count) {
+        _parity_first = packet_number;
+        _parity_count = 0;
+        _parity_length = 0;
+        memset(_transfer.download.parity, 0, sizeof(_transfer.download.parity));
+    }
     
-    _data_packet.push_back(_packet_number/256);                //current packet number in 0x#### form
-    _data_packet.push_back(_packet_number%256);                //current packet number in 0x#### form
+    for (int i = 0; i < header_length; i++)
+        _transfer.download.parity[i] ^= header[i];
+    for (int i = 0; i < data_length; i++)
+        _transfer.download.parity[header_length + i] ^= data[i];
     
-    _data_packet.push_back(_total_number_of_packets/256);                //total number of packets, 0x#### form
-    _data_packet.push_back(_total_number_of_packets%256);                //total number of packets, 0x#### form
+    if (header_length + data_length > _parity_length)
+        _parity_length = header_length + data_length;
     
-    _data_packet.push_back(line_length_sent);
+    _parity_count++;
+    
+    //sendWindowPackets sends it once the TX buffer has room for it
+    if (_parity_count == _parity_group or packet_number == _window_total - 1)
+        _parity_due = true;
+}
 
-    //serialPrint("DEBUG: Current line buffer: %s\n\r", _line_buffer);        //debug
+// 0x75 0x70, first packet (2 bytes), packets (1), length (2), XOR of the packets (shorter ones padded with zeros), CRC (2)
+// the packets are the line bytes, or lines, method, length (2) and data of a compressed block
+// the PC can rebuild any one packet of the group that didn't get through without asking for it again
+void MbedLogger::transmitParityPacket() {
+    uint8_t header[7];
+    header[0] = 0x75;
+    header[1] = 0x70;
+    header[2] = _parity_first / 256;
+    header[3] = _parity_first % 256;
+    header[4] = _parity_count;
+    header[5] = _parity_length / 256;
+    header[6] = _parity_length % 256;
+    
+    int crc = calcCrc16(header, sizeof(header));
+    crc = calcCrc16(_transfer.download.parity, _parity_length, crc);
+    
+    uint8_t crc_bytes[2] = { (uint8_t)(crc / 256), (uint8_t)(crc % 256) };
+    
+    xbee().write(header, sizeof(header));
+    xbee().write(_transfer.download.parity, _parity_length);
+    xbee().write(crc_bytes, sizeof(crc_bytes));
+    
+    //a packet of the group is only lost if the PC has something sent after the parity
+    _window_send_count++;
+    for (int packet = _parity_first; packet < _parity_first + _parity_count; packet++)
+        _window_sent_at[packet % (LOG_WINDOW_MAX_PACKETS + 1)] = _window_send_count;
+}
 
-    //DATA FROM LINE READ (read string character by chracter)
-    for (int i = 0; i < line_length_sent; i++) {
-        _data_packet.push_back(line_buffer_sent[i]);
+// 0x75 0x7A, block (2 bytes), total blocks (2), lines (1), method (1), length (2), data, CRC (2)
+// block n is lines n * LOG_COMPRESS_BLOCK_LINES on (the heading is line 0), LZSS primed with the line before the block
+// (method 1, see LogCompressor), or the lines as they are if they don't get smaller (method 0)
+void MbedLogger::transmitCompressedBlock(int block_number, bool add_to_parity) {
+    const int line_size = LOG_CSV_LINE_LENGTH + 1;
+    
+    int first_line = block_number * LOG_COMPRESS_BLOCK_LINES;
+    int lines = _total_number_of_packets - first_line;
+    if (lines > LOG_COMPRESS_BLOCK_LINES)
+        lines = LOG_COMPRESS_BLOCK_LINES;
+    if (lines <= 0)
+        return;
+    
+    int primer_length = (first_line > 0) ? line_size : 0;
+    
+    fseek(_transmit_fp, first_line * line_size - primer_length, SEEK_SET);
+    int length = fread(_transfer.download.compress_input, 1, primer_length + lines * line_size, _transmit_fp);
+    
+    const uint8_t * data = _transfer.download.compress_output;
+    int method = 1;
+    int data_length = _compressor.compress(_transfer.download.compress_input, primer_length, length, line_size, _transfer.download.compress_output, lines * line_size - 1);
+    
+    if (data_length < 0) {
+        data = _transfer.download.compress_input + primer_length;
+        method = 0;
+        data_length = length - primer_length;
     }
     
-    //CRC CALCULATIONS BELOW
-    //character version of calculation messes up on null character 0x00, scrapped and using vector of integers
+    uint8_t header[10];
+    header[0] = 0x75;
+    header[1] = 0x7A;
+    header[2] = block_number / 256;
+    header[3] = block_number % 256;
+    header[4] = _window_total / 256;
+    header[5] = _window_total % 256;
+    header[6] = lines;
+    header[7] = method;
+    header[8] = data_length / 256;
+    header[9] = data_length % 256;
+    
+    int crc = calcCrc16(header, sizeof(header));
+    crc = calcCrc16(data, data_length, crc);
+    
+    uint8_t crc_bytes[2] = { (uint8_t)(crc / 256), (uint8_t)(crc % 256) };
+    
+    xbee().write(header, sizeof(header));
+    xbee().write(data, data_length);
+    xbee().write(crc_bytes, sizeof(crc_bytes));
+    
+    if (add_to_parity)
+        addToParity(block_number, header + 6, 4, data, data_length);
+}
 
-    int crc_one = calcCrcOne();
-    int crc_two = calcCrcTwo();
+// 0x75 0x69, segment (2 bytes, 0xFFFF for the transmit segment), CRC (2)
+// reply 0x75 0x69, segment (2), current segment (2), packets (2), fingerprint (4), CRC (2)
+// the PC keeps the fingerprint with the packets it has, if it is the same next time it only asks for the rest
+bool MbedLogger::receiveIdentityRequest(const uint8_t * packet) {
+    int crc = calcCrc16(packet, LOG_IDENTITY_PACKET_SIZE - 2);
     
-    //place the crc bytes into the data packet that is transmitted
-    _data_packet.push_back(crc_one);
-    _data_packet.push_back(crc_two);
+    if (packet[4] != crc / 256 or packet[5] != crc % 256)
+        return false;
     
-    //serialPrint("debug createDataPacket(char line_buffer_sent[], int line_length_sent)\n\r");
+    int segment = (packet[2] << 8) | packet[3];
+    
+    if (_transmit_fp) {
+        fclose(_transmit_fp);
+        _transmit_fp = NULL;
+    }
+    
+    if (segment != 0xFFFF)
+        setTransmitSegment(segment);
+    
+    _query_active = false;
+    _window_active = false;     //the next acknowledgement starts a new transfer
+    
+    if (_transmit_segment <= _current_segment)
+        getNumberOfPacketsInCurrentLog();
+    else
+        _total_number_of_packets = 0;
+    
+    //a binary segment goes back as 0 packets (getNumberOfPacketsInCurrentLog said why on the USB)
+    if (_transmit_format != LOG_FORMAT_BINARY)
+        _transmit_fp = fopen(getTransmitFileName().c_str(), "r");
+    
+    unsigned int fingerprint = getTransmitFingerprint();
+    
+    uint8_t reply[LOG_IDENTITY_REPLY_SIZE];
+    reply[0] = 0x75;
+    reply[1] = 0x69;
+    reply[2] = _transmit_segment / 256;
+    reply[3] = _transmit_segment % 256;
+    reply[4] = _current_segment / 256;
+    reply[5] = _current_segment % 256;
+    reply[6] = _total_number_of_packets / 256;
+    reply[7] = _total_number_of_packets % 256;
+    reply[8] = fingerprint >> 24;
+    reply[9] = fingerprint >> 16;
+    reply[10] = fingerprint >> 8;
+    reply[11] = fingerprint;
+    
+    crc = calcCrc16(reply, LOG_IDENTITY_REPLY_SIZE - 2);
+    reply[12] = crc / 256;
+    reply[13] = crc % 256;
+    
+    xbee().write(reply, LOG_IDENTITY_REPLY_SIZE);
+    
+    return true;
 }
 
-void MbedLogger::transmitMultiplePackets() {
-    serialPrint("transmitMultiplePackets\n");
+// FNV-1a of the first lines of the transmit segment, 0 if there is no segment
+unsigned int MbedLogger::getTransmitFingerprint() {
+    if (!_transmit_fp)
+        return 0;
     
-    static int input_packet;                 //changed from char in previous iteration 03/28/2018
-    static int transmit_crc_one = 0;            //hold crc values until they're reset with calculations
-    static int transmit_crc_two = 0;
-        
-    int current_byte = -1;
+    int lines = _total_number_of_packets;
+    if (lines > LOG_FINGERPRINT_LINES)
+        lines = LOG_FINGERPRINT_LINES;
     
-    static int bytes_received = 0;
+    char line_buffer[LOG_CSV_LINE_LENGTH + 1];
+    unsigned int hash = 2166136261u;
     
-    int req_packet_number = -1;
-     
-//GET TOTAL NUMBER OF PACKETS!
-    getNumberOfPacketsInCurrentLog();
-//GET TOTAL NUMBER OF PACKETS!
+    fseek(_transmit_fp, 0, SEEK_SET);
+    
+    for (int line = 0; line < lines; line++) {
+        int length = fread(line_buffer, 1, LOG_CSV_LINE_LENGTH + 1, _transmit_fp);
         
-    //open the file
-    string file_name_string = _file_system_string + "LOG000.csv";
-    _fp = fopen(file_name_string.c_str(), "r");
+        for (int i = 0; i < length; i++) {
+            hash ^= (uint8_t)line_buffer[i];
+            hash *= 16777619u;
+        }
+    }
     
-    //DEFAULT STATE
-    static int current_state = HEADER_117;
+    return hash;
+}
+
+// 0x75 0x71, start time (4 bytes), end time (4), state mask (2), decimation (1), CRC (2), high byte first like the packet numbers
+// no reply to a bad query, the PC sends it again when it doesn't get the heading back
+bool MbedLogger::receiveLogQuery(const uint8_t * packet) {
+    int crc = calcCrc16(packet, LOG_QUERY_PACKET_SIZE - 2);
+    
+    if (packet[13] != crc / 256 or packet[14] != crc % 256)
+        return false;
+    
+    LogQuery query;
+    query.start_time = ((unsigned int)packet[2] << 24) | (packet[3] << 16) | (packet[4] << 8) | packet[5];
+    query.end_time = ((unsigned int)packet[6] << 24) | (packet[7] << 16) | (packet[8] << 8) | packet[9];
+    query.state_mask = (packet[10] << 8) | packet[11];
+    query.decimation = packet[12];
+    
+    startLogQuery(query);
+    return true;
+}
+
+// start serving query packets, replies with the CSV heading as packet 0
+void MbedLogger::startLogQuery(const LogQuery & query) {
+    _query = query;
+    if (_query.decimation < 1)
+        _query.decimation = 1;
     
-    bool active_loop = true;
+    _query_active = true;
+    restartLogQuery();
     
-    while (active_loop) {
-        //INCOMING BYTE
-        current_byte = xbee().getc();
+    //skip the segments the index rules out (the last line for a segment wins, the open segment has no line yet)
+    memset(_query_skip_segment, 0, sizeof(_query_skip_segment));
+    
+    FILE *index_fp = fopen(_index_file_path_string.c_str(), "r");
+    
+    if (index_fp) {
+        char line_buffer[100];
+        char file_name[16];
+        LogSegmentInfo info;
         
-        //provide the next byte / state
+        while (fgets(line_buffer, sizeof(line_buffer), index_fp) != NULL) {
+            if (sscanf(line_buffer, "%15[^,],%u,%u,%d,%d,%x,%u,%u", file_name, &info.start_time, &info.end_time,
+                       &info.first_state, &info.last_state, &info.state_mask, &info.record_count, &info.byte_count) != 8)
+                continue;
+            
+            int segment = getLogSegmentNumber(file_name);
+            if (segment < 0 or segment > LOG_MAX_SEGMENT)
+                continue;
+            
+            bool in_window = (_query.end_time == 0 or info.start_time <= _query.end_time)
+                         and (_query.start_time == 0 or info.end_time >= _query.start_time);
+            bool has_state = (_query.state_mask == 0 or (info.state_mask & _query.state_mask));
+            
+            if (in_window and has_state)
+                _query_skip_segment[segment / 8] &= ~(1 << (segment % 8));
+            else
+                _query_skip_segment[segment / 8] |= (1 << (segment % 8));
+        }
         
-        switch (current_state) {
-            case HEADER_117:
-                //serialPrint("HEADING 117\n\r");
-                if (current_byte == 0x75) { 
-                    current_state = HEADER_101;
-                }
-                
-                                
-                else if (current_byte == 0x10) {
-                    current_state = END_TX_1;
-                }
-                break;
-            case HEADER_101:
-                //serialPrint("HEADING 101\n\r");
-                if (current_byte == 0x65) { 
-                    current_state = PACKET_NO_1;
-                }
-                break;
-            case PACKET_NO_1:
-                //serialPrint("PACKET_NO_1\n\r");
-                input_packet = current_byte * 256;
-                
-                current_state = PACKET_NO_2;
-                //serialPrint("PACKET # 1 current byte %d\n\r", current_byte);
-                break;
+        fclose(index_fp);
+    }
+    
+    char line_buffer[LOG_CSV_MAX_LINE];
+    strncpy(line_buffer, _heading_string.c_str(), LOG_CSV_LINE_LENGTH);
+    
+    _query_packet = 0;
+    _packet_number = 0;
+    _total_number_of_packets = 0;       //not known until the last line is read
+    createDataPacket(line_buffer, LOG_CSV_LINE_LENGTH);
+    transmitDataPacket();
+}
+
+// read the query from the first segment again
+void MbedLogger::restartLogQuery() {
+    if (_transmit_fp) {
+        fclose(_transmit_fp);
+        _transmit_fp = NULL;
+    }
+    
+    _query_segment = -1;
+    _query_line = 0;
+    _query_lines = 0;
+    _query_matches = 0;
+    _query_done = false;
+}
+
+// next CSV line that matches the query (heading and partial lines skipped), false after the last one
+// line_buffer needs LOG_CSV_MAX_LINE bytes
+bool MbedLogger::readNextQueryLine(char * line_buffer) {
+    while (!_query_done) {
+        if (!_transmit_fp) {
+            _query_segment++;
             
-            case PACKET_NO_2:
-                //serialPrint("PACKET_NO_2\n\r");
-                input_packet = input_packet + current_byte;
-                
-                current_state = PACKET_CRC_ONE;
-                //serialPrint("PACKET # 2 current byte %d (req packet num: %d)\n\r", current_byte, input_packet);
-                break;
-                
-            case PACKET_CRC_ONE:
-                //serialPrint("PACKET_CRC_ONE\n\r");
-                current_state = PACKET_CRC_TWO;
+            if (_query_segment > _current_segment) {
+                _query_done = true;
                 break;
+            }
             
-            case PACKET_CRC_TWO:
-                //serialPrint("PACKET_CRC_TWO\n\r");
-                current_state = HEADER_117;
-                transmitPacketNumber(input_packet);
-                break;
-                
-            case END_TX_1:
-                //serialPrint("END_TX_1\n\r");                
-                current_state = END_TX_2;
-                break;
-            case END_TX_2:
-                //serialPrint("END_TX_2\n\r");                
-                current_state = HEADER_117;
-                active_loop = false;
-                break;
+            if (_query_skip_segment[_query_segment / 8] & (1 << (_query_segment % 8)))
+                continue;
             
-            default:
-                //reset state
-                //serialPrint("DEFAULT. HEADER_117\n\r");
-                current_state = HEADER_117; //reset here
-                break;
+            _transmit_fp = fopen(getSegmentFileName(_query_segment, LOG_FORMAT_CSV).c_str(), "r");   //binary segments aren't found
+            _query_line = 0;
+            continue;
+        }
+        
+        //a line at a time, so a cut off or garbled line only loses itself (the next read starts after its newline)
+        if (fgets(line_buffer, LOG_CSV_MAX_LINE, _transmit_fp) == NULL) {
+            fclose(_transmit_fp);
+            _transmit_fp = NULL;
+            continue;
         }
+        
+        if (_query_line++ == 0)
+            continue;       //heading
+        
+        if (strlen(line_buffer) != LOG_CSV_LINE_LENGTH + 1 or line_buffer[LOG_CSV_LINE_LENGTH] != '\n')
+            continue;
+        
+        int state;
+        unsigned int time_sec;
+        
+        if (!parseCSVLine(line_buffer, &state, &time_sec))
+            continue;
+        
+        if (_query.start_time != 0 and time_sec < _query.start_time)
+            continue;
+        if (_query.end_time != 0 and time_sec > _query.end_time)
+            continue;
+        if (_query.state_mask != 0 and !(_query.state_mask & (1 << (state & 0x1F))))
+            continue;
+        
+        if (_query_matches++ % _query.decimation != 0)
+            continue;
+        
+        return true;
     }
     
-    //CLOSE THE FILE
-    closeLogFile(); 
-    serialPrint("08/05/2018 CLOSE THE LOG FILE\n\r");
+    return false;
+}
+
+// packet n is the n-th matching line, past the last one the reply has no data and the total is the number of lines
+void MbedLogger::transmitQueryPacket(int packet_number) {
+    //the reply was lost, send the same packet again
+    if (packet_number == _query_packet) {
+        transmitDataPacket();
+        return;
+    }
+    
+    if (packet_number < 1)
+        return;
+    
+    //the line was already read past, read the segments again (slow, the PC normally asks in order)
+    if (packet_number <= _query_lines)
+        restartLogQuery();
+    
+    char line_buffer[LOG_CSV_MAX_LINE];
+    
+    while (_query_lines < packet_number and readNextQueryLine(line_buffer))
+        _query_lines++;
+    
+    _query_packet = packet_number;
+    _packet_number = packet_number;
     
-    //RESET THE STATE
-    //current_state = HEADER_117;
+    if (_query_lines == packet_number) {
+        createDataPacket(line_buffer, LOG_CSV_LINE_LENGTH);
+    }
+    else {
+        _total_number_of_packets = _query_lines;
+        createDataPacket(line_buffer, 0);
+    }
+    
+    transmitDataPacket();
 }
 
 //only do this for the MBED because of the limited file size
-//write one line to the file (open to write, this will erase all other data) and close it.
+//erase every log segment and the segment index, the next recording starts again at LOG000
 void MbedLogger::eraseFile() {    
-    _fp = fopen(_full_file_path_string.c_str(), "w"); // LOG000.csv
+    //anything still waiting in the buffer goes with the erased files
+    _log_buffer.clear();
+    _close_requested = false;
+    _new_segment_requested = false;
     
-    fprintf(_fp,_heading_string.c_str());
-
-    closeLogFile();
+    if (_fp)
+        closeLogFile();
+    
+    //collect the names first, don't remove files while reading the directory
+    vector <string> file_names;
+    DIR *dir = opendir(_file_system_string.c_str());
+    struct dirent *dp;
+    
+    if (dir) {
+        while ( NULL != (dp = readdir( dir )) ) {
+            if (getLogSegmentNumber(dp->d_name) >= 0)
+                file_names.push_back(_file_system_string + dp->d_name);
+        }
+        closedir(dir);
+    }
+    
+    for (unsigned int i = 0; i < file_names.size(); i++) {
+        serialPrint("MbedLogger: erasing %s\n\r", file_names[i].c_str());
+        remove(file_names[i].c_str());
+    }
+    
+    remove(_index_file_path_string.c_str());
+    
+    _current_segment = 0;
+    _transmit_segment = 0;
+    _transmit_format = _log_format;
+    _binary_record_sequence = 0;
+    resetSegmentInfo();
 }
 
 
@@ -514,83 +2383,150 @@ void MbedLogger::setTransmitPacketNumber(int packet_number) {
     _end_transmit_packet = false;
 }
 
-void MbedLogger::receiveSequenceFile() {
+// the upload runs from the main loop (serviceSequenceReceive) so the state machine, GUI commands and logging keep going
+bool MbedLogger::startSequenceReceive() {
+    if (isTransferRunning()) {
+        serialPrint("MbedLogger: a log download or sequence upload is running already\n\r");
+        return false;
+    }
+    
     //restart each time
     _end_sequence_transmission = false;
     
     serialPrint("Opening Mission file (sequence.txt) for reception.\n\r");
     string filename_string = _file_system_string + "sequence.txt";
     
-    //serialPrint("DEBUG: openNewMissionFile: %s\n\r", filename_string.c_str());
-
-    _fp = fopen(filename_string.c_str(), "w");
-
-    //zero will be reserved for the file name, future 
-    _confirmed_packet_number = 1;           //in sendReply() function that transmits a reply for incoming data
+    //binary, the payload can have any bytes in it
+    _upload_fp = fopen(filename_string.c_str(), "wb");
     
-//    int current_packet_number = 1;
-//    int last_packet_number = -1;
-//    int break_transmission = 0;
+    if (!_upload_fp) {
+        serialPrint("MbedLogger: could not open %s\n\r", filename_string.c_str());
+        return false;
+    }
     
-    int counter = 0;
+    //a window of packets waits in the RX buffer while the file is written (the LocalFileSystem is slow)
+    _upload_window = LOG_UPLOAD_WINDOW;
+    if (xbee().rxBufferSetSize(LOG_UPLOAD_RX_BUFFER, false) != MODSERIAL::Ok)
+        _upload_window = 1;
     
-    while(1) {
-        wait(0.25);  //runs at 4 Hz
-        
-        checkForIncomingData();
-                
-        //serialPrint("\n\rDEBUG: _confirmed_packet_number%d\n\r", _confirmed_packet_number);    
-        
-        counter++;
-        
-        sendReply();    //bad name, should call it send request or something
-        
-        if (_end_sequence_transmission)
-            break;
-    }
+    resetUpload();
+    sendUploadAck();    //the PC starts sending when it gets this
     
-    closeLogFile();
+    _upload_last_byte_us = systemClock().read_us();
+    _upload_last_ack_us = _upload_last_byte_us;
+    _upload_running = true;
+    
+    return true;
 }
 
-int MbedLogger::sendReply() {
-    //change this method to be more explicit later
+// one step of the upload, the RX buffer holds a window of packets between calls
+void MbedLogger::serviceSequenceReceive() {
+    if (!_upload_running)
+        return;
     
-    //integer vector _data_packet is used here, cleared fist just in case
+    uint64_t now_us = systemClock().read_us();
     
-    _data_packet.clear();   //same data packet for transmission
-    _data_packet.push_back(117);
-    _data_packet.push_back(101);
-    
-    //_confirmed_packet_number comes from the packet number that is sent from the Python program
-    _data_packet.push_back(_confirmed_packet_number / 256);    //packet number only changed when confirmed
-    _data_packet.push_back(_confirmed_packet_number % 256);     //split into first and second byte
+    if (xbee().readable()) {
+        _upload_last_byte_us = now_us;
+        checkForIncomingData();
+    }
     
-    //compute checksums
+    writeNextUploadPacket();
     
-    int receiver_crc_one = calcCrcOne();
-    int receiver_crc_two = calcCrcTwo();
+    //the PC sends more when it gets an acknowledgement, send it again if everything stopped
+    //(not while the first missing packet is here and waiting to be written, the PC would send it again)
+    bool write_pending = _upload_slot_length[_confirmed_packet_number % LOG_UPLOAD_WINDOW] >= 0;
     
-    _data_packet.push_back(receiver_crc_one);
-    _data_packet.push_back(receiver_crc_two);
+    if (!write_pending and (_upload_ack_due or _upload_packets_since_ack >= (_upload_window + 1) / 2
+        or (now_us - _upload_last_byte_us > LOG_UPLOAD_ACK_MS * 1000 and now_us - _upload_last_ack_us > LOG_UPLOAD_ACK_MS * 1000))) {
+        sendUploadAck();
+        _upload_last_ack_us = now_us;
+    }
     
-    //transmit this packet
-    for (_it=_data_packet.begin(); _it < _data_packet.end(); _it++) {
-        xbee().putc(*_it); //send integers over serial port one byte at a time
+    if (_end_sequence_transmission) {
+        finishSequenceReceive();
     }
+    else if (now_us - _upload_last_byte_us > (uint64_t)LOG_UPLOAD_TIMEOUT_MS * 1000) {
+        serialPrint("MbedLogger: upload stopped, nothing from the PC for %d seconds\n\r", LOG_UPLOAD_TIMEOUT_MS / 1000);
+        finishSequenceReceive();
+    }
+}
+
+bool MbedLogger::isReceivingSequence() {
+    return _upload_running;
+}
+
+void MbedLogger::finishSequenceReceive() {
+    fclose(_upload_fp);
+    _upload_fp = NULL;
+    _upload_running = false;
+    
+    xbee().rxBufferSetSize(MODSERIAL_DEFAULT_RX_BUFFER_SIZE, false);
     
-    //change process methodology later...
+    serialPrint("sequence.txt: %d of %d packets, %u bytes written (%u write errors)\n\r", _confirmed_packet_number, _upload_total, _upload_bytes_written, _upload_write_errors);
+}
+
+void MbedLogger::resetUpload() {
+    _upload_state = HEADER_117;
+    _upload_bytes = 0;
+    _upload_total = 0;
+    _upload_packets_since_ack = 0;
+    _upload_ack_due = false;
+    _upload_bytes_written = 0;
+    _upload_write_errors = 0;
+    _confirmed_packet_number = 0;
+    
+    for (int slot = 0; slot < LOG_UPLOAD_WINDOW; slot++)
+        _upload_slot_length[slot] = -1;
+}
+
+// 0x75 0x61, window (1 byte), first missing packet (2), bitmap of the packets after it that are here (4, bit n is
+// first missing + 1 + n), flags (1, bit 0: every packet is in the file), CRC (2)
+// the same packet as the window acknowledgement the PC sends for the log download
+void MbedLogger::sendUploadAck() {
+    uint32_t received_mask = 0;
+    for (int bit = 0; bit < _upload_window - 1; bit++) {
+        if (_upload_slot_length[(_confirmed_packet_number + 1 + bit) % LOG_UPLOAD_WINDOW] >= 0)
+            received_mask |= ((uint32_t)1 << bit);
+    }
     
-    return _confirmed_packet_number;
+    uint8_t packet[LOG_ACK_PACKET_SIZE];
+    packet[0] = 0x75;
+    packet[1] = 0x61;
+    packet[2] = _upload_window;
+    packet[3] = _confirmed_packet_number / 256;
+    packet[4] = _confirmed_packet_number % 256;
+    packet[5] = received_mask >> 24;
+    packet[6] = received_mask >> 16;
+    packet[7] = received_mask >> 8;
+    packet[8] = received_mask;
+    packet[9] = (_upload_total > 0 and _confirmed_packet_number >= _upload_total) ? 0x01 : 0x00;
+    
+    int crc = calcCrc16(packet, LOG_ACK_PACKET_SIZE - 2);
+    packet[10] = crc / 256;
+    packet[11] = crc % 256;
+    
+    xbee().write(packet, LOG_ACK_PACKET_SIZE);
+    
+    _upload_ack_due = false;
+    _upload_packets_since_ack = 0;
 }
 
 int MbedLogger::getFileSize(string filename) {    
     // fixed the const char * errror:
     // https://stackoverflow.com/questions/347949/how-to-convert-a-stdstring-to-const-char-or-char
+    flushLogBuffer();   //the log file size includes everything recorded so far
+    
     const char * char_filename = filename.c_str();  // Returns a pointer to an array that contains a null-terminated sequence of characters (i.e., a C-string) representing the current value of the string object.
     //http://www.cplusplus.com/reference/string/string/c_str/
     
     _fp = fopen(filename.c_str(), "rb");     //open the file for reading as a binary file
     
+    if (!_fp) {
+        serialPrint("%s not found.\n\r", filename.c_str());
+        return 0;
+    }
+    
     fseek(_fp, 0, SEEK_END);                     //SEEK_END is a constant in cstdio (end of the file)    
     unsigned int file_size = ftell(_fp);        //For binary streams, this is the number of bytes from the beginning of the file.
     fseek(_fp, 0, SEEK_SET);                    //SEEK_SET is hte beginning of the file, not sure this is necessary
@@ -602,195 +2538,134 @@ int MbedLogger::getFileSize(string filename) {
     return file_size;
 }
 
-// rewrite this when time permits!
-
 // function checks for incoming data (receiver function) from a Python program that transmits a file
-// current limit is a file that has 255 lines of data
-bool MbedLogger::checkForIncomingData() {        
-    int receive_packet_number;
-    int receive_total_number_packets;
-    int receive_packet_size;
-    
-    bool data_transmission_complete = false;
-    
-    int incoming_byte;
-    
-    char char_buffer[256] = {};    //create empty buffer
-   
-    //starting state
-    int process_state = HEADER_117;
-    
-    //variables for processing data below
-    int checksum_one = -1;
-    int checksum_two = -1;
-    
-    int i = 5;
-    int serial_timeout = 0;
-    
-    while (xbee().readable() && !data_transmission_complete) {                
-        incoming_byte = xbee().getc();    //getc returns an unsigned char cast to an int
-        //serialPrint("DEBUG: State 0\n\r");
+// 0x75 0x64, packet (2 bytes), total packets (2), payload length (2), payload, CRC (2), 0x10 0x10 0x10 0x10 ends it
+// packets up to _upload_window past the first missing one are kept until it comes, the file is written in order
+// returns after each packet (the caller acknowledges), false when the PC ended the upload
+bool MbedLogger::checkForIncomingData() {
+    bool packet_received = false;
+    
+    while (xbee().readable() and !_end_sequence_transmission and !packet_received) {
+        int incoming_byte = xbee().getc();    //getc returns an unsigned char cast to an int
         
-        switch(process_state) {
+        switch (_upload_state) {
             case HEADER_117:
-                //continue processing
-                if (incoming_byte == 117){
-                    process_state = HEADER_101;
-                    //serialPrint("DEBUG: Case 117\n\r");
+                if (incoming_byte == 0x75) {
+                    _transfer.upload.packet[0] = incoming_byte;
+                    _upload_state = HEADER_101;
                 }
                 //end transmission
-                else if (incoming_byte == 16) {
-                    process_state = END_TRANSMISSION;
-                    //serialPrint("DEBUG: State 16 (END_TRANSMISSION)\n\r");
-                }
-                else {
-                    process_state = HEADER_117; // ???
-                    //serialPrint("DEBUG: State Header 117\n\r");
+                else if (incoming_byte == 0x10) {
+                    _upload_bytes = 1;
+                    _upload_state = END_TRANSMISSION;
                 }
                 break;
             
             case HEADER_101:
-                if(incoming_byte == 101) {
-                    process_state = PACKET_NUM;
-                    //serialPrint("DEBUG: Case 101\n\r");
+                if (incoming_byte == 0x64) {
+                    _transfer.upload.packet[1] = incoming_byte;
+                    _upload_bytes = 2;
+                    _upload_state = UPLOAD_PACKET;
+                }
+                else if (incoming_byte != 0x75) {
+                    _upload_state = HEADER_117;
                 }
-                break;
-                
-            case PACKET_NUM:
-                receive_packet_number = incoming_byte;
-                process_state = TOTAL_NUM_PACKETS;
-                //serialPrint("DEBUG: Case PACKET_NUM\n\r");
                 break;
             
-            case TOTAL_NUM_PACKETS:
-                receive_total_number_packets = incoming_byte;
-                process_state = PACKET_SIZE;
-                //serialPrint("DEBUG: Case TOTAL_NUM_PACKETS\n\r");
-                break;
-                
-            case PACKET_SIZE:      
-                receive_packet_size = incoming_byte;
-                //serialPrint("DEBUG: Case PACKET_SIZE\n\r");
+            case UPLOAD_PACKET: {
+                _transfer.upload.packet[_upload_bytes++] = incoming_byte;
                 
-                //write the header stuff to it
-                char_buffer[0] = 117;
-                char_buffer[1] = 101;
-                char_buffer[2] = receive_packet_number;
-                char_buffer[3] = receive_total_number_packets;
-                char_buffer[4] = receive_packet_size;    
+                if (_upload_bytes < LOG_UPLOAD_HEADER_SIZE)
+                    break;
                 
-                // tests confirmed that packet number is zero, number of packets is 12, packet size is 12
-                //serialPrint("char_buffer 2/3/4: %d %d %d\n\r", receive_packet_number,receive_total_number_packets,receive_packet_size);
-                       
-                //process packet data, future version will append for larger data sizes, 0xFFFF
+                int length = (_transfer.upload.packet[6] << 8) | _transfer.upload.packet[7];
                 
-                // IF YOU GET AN INTERRUPTED DATA STREAM YOU NEED TO BREAK OUT OF THE LOOP
-                i = 5;
-                serial_timeout = 0;
-                
-                while (true) {
-                    if (xbee().readable()) {
-                        char_buffer[i] = xbee().getc();   //read all of the data packets
-                        i++;
-                        
-                        serial_timeout = 0; //reset the timeout
-                    }
-                    else {
-                        serial_timeout++;        
-                    }
-                    
-                    // When full data packet is received...
-                    if (i >= receive_packet_size+5) {     //cannot do this properly with a for loop                        
-                        //get checksum bytes
-                        checksum_one = xbee().getc();
-                        checksum_two = xbee().getc();
-                        
-                        //calculate the CRC from the header and data bytes using _data_packet (vector)
-                        //found out calculating crc with string was dropping empty or null spaces
-                        _data_packet.clear();   //clear it just in case
-                        
-                        for (int a = 0; a < receive_packet_size+5; a++) {
-                            _data_packet.push_back(char_buffer[a]);  //push the character array into the buffer
-                        }
-                        
-                        //calculate the CRC using the vector (strings will cut off null characters)
-                        int calc_crc_one = calcCrcOne();
-                        int calc_crc_two = calcCrcTwo();
-
-                        //serialPrint("DEBUG: calc crc 1: %d, crc 2: %d\n\r", calc_crc_one, calc_crc_two);
-                        
-                        // first confirm that the checksum is correct
-                        if ((calc_crc_one == checksum_one) and (calc_crc_two == checksum_two)) {    
-                        
-                            //serialPrint("DEBUG: checksums are good!\n\r");
-                            
-                            //serialPrint("receive_packet_number %d and _confirmed_packet_number %d\n\r", receive_packet_number, _confirmed_packet_number); //debug
-                                                                            
-                            // check if the packet that you're receiving (receive_packet_number) has been received already...
-        
-                            //CHECKSUM CORRECT & packet numbers that are 1 through N packets
-                            if (receive_packet_number == _confirmed_packet_number){
-                                //save the data (char buffer) to the file if both checksums work...                 
-                                
-                                // when a packet is received (successfully) send a reply
-                                //sendReply();
-                                
-                                // write correct data to file
-                                fprintf(_fp, "%s", char_buffer+5);
-                                
-                                // even if correct CRC, counter prevents the program from writing the same packet twice
-                                _confirmed_packet_number++;
-                            }
-                            
-                            //clear the variables
-                            checksum_one = -1;
-                            checksum_two = -1;
-                        }
-                        
-                        process_state = HEADER_117;
-                        
-                        break;
-                    }
-                    
-//                    //counter breaks out of the loop if no data received
-//                    if (serial_timeout >= 10000) {
-//                        //serialPrint("break serial_timeout %d\n\r", serial_timeout);
-//                        break;      
-//                    }
+                if (length > LOG_UPLOAD_MAX_PAYLOAD) {
+                    _upload_state = HEADER_117;     //not a packet
                 }
-                break;   
-                
+                else if (_upload_bytes == LOG_UPLOAD_HEADER_SIZE + length + 2) {
+                    receiveUploadPacket();
+                    _upload_state = HEADER_117;
+                    packet_received = true;
+                }
+                break;
+            }
+            
+            //four in a row once every packet is in (or before the first), the payload of a packet with a
+            //damaged header is read here and can have them
             case END_TRANSMISSION:
-                if (xbee().getc() == 16) {
-                    //serialPrint("DEBUG: END_TRANSMISSION REACHED: 1. \n\r");
-                    
-                    if (xbee().getc() == 16) {
-                        //serialPrint("DEBUG: END_TRANSMISSION REACHED: 2. \n\r");
-                        
+                if (incoming_byte == 0x10) {
+                    _upload_bytes++;
+                    if (_upload_bytes == 4 and _confirmed_packet_number >= _upload_total)
                         _end_sequence_transmission = true;
-                        //endReceiveData();
-                    }
                 }
-                
-                //serialPrint("DEBUG: END_TRANSMISSION REACHED: 5. \n\r");
-                
-                //process_state = HEADER_117; //don't do this unless the check is wrong
-                //serialPrint("END_TRANSMISSION process_state is %d\n\r", process_state);        //should be 5 (debug) 02/06/2018
-                data_transmission_complete = true;
-                break;            
-        }//END OF SWITCH
-        
-        if (data_transmission_complete) {
-            //serialPrint("DEBUG: checkForIncomingData data_transmission_complete \n\r");
-            break;  //out of while loop
-        }   
-    } // while loop
+                else if (incoming_byte == 0x75) {
+                    _transfer.upload.packet[0] = incoming_byte;
+                    _upload_state = HEADER_101;
+                }
+                else {
+                    _upload_state = HEADER_117;
+                }
+                break;
+        }
+    }
     
     led3() = !led3();
     
-    if (data_transmission_complete)
-        return false;   //tell state machine class that this is done (not transmitting, false)
+    return !_end_sequence_transmission;     //tell state machine class that this is done (not transmitting, false)
+}
+
+// a packet with a good CRC: keep it if it is in the window (writeNextUploadPacket writes them in order),
+// acknowledge right away if a packet before it is missing or it is here already
+void MbedLogger::receiveUploadPacket() {
+    int length = (_transfer.upload.packet[6] << 8) | _transfer.upload.packet[7];
+    int crc = calcCrc16(_transfer.upload.packet, LOG_UPLOAD_HEADER_SIZE + length);
+    
+    if (_transfer.upload.packet[LOG_UPLOAD_HEADER_SIZE + length] != crc / 256 or _transfer.upload.packet[LOG_UPLOAD_HEADER_SIZE + length + 1] != crc % 256)
+        return;
+    
+    int packet_number = (_transfer.upload.packet[2] << 8) | _transfer.upload.packet[3];
+    int total = (_transfer.upload.packet[4] << 8) | _transfer.upload.packet[5];
+    
+    if (packet_number >= total)
+        return;
+    
+    _upload_total = total;
+    
+    int slot = packet_number % LOG_UPLOAD_WINDOW;
+    
+    if (packet_number >= _confirmed_packet_number and packet_number < _confirmed_packet_number + _upload_window
+        and _upload_slot_length[slot] < 0) {
+        memcpy(_transfer.upload.slot[slot], _transfer.upload.packet + LOG_UPLOAD_HEADER_SIZE, length);
+        _upload_slot_length[slot] = length;
+        
+        if (packet_number != _confirmed_packet_number)
+            _upload_ack_due = true;     //one before it is missing
+    }
     else {
-        return true;
+        _upload_ack_due = true;         //here or written already (the acknowledgement was lost) or past the window
     }
+}
+
+// the file is written in order, one packet per call so a filled hole with a window of packets behind it
+// doesn't hold up the main loop (the LocalFileSystem is slow)
+bool MbedLogger::writeNextUploadPacket() {
+    int slot = _confirmed_packet_number % LOG_UPLOAD_WINDOW;
+    int length = _upload_slot_length[slot];
+    
+    if (length < 0)
+        return false;
+    
+    if ((int)fwrite(_transfer.upload.slot[slot], 1, length, _upload_fp) != length)
+        _upload_write_errors++;
+    
+    _upload_slot_length[slot] = -1;
+    _upload_bytes_written += length;
+    _upload_packets_since_ack++;
+    _confirmed_packet_number++;
+    
+    if (_confirmed_packet_number >= _upload_total)
+        _upload_ack_due = true;     //all in, the PC can end it
+    
+    return true;
 }
\ No newline at end of file
@@ -8,6 +8,44 @@ using namespace std;
 #include <vector>
 #include <fstream>
 
+#include "LogRecord.hpp"
+#include "LogBuffer.hpp"
+#include "LogSink.hpp"
+#include "LogCompressor.hpp"
+
+#define LOG_BLOCK_BYTES     1024    //most bytes written to the file system per drainLogBuffer() call
+#define LOG_SINK_ONLY_MARGIN    4       //no log file: the sinks only get records once the buffer is this close to full
+#define LOG_CSV_MAX_LINE    320     //longest CSV line from a record (normally 255 with the newline)
+#define LOG_SEGMENT_MAX_BYTES   262144  //start a new segment after 256 KB (~17 minutes CSV, ~57 minutes binary at 1 Hz)
+#define LOG_MAX_SEGMENT     999     //LOG000 to LOG999 (8.3 file names)
+#define LOG_FULL_RECORD_INTERVAL    60  //every 60th 1 Hz binary record has every field (on-change fields included)
+#define LOG_KEYFRAME_INTERVAL   100     //delta encoding: full record every 100 records (10 seconds at 10 Hz)
+#define LOG_CSV_STATE_WIDTH     16      //CSV layout (formatCSVLine): StateStr right justified,
+#define LOG_CSV_STATE_NUMBER_WIDTH  2   //St# two digits,
+#define LOG_CSV_TIME_WIDTH      10      //TimeSec right justified,
+#define LOG_CSV_FIELD_WIDTH     6       //then every field zero padded (a comma before each column)
+#define LOG_CSV_STATE_NUMBER_OFFSET (LOG_CSV_STATE_WIDTH + 1)
+#define LOG_CSV_TIME_OFFSET     (LOG_CSV_STATE_NUMBER_OFFSET + LOG_CSV_STATE_NUMBER_WIDTH + 1)
+#define LOG_CSV_FIELDS_OFFSET   (LOG_CSV_TIME_OFFSET + LOG_CSV_TIME_WIDTH)     //comma in front of the first field
+#define LOG_CSV_LINE_LENGTH     (LOG_CSV_FIELDS_OFFSET + BINARY_LOG_NUM_FIELDS * (LOG_CSV_FIELD_WIDTH + 1))    //254 without the newline, EVERY LINE IS THIS LONG (transmit protocol)
+#define LOG_QUERY_PACKET_SIZE   15      //0x75 0x71 query packet from the PC (see receiveLogQuery)
+#define LOG_ACK_PACKET_SIZE     12      //0x75 0x61 window acknowledgement from the PC (see receiveWindowAck)
+#define LOG_WINDOW_MAX_PACKETS  32      //packets in flight, the acknowledgement bitmap covers this many
+#define LOG_IDENTITY_PACKET_SIZE    6   //0x75 0x69 segment identity request from the PC (see receiveIdentityRequest)
+#define LOG_IDENTITY_REPLY_SIZE     14  //segment, current segment, packets, fingerprint
+#define LOG_FINGERPRINT_LINES   2       //heading and first record, a rewritten segment has another first time stamp
+#define LOG_COMPRESS_BLOCK_LINES    8   //lines in a compressed download packet (0x75 0x7A), the line before is the primer
+#define LOG_PARITY_MAX_GROUP    15      //packets per parity packet (0x75 0x70), bits 4 to 7 of the acknowledgement flags
+#define LOG_PARITY_MAX_LENGTH   (4 + LOG_COMPRESS_BLOCK_LINES * (LOG_CSV_LINE_LENGTH + 1))    //compressed block with its lines, method and length
+#define LOG_UPLOAD_HEADER_SIZE  8       //0x75 0x64 upload packet from the PC: packet, total packets, payload length (2 bytes each)
+#define LOG_UPLOAD_MAX_PAYLOAD  256     //bytes in an upload packet
+#define LOG_UPLOAD_WINDOW       8       //upload packets the PC can send past the first missing one (kept here until it comes)
+#define LOG_UPLOAD_RX_BUFFER    ((LOG_UPLOAD_WINDOW + 1) * (LOG_UPLOAD_HEADER_SIZE + LOG_UPLOAD_MAX_PAYLOAD + 2))  //xbee() RX buffer while uploading, a window fits in it while the file is written (MODSERIAL rounds it up to 4 KB)
+#define LOG_UPLOAD_ACK_MS       500     //acknowledgement sent again after this long without a byte (it or the last packets were lost)
+#define LOG_UPLOAD_TIMEOUT_MS   30000   //upload given up after this long without a byte from the PC
+#define LOG_TRANSMIT_TX_BUFFER  4096    //xbee() TX buffer during a log download (MODSERIAL sizes are powers of two), the longest packet (2052 byte block) or parity packet (2053) fits with room to spare
+#define LOG_TRANSMIT_TIMEOUT_MS 60000   //log download given up after this long without a byte from the PC
+
 //used in switch-case statements for checking if I received the correct packets
 enum {
     HEADER_117,
@@ -28,7 +66,24 @@ enum {
     PACKET_NO_1,
     PACKET_NO_2,
     END_TX_1,
-    END_TX_2
+    END_TX_2,
+    QUERY_PACKET,
+    ACK_PACKET,
+    IDENTITY_PACKET,
+    UPLOAD_PACKET
+};
+
+//buffers only one transfer uses at a time (isTransferRunning), so they share the memory
+union LogTransferBuffers {
+    struct {
+        uint8_t compress_input[(LOG_COMPRESS_BLOCK_LINES + 1) * (LOG_CSV_LINE_LENGTH + 1)];   //primer line and the block
+        uint8_t compress_output[LOG_COMPRESS_BLOCK_LINES * (LOG_CSV_LINE_LENGTH + 1)];        //sent as it is if it doesn't get smaller
+        uint8_t parity[LOG_PARITY_MAX_LENGTH];      //XOR of the packets, the PC rebuilds one lost packet per group from it
+    } download;
+    struct {
+        uint8_t packet[LOG_UPLOAD_HEADER_SIZE + LOG_UPLOAD_MAX_PAYLOAD + 2];    //packet being received
+        uint8_t slot[LOG_UPLOAD_WINDOW][LOG_UPLOAD_MAX_PAYLOAD];    //packets that came before the first missing one (slot is packet % LOG_UPLOAD_WINDOW)
+    } upload;
 };
 
 class MbedLogger {
@@ -36,11 +91,24 @@ public:
     MbedLogger(string file_system_input_string);            //to choose between MBED and SD card
     
     void setLogTime();
-    void initializeLogFile();
+    void setLogTime(time_t epoch_seconds);      //set the wall time and anchor the log time stamps to it
+    unsigned int getWallTime(uint64_t time_us); //wall time (seconds since 1970) of a systemClock time stamp
+    static unsigned int getWallTime(uint64_t time_us, unsigned int epoch_seconds, uint64_t epoch_time_us);
+    void initializeLogFile();           //finds the last segment (and recovers it if the power went while it was open)
     void closeLogFile();    //this sets pointer to null and checks if it is closed otherwise
     void appendLogFile(int current_state, int option);     //check if you have orphaned file pointers before this (file should not be open already)
     int getSystemTime();          //parse the time to record to the log file
     void recordData(int current_state); //Save current state of data
+    void recordFastData(int current_state); //fast fields only, binary log between the 1 Hz records
+    void setFastLogging(bool fast_logging);
+    bool getFastLogging();
+    void setDeltaEncoding(bool delta_encoding);    //binary log DELTA records between keyframes
+    bool getDeltaEncoding();
+    void sampleData();                  //fill _data_log with the current readings
+    const char * getStateString(int current_state);   //16 character state name used in the log file
+    void setLogFormat(int log_format);  //LOG_FORMAT_CSV or LOG_FORMAT_BINARY
+    int getLogFormat();
+    string getLogFileName();            //full path of the log file for the current format
     void printMbedDirectory();          //print the MBED directory (future feature)
     void printCurrentLogFile();         //print the current MBED log file
     //void checkForPythonTransmitRequest();
@@ -48,26 +116,105 @@ public:
     int getNumberOfPacketsInCurrentLog();
     void transmitDataPacket();  // Transmit the data packet
     void transmitPacketNumber(int line_or_packet_number);
-    void eraseFile();       //erase MBED log file    
+    void eraseFile();       //erase all MBED log segments and the segment index
     int calcCrcOne();  //used with vector _data_packet, cleaning up later
     int calcCrcTwo();
-    void transmitMultiplePackets();  
+    bool startLogTransmit();            //open the transmit segment and serve the PC's requests (false if there is no segment)
+    void serviceLogTransmit();          //main loop, every tick: reads a request and fills the TX buffer with window packets
+    bool isTransmittingLog();
+    bool isTransferRunning();           //log download or sequence upload, nothing else may read xbee()
     void createDataPacket(char line_buffer_sent[], int line_length_sent);
     void setTransmitPacketNumber(int packet_number);
     bool endTransmitPacket();
-    void receiveSequenceFile();
-    int sendReply();
+    bool startSequenceReceive();        //open sequence.txt and acknowledge, the PC starts sending (false if it couldn't)
+    void serviceSequenceReceive();      //main loop, every tick: reads a packet and writes one at most
+    bool isReceivingSequence();         //upload running, nothing else may read xbee()
     int getFileSize(string filename);   //return the file size of the MBED log file
+    static int calcCrc16(const uint8_t * buffer, int length, int crc = 0);   //same CRC as the data packets, on a byte array (crc to continue one)
+    
+    void drainLogBuffer();              //write one block of buffered records (call when the main loop has slack)
+    void flushLogBuffer();              //write all buffered records and close the file
+    void printLogBufferStats();         //buffer, drop and write counters (debug menu)
+    
+    void addLogSink(LogSink * sink);    //SD card, radio, RAM ring... get the same formatted bytes as the MBED file
+    void serviceLogSinks();             //let each sink write some of its queue (call when the main loop has slack)
+    void printLogSinkStatus();
+    LogSink * getLogSink(int sink_number);  //1 to the number of sinks added, NULL otherwise
+    
+    void startNewLogSegment();          //next record goes into a new segment (start of a dive)
+    int getCurrentSegment();
+    void setTransmitSegment(int segment);   //segment to print/transmit
+    int getTransmitSegment();
+    string getTransmitFileName();       //LOG###.csv or LOG###.BIN, whichever format the segment was recorded in
+    bool isTransmitSegmentBinary();     //true (and says so) if it can't be printed or transmitted
+    string getSegmentFileName(int segment, int log_format);
+    static string getSegmentFileName(const string & file_system_string, int segment, int log_format);
+    void printSegmentIndex();
     
 private:
+    void sampleFields(uint32_t field_mask);
+    void fillBinaryRecord(BinaryLogRecord & record, int current_state, uint64_t data_log_time_us, uint32_t field_mask);
+    int encodeBinaryRecord(const BinaryLogRecord & record, uint32_t extra_fields, uint8_t * buffer);
+    int encodeDeltaRecord(const BinaryLogRecord & record, uint32_t field_mask, uint8_t * buffer);
+    void fillEpochRecord(BinaryLogRecord & record);
+    uint64_t getRecordTime(const BinaryLogRecord & record);
+    int formatCSVLine(const BinaryLogRecord & record, char * line_buffer);
+    static bool parseCSVLine(const char * line_buffer, int * state, unsigned int * wall_time);
+    int findLastLogSegment();
+    int getLogSegmentNumber(const char * file_name);
+    bool isSegmentIndexed(int segment);
+    int getSegmentFormat(int segment);
+    void recoverLogSegment(int segment);
+    void addToSegmentInfo(LogSegmentInfo & info, int state, unsigned int wall_time);
+    unsigned int scanCSVSegment(FILE * segment_fp, LogSegmentInfo & info);
+    unsigned int scanBinarySegment(FILE * segment_fp, LogSegmentInfo & info);
+    bool truncateLogFile(const string & file_name_string, unsigned int length);
+    bool copyFileBytes(const string & from_file_string, const string & to_file_string, unsigned int length);
+    void resetSegmentInfo();
+    void openLogSegment();
+    int fillSegmentHeader(char * buffer);
+    void closeLogSegment();
+    void rotateLogSegment();
+    void updateSegmentInfo(LogSegmentInfo & segment_info, const BinaryLogRecord & record);
+    void appendSegmentIndex(const LogSegmentInfo & segment_info);
+    void fillBinaryLogHeader(BinaryLogFileHeader * file_header);
+    void writeLogSinks(int flags, const char * bytes, int length);
+    void closeLogSinkSegments();
+    bool getLogSinksEnabled();
+    bool receiveLogQuery(const uint8_t * packet);
+    void startLogQuery(const LogQuery & query);
+    void restartLogQuery();
+    bool readNextQueryLine(char * line_buffer);
+    void transmitQueryPacket(int packet_number);
+    bool receiveWindowAck(const uint8_t * packet);
+    void serviceTransmitWindow(int window, int first_missing, uint32_t received_mask, bool resend_missing, bool compressed, int parity_group);
+    bool checkForTransmitRequest();
+    void finishLogTransmit();
+    void sendWindowPackets();
+    int getWindowPacketRoom();
+    bool hasTransmitRoom(int bytes);
+    bool sendDueParityPacket();
+    void transmitWindowPacket(int packet_number, bool add_to_parity);
+    void transmitCompressedBlock(int block_number, bool add_to_parity);
+    void addToParity(int packet_number, const uint8_t * header, int header_length, const uint8_t * data, int data_length);
+    void transmitParityPacket();
+    bool receiveIdentityRequest(const uint8_t * packet);
+    unsigned int getTransmitFingerprint();
+    void resetUpload();
+    void receiveUploadPacket();
+    bool writeNextUploadPacket();
+    void sendUploadAck();
+    void finishSequenceReceive();
+    
+
     FILE *_fp;              //the file pointer
     
     string _file_system_string;
-    string _full_file_path_string;
+    string _index_file_path_string; //SEGMENTS.TXT
     
     //check what I need to remove from this
     bool _file_transmission;
-    int _confirmed_packet_number;   //must set this to zero
+    int _confirmed_packet_number;   //upload: first packet not written yet
     int _transmit_counter;
     int _file_transmission_state;
     int _total_number_of_packets;
@@ -80,9 +227,96 @@ private:
     bool _end_transmit_packet;
     bool _end_sequence_transmission;
     int _packet_number;             //keep track of packet number for transmitting data
-    float _data_log[32];            //for logging all of the data from the outer and inner loops and so on
-    vector <int> _data_packet;      //holds the current packet I'm processing
-    std::vector<int>::iterator _it; //used to iterate through current data packet
+    float _data_log[BINARY_LOG_NUM_FIELDS]; //for logging all of the data from the outer and inner loops and so on (telemetry_log_fields order)
+    int _log_format;                //LOG_FORMAT_CSV or LOG_FORMAT_BINARY
+    unsigned int _binary_record_sequence;
+    
+    LogBuffer _log_buffer;          //records waiting to be written to the file
+    char _block_buffer[LOG_BLOCK_BYTES];    //one file write worth of records
+    bool _close_requested;          //close the file once the buffer is empty
+    unsigned int _blocks_written;
+    unsigned int _write_error_count;
+    unsigned int _last_drain_us;    //time of the last block write
+    unsigned int _max_drain_us;     //slowest block write
+    unsigned int _clamped_count;    //field values logged at +/-32767 (outside the telemetry_log_fields range)
+    unsigned int _file_skipped_count;   //records only the sinks got (no log file and the buffer nearly full)
+    
+    LogSink * _log_sinks[LOG_SINK_MAX_SINKS];   //formatted blocks are copied to these
+    int _log_sink_count;
+    
+    int _current_segment;           //segment being recorded (LOG###)
+    int _transmit_segment;          //segment printed/transmitted...
+    int _transmit_format;           //...and the format it was recorded in
+    bool _new_segment_requested;
+    LogSegmentInfo _segment_info;   //what has been written to the current segment (byte_count: bytes in the MBED file)
+    bool _segment_header_sent;      //the log sinks have the segment's heading/file header
+    bool _file_full_record_due;     //the next data record in the MBED file has every field (start of the file, or records missed)
+    
+    unsigned int _epoch_seconds;    //wall time set by setLogTime...
+    uint64_t _epoch_time_us;        //...and the systemClock time it was set at
+    
+    uint32_t _fast_field_mask;      //binary log rate classes (telemetry_log_fields rate column)
+    uint32_t _slow_field_mask;
+    uint32_t _change_field_mask;
+    int16_t _last_logged_field[BINARY_LOG_NUM_FIELDS];  //last value of each field written, for the on-change fields
+    bool _fast_logging;             //fast records between the 1 Hz records (binary log)
+    int _slow_records_since_full;
+    
+    bool _delta_encoding;           //DELTA records between keyframes (binary log)
+    int _records_since_keyframe;
+    int16_t _encoded_field[BINARY_LOG_NUM_FIELDS];  //field values as the decoder has them after the last record written
+    uint64_t _encoded_time_us;
+    
+    FILE *_transmit_fp;             //transmit (or query) segment while it is downloaded, the log file stays open on _fp
+    bool _transmit_running;         //startLogTransmit to finishLogTransmit
+    bool _transmit_restore_buffer;  //TX buffer back to its normal size once the last packets are out
+    int _transmit_trace_categories; //XBee trace categories, muted during the download
+    uint64_t _transmit_last_byte_us;    //system clock when the last byte came from the PC
+    int _transmit_state;            //checkForTransmitRequest parser state
+    uint8_t _transmit_request[LOG_QUERY_PACKET_SIZE];  //query, acknowledgement or identity packet being received (the query is the longest)
+    int _transmit_bytes;            //bytes of it so far
+    int _transmit_request_packet;   //line the PC asked for (0x75 0x65)
+    bool _query_active;             //the transmitter serves the query instead of whole lines
+    LogQuery _query;
+    int _query_segment;             //segment being read (-1 before the first)
+    int _query_line;                //lines read from it
+    int _query_packet;              //packet in _data_packet (sent again if the PC asks for it again)
+    int _query_lines;               //matching lines read (after decimation)
+    unsigned int _query_matches;    //lines that matched so far (before decimation)
+    bool _query_done;               //no more lines
+    uint8_t _query_skip_segment[(LOG_MAX_SEGMENT + 8) / 8];    //bit n set if the segment index rules segment n out
+    bool _window_active;            //the PC acknowledges windows of packets instead of requesting each one
+    int _window_next_packet;        //next packet not sent yet in this window transfer
+    unsigned int _window_send_count;    //packets sent in this window transfer...
+    unsigned int _window_sent_at[LOG_WINDOW_MAX_PACKETS + 1];  //...and the count when each packet in the window was last sent
+    bool _window_compressed;        //packets are blocks of LOG_COMPRESS_BLOCK_LINES compressed lines
+    int _window_total;              //packets (lines or blocks) in this window transfer
+    int _window_first_missing;      //last acknowledgement: first packet the PC doesn't have...
+    uint32_t _window_received_mask; //...the ones after it that it has...
+    int _window_limit;              //...and the end of its window
+    bool _window_resend[LOG_WINDOW_MAX_PACKETS + 1];   //holes to send again (same slots as _window_sent_at)
+    LogCompressor _compressor;
+    LogTransferBuffers _transfer;   //download compression and parity buffers, or the upload packets
+    int _parity_group;              //packets per parity packet, 0 for none
+    int _parity_first;              //first packet in the parity buffer...
+    int _parity_count;              //...and how many are in it
+    int _parity_length;             //longest packet in it
+    bool _parity_due;               //group complete, its parity packet goes out when the TX buffer has room for it
+    FILE *_upload_fp;               //sequence.txt while it is uploaded (the log file stays open on _fp)
+    bool _upload_running;           //startSequenceReceive to finishSequenceReceive
+    uint64_t _upload_last_byte_us;  //system clock when the last byte came...
+    uint64_t _upload_last_ack_us;   //...and when the last acknowledgement went
+    int _upload_state;              //checkForIncomingData parser state
+    int _upload_bytes;              //bytes of it so far (0x10 bytes in a row for END_TRANSMISSION)
+    int _upload_total;              //packets in the file, 0 until the first one comes
+    int _upload_window;             //LOG_UPLOAD_WINDOW, 1 if the bigger RX buffer couldn't be allocated
+    int _upload_slot_length[LOG_UPLOAD_WINDOW];     //lengths of the packets in the upload slots, -1 for an empty slot
+    int _upload_packets_since_ack;  //packets written since the last acknowledgement
+    bool _upload_ack_due;           //out of order or repeated packet, acknowledge now
+    unsigned int _upload_bytes_written;
+    unsigned int _upload_write_errors;
+    vector <uint8_t> _data_packet;  //holds the current packet I'm processing (bytes, so it goes to the radio in one write)
+    std::vector<uint8_t>::iterator _it; //used to iterate through current data packet
     //check what I need to remove from this !!!!!!!!!!!!!!!!!!
 };
  
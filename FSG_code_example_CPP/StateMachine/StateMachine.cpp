@@ -21,9 +21,6 @@ There is still some debug code used to check the output from the PCB.
 #include "StateMachine.hpp"
 #include "StaticDefs.hpp"
 
-//print to both serial ports using this macro
-#define serialPrint(fmt, ...) pc().printf(fmt, ##__VA_ARGS__);xbee().printf(fmt, ##__VA_ARGS__)
- 
 StateMachine::StateMachine() {
     _timeout = 20;            // generic timeout for every state, seconds
     
@@ -99,7 +96,7 @@ int StateMachine::runStateMachine() {
                 printDebugMenu();
             else
                 printSimpleMenu();
-            serialPrint("\r\n\nstate: SIT_IDLE\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: SIT_IDLE\r\n");
             _isTimeoutRunning = true; 
  
             // what is active?
@@ -117,7 +114,7 @@ int StateMachine::runStateMachine() {
     case CHECK_TUNING :                 // state used to check the tuning of the pressure vessel
         // start local state timer and init any other one-shot actions
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: CHECK_TUNING\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: CHECK_TUNING\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -132,13 +129,13 @@ int StateMachine::runStateMachine() {
             
             // getSetPosition_mm is the commanded position in the LinearActuator class
             
-            serialPrint("CHECK_TUNING: BCE cmd: %3.1f (BCE current position: %3.1f)\r\n", bce().getSetPosition_mm(), bce().getPosition_mm());
-            serialPrint("CHECK_TUNING: BATT cmd: %3.1f (BATT current position: %3.1f)\r\n", batt().getSetPosition_mm(), bce().getPosition_mm());
+            TRACE(TRACE_STATE, TRACE_INFO, "CHECK_TUNING: BCE cmd: %3.1f (BCE current position: %3.1f)\r\n", bce().getSetPosition_mm(), bce().getPosition_mm());
+            TRACE(TRACE_STATE, TRACE_INFO, "CHECK_TUNING: BATT cmd: %3.1f (BATT current position: %3.1f)\r\n", batt().getSetPosition_mm(), bce().getPosition_mm());
         }
     
         // how exit?
         if (_fsm_timer > _timeout) {
-            serialPrint("CHECK_TUNING: timed out!\r\n");
+            TRACE(TRACE_STATE, TRACE_WARN, "CHECK_TUNING: timed out!\r\n");
             _state = FLOAT_BROADCAST;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
@@ -148,14 +145,15 @@ int StateMachine::runStateMachine() {
         // the inner loop position controls are maintaining the positions of the linear actuators
         
         //print status to screen continuously
-        serialPrint("CHECK_TUNING: BCE_position: %0.1f, BATT_position: %0.1f (BCE_cmd: %0.1f, BATT_cmd: %0.1f)(depth: %0.1f ft,pitch: %0.1f deg,heading: %0.1f)     [%0.1f sec]\r",bce().getPosition_mm(),batt().getPosition_mm(),bce().getSetPosition_mm(),batt().getSetPosition_mm(),depthLoop().getPosition(),pitchLoop().getPosition(),imu().getHeading(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_CHECK_TUNING_STATUS,bce().getPosition_mm(),batt().getPosition_mm(),bce().getSetPosition_mm(),batt().getSetPosition_mm(),depthLoop().getPosition(),pitchLoop().getPosition(),imu().getHeading(),_fsm_timer.read());
         
         break;
  
     case EMERGENCY_CLIMB :
         // start local state timer and init any other one-shot actions
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: EMERGENCY_CLIMB\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: EMERGENCY_CLIMB\r\n");
+            blackBox().trigger(BLACK_BOX_TRIGGER_EMERGENCY);    //keep the last seconds at 100 Hz (BBOX###.BIN)
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -171,7 +169,7 @@ int StateMachine::runStateMachine() {
         
         // how exit?
         if (_fsm_timer > _timeout) {
-            serialPrint("EC: timed out\r\n");
+            TRACE(TRACE_STATE, TRACE_WARN, "EC: timed out\r\n");
             _state = FLOAT_BROADCAST;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
@@ -184,14 +182,14 @@ int StateMachine::runStateMachine() {
         
         //WHAT IS ACTIVE?
         //print status to screen continuously
-        serialPrint("EC: depth: %3.1f, pitch: %0.1f deg [BCE:%0.1f (cmd: %0.1f) BMM:%0.1f (cmd: %0.1f)] [%0.1f sec]\r",depthLoop().getPosition(),pitchLoop().getPosition(),bce().getPosition_mm(), bce().getSetPosition_mm(),batt().getPosition_mm(), batt().getSetPosition_mm(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_EMERGENCY_CLIMB_STATUS,depthLoop().getPosition(),pitchLoop().getPosition(),bce().getPosition_mm(), bce().getSetPosition_mm(),batt().getPosition_mm(), batt().getSetPosition_mm(),_fsm_timer.read());
         
         break;
  
     case FIND_NEUTRAL :
         // start local state timer and init any other one-shot actions
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: FIND_NEUTRAL\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: FIND_NEUTRAL\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true;
@@ -221,7 +219,7 @@ int StateMachine::runStateMachine() {
  
         // how exit? (exit with the timer, if timer still running continue processing sub FSM)
         if (_fsm_timer > _timeout) {
-            serialPrint("FN: timed out [time: %0.1f sec]\r\n", _fsm_timer.read());
+            TRACE(TRACE_STATE, TRACE_WARN, "FN: timed out [time: %0.1f sec]\r\n", _fsm_timer.read());
             _state = EMERGENCY_CLIMB;         //new behavior (if this times out it emergency surfaces)
             _fsm_timer.reset();
             _isTimeoutRunning = false;
@@ -235,7 +233,7 @@ int StateMachine::runStateMachine() {
         //check if substate returned exit state, if so stop running the sub-FSM
         else if (runNeutralStateMachine() == NEUTRAL_EXIT) { 
             //if successful, FIND_NEUTRAL then goes to RISE
-            serialPrint("*************************************** FIND_NEUTRAL sequence complete.  Rising.\r\n\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "*************************************** FIND_NEUTRAL sequence complete.  Rising.\r\n\n");
             _state = RISE;
             _isTimeoutRunning = false;
         }
@@ -246,7 +244,7 @@ int StateMachine::runStateMachine() {
         // start local state timer and init any other one-shot actions
                
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: DIVE\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: DIVE\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -261,9 +259,9 @@ int StateMachine::runStateMachine() {
             
             headingLoop().setCommand(_heading_command);     //ACTIVE HEADING (mimic of dive and rise code)
             
-            serialPrint("DIVE: depth cmd: %3.1f\r\n",depthLoop().getCommand());
-            serialPrint("DIVE: pitch cmd: %3.1f\r\n",pitchLoop().getCommand());
-            serialPrint("DIVE: heading cmd: %3.1f\r\n",headingLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "DIVE: depth cmd: %3.1f\r\n",depthLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "DIVE: pitch cmd: %3.1f\r\n",pitchLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "DIVE: heading cmd: %3.1f\r\n",headingLoop().getCommand());
             
             //reset max dive depth
             _max_recorded_depth_dive = -99;            //float to record max depth
@@ -271,20 +269,20 @@ int StateMachine::runStateMachine() {
  
         // how exit?
         if (_fsm_timer.read() > _timeout) {
-            serialPrint("DIVE: timed out\r\n\n");
+            TRACE(TRACE_STATE, TRACE_WARN, "DIVE: timed out\r\n\n");
             _state = RISE; //new behavior 11/17/2017
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
         else if (depthLoop().getPosition() > depthLoop().getCommand() - 0.5) { // including offset for low momentum approaches
-            serialPrint("DIVE: actual depth: %3.1f (cmd: %3.1f)\r\n", depthLoop().getPosition(), depthLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "DIVE: actual depth: %3.1f (cmd: %3.1f)\r\n", depthLoop().getPosition(), depthLoop().getCommand());
             _state = RISE;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
  
         // WHAT IS ACTIVE?
-        serialPrint("DIVE: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg [cmd:%6.1f], heading_imu:%6.1f deg>>[%0.2f sec]                                         \r", bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),pitchLoop().getCommand(),imu().getHeading(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_DIVE_STATUS, bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),pitchLoop().getCommand(),imu().getHeading(),_fsm_timer.read());
         bce().setPosition_mm(depthLoop().getOutput());  //constantly checking the Outer Loop output to move the motors
         batt().setPosition_mm(pitchLoop().getOutput());
         
@@ -301,7 +299,7 @@ int StateMachine::runStateMachine() {
         // start local state timer and init any other one-shot actions
         
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: RISE\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: RISE\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -316,14 +314,14 @@ int StateMachine::runStateMachine() {
             
             headingLoop().setCommand(_heading_command);     //ACTIVE HEADING (mimic of dive and rise code)
             
-            serialPrint("RISE: depth cmd: %3.1f\r\n",depthLoop().getCommand());
-            serialPrint("RISE: pitch cmd: %3.1f\r\n",pitchLoop().getCommand());
-            serialPrint("RISE: heading cmd: %3.1f\r\n",headingLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "RISE: depth cmd: %3.1f\r\n",depthLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "RISE: pitch cmd: %3.1f\r\n",pitchLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "RISE: heading cmd: %3.1f\r\n",headingLoop().getCommand());
         }
  
         // how exit?
         if (_fsm_timer.read() > _timeout) {
-            serialPrint("RISE: timed out\r\n");
+            TRACE(TRACE_STATE, TRACE_WARN, "RISE: timed out\r\n");
             _state = EMERGENCY_CLIMB;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
@@ -332,14 +330,14 @@ int StateMachine::runStateMachine() {
         //modified from (depthLoop().getPosition() < depthLoop().getCommand() + 0.5) 
         //did not work correctly in bench test (stuck in rise state)
         else if (depthLoop().getPosition() < 0.5) {
-            serialPrint("RISE: actual depth: %3.1f (cmd: %3.1f)\r\n", depthLoop().getPosition(), depthLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "RISE: actual depth: %3.1f (cmd: %3.1f)\r\n", depthLoop().getPosition(), depthLoop().getCommand());
             _state = FLOAT_BROADCAST;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
  
         // WHAT IS ACTIVE?
-        serialPrint("RISE: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg [cmd:%6.1f], heading_imu:%6.1f deg>>[%0.2f sec]                                         \r", bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),pitchLoop().getCommand(),imu().getHeading(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_RISE_STATUS, bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),pitchLoop().getCommand(),imu().getHeading(),_fsm_timer.read());
         bce().setPosition_mm(depthLoop().getOutput());  //constantly checking the Outer Loop output to move the motors
         batt().setPosition_mm(pitchLoop().getOutput());
         
@@ -352,7 +350,7 @@ int StateMachine::runStateMachine() {
     case POSITION_DIVE :               
         // start local state timer and init any other one-shot actions
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: POSITION DIVE\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: POSITION DIVE\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -372,9 +370,9 @@ int StateMachine::runStateMachine() {
                         
             headingLoop().setCommand(_heading_command);     //ACTIVE HEADING (mimic of dive and rise code)
             
-            serialPrint("POS DIVE: BATT cmd: %3.1f\r\n",batt().getSetPosition_mm());  //get the actual commanded position
-            serialPrint("POS DIVE: BCE cmd: %3.1f\r\n",bce().getSetPosition_mm());    //get the actual commanded position
-            serialPrint("POS DIVE: heading cmd: %3.1f\r\n",headingLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "POS DIVE: BATT cmd: %3.1f\r\n",batt().getSetPosition_mm());  //get the actual commanded position
+            TRACE(TRACE_STATE, TRACE_INFO, "POS DIVE: BCE cmd: %3.1f\r\n",bce().getSetPosition_mm());    //get the actual commanded position
+            TRACE(TRACE_STATE, TRACE_INFO, "POS DIVE: heading cmd: %3.1f\r\n",headingLoop().getCommand());
             
             //reset max dive depth
             _max_recorded_depth_dive = -99;            //float to record max depth
@@ -383,7 +381,7 @@ int StateMachine::runStateMachine() {
         // how exit?
         // timer runs out goes to POSITION_RISE
         if (_fsm_timer.read() > _timeout) {
-            serialPrint("POS DIVE timed out\r\n\n");
+            TRACE(TRACE_STATE, TRACE_WARN, "POS DIVE timed out\r\n\n");
             _state = POSITION_RISE; //new behavior 11/17/2017
             _fsm_timer.reset();
             _isTimeoutRunning = false;
@@ -391,14 +389,14 @@ int StateMachine::runStateMachine() {
         
         // when you reach the dive threshold, surface
         else if (depthLoop().getPosition() > depthLoop().getCommand() - 0.5) { // including offset for low momentum approaches
-            serialPrint("POS DIVE: actual depth: %3.1f (cmd: %3.1f)\r\n", depthLoop().getPosition(), depthLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "POS DIVE: actual depth: %3.1f (cmd: %3.1f)\r\n", depthLoop().getPosition(), depthLoop().getCommand());
             _state = POSITION_RISE;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
  
         // what is active?
-        serialPrint("POS DIVE: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg, heading_imu:%6.1f deg>>[%0.2f sec]                                         \r", bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),imu().getHeading(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_POSITION_DIVE_STATUS, bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),imu().getHeading(),_fsm_timer.read());
         
         if (depthLoop().getPosition() > _max_recorded_depth_dive) {
             _max_recorded_depth_dive = depthLoop().getPosition();    //new max depth recorded when it is larger than previous values
@@ -413,7 +411,7 @@ int StateMachine::runStateMachine() {
         // start local state timer and init any other one-shot actions
         
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: POSITION RISE\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: POSITION RISE\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -428,27 +426,27 @@ int StateMachine::runStateMachine() {
             
             headingLoop().setCommand(_heading_command);     //ACTIVE HEADING (mimic of dive and rise code)
             
-            serialPrint("POS RISE: BATT cmd: %3.1f\r\n",batt().getSetPosition_mm());  //get the actual commanded position
-            serialPrint("POS RISE: BCE cmd: %3.1f\r\n",bce().getSetPosition_mm());    //get the actual commanded position
-            serialPrint("POS RISE: heading cmd: %3.1f\r\n",headingLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "POS RISE: BATT cmd: %3.1f\r\n",batt().getSetPosition_mm());  //get the actual commanded position
+            TRACE(TRACE_STATE, TRACE_INFO, "POS RISE: BCE cmd: %3.1f\r\n",bce().getSetPosition_mm());    //get the actual commanded position
+            TRACE(TRACE_STATE, TRACE_INFO, "POS RISE: heading cmd: %3.1f\r\n",headingLoop().getCommand());
         }
  
         // how exit?
         if (_fsm_timer.read() > _timeout) {
-            serialPrint("POS RISE: timed out\r\n");
+            TRACE(TRACE_STATE, TRACE_WARN, "POS RISE: timed out\r\n");
             _state = EMERGENCY_CLIMB;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
         else if (depthLoop().getPosition() < 0.5) {
-            serialPrint("POS RISE: actual depth: %3.1f (cmd: %3.1f)\r\n", depthLoop().getPosition(), depthLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "POS RISE: actual depth: %3.1f (cmd: %3.1f)\r\n", depthLoop().getPosition(), depthLoop().getCommand());
             _state = FLOAT_BROADCAST;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
  
         // what is active?
-        serialPrint("POS RISE: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg, heading_imu:%6.1f deg>>[%0.2f sec]                                         \r", bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),imu().getHeading(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_POSITION_RISE_STATUS, bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),imu().getHeading(),_fsm_timer.read());
         
         // ACTIVE RUDDER CONTROL
         rudder().setPosition_deg(headingLoop().getOutput());
@@ -459,7 +457,7 @@ int StateMachine::runStateMachine() {
     case FLOAT_LEVEL :
         // start local state timer and init any other one-shot actions
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: FLOAT_LEVEL\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: FLOAT_LEVEL\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -475,20 +473,20 @@ int StateMachine::runStateMachine() {
         
         // how exit?
         if (_fsm_timer > _timeout) {
-            serialPrint("FL: timed out\r\n");
+            TRACE(TRACE_STATE, TRACE_WARN, "FL: timed out\r\n");
             _state = FLOAT_BROADCAST;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
         else if (fabs(imu().getPitch() - pitchLoop().getCommand()) < fabs(_pitchTolerance)) {         //current tolerance is 5 degrees
-            serialPrint("FL: pitch: %3.1f mm, set pos: %3.1f mm, deadband: %3.1f mm\r\n",imu().getPitch(), pitchLoop().getCommand(), _pitchTolerance);
+            TRACE(TRACE_STATE, TRACE_INFO, "FL: pitch: %3.1f mm, set pos: %3.1f mm, deadband: %3.1f mm\r\n",imu().getPitch(), pitchLoop().getCommand(), _pitchTolerance);
             _state = FLOAT_BROADCAST;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
         
         // what is active?
-        serialPrint("FL: pitchLoop output: %3.1f, batt pos: %3.1f, piston pos: %3.1f [%0.1f sec]\r", pitchLoop().getOutput(), batt().getPosition_mm(), bce().getPosition_mm(), _fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_FLOAT_LEVEL_STATUS, pitchLoop().getOutput(), batt().getPosition_mm(), bce().getPosition_mm(), _fsm_timer.read());
         batt().setPosition_mm(pitchLoop().getOutput());
         
         break;
@@ -496,7 +494,7 @@ int StateMachine::runStateMachine() {
     case FLOAT_BROADCAST :
         // start local state timer and init any other one-shot actions
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: FLOAT_BROADCAST\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: FLOAT_BROADCAST\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -511,11 +509,15 @@ int StateMachine::runStateMachine() {
             
             //set rudder to center
             rudder().setPosition_deg(0.0);  //set rudder to center, zero degrees
+            
+            //end of the dive, go/no-go numbers for the operator
+            diveStatistics().printSummary();
+            diveStatistics().writeSummary("/local/DIVES.TXT");
         }
         
         // how exit?
         if (_fsm_timer > _timeout) {
-            serialPrint("FB: timed out\r\n");
+            TRACE(TRACE_STATE, TRACE_WARN, "FB: timed out\r\n");
             _state = SIT_IDLE;
             _fsm_timer.reset();
             
@@ -530,7 +532,7 @@ int StateMachine::runStateMachine() {
         //still working on integral function
         else if ( (fabs(bce().getPosition_mm() - bce().getSetPosition_mm()) < 5.0 ) and
                   (fabs(batt().getPosition_mm() - batt().getSetPosition_mm()) < batt().getDeadband()) ) {
-            serialPrint("FB: position: %3.1f mm, set pos: %3.1f mm, deadband: %3.1f mm\r\n",bce().getPosition_mm(), bce().getSetPosition_mm(), bce().getDeadband());
+            TRACE(TRACE_STATE, TRACE_INFO, "FB: position: %3.1f mm, set pos: %3.1f mm, deadband: %3.1f mm\r\n",bce().getPosition_mm(), bce().getSetPosition_mm(), bce().getDeadband());
             _state = SIT_IDLE;
             _fsm_timer.reset();
             
@@ -541,14 +543,14 @@ int StateMachine::runStateMachine() {
         }
         
         // what is active?
-        serialPrint("FB: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg, heading_imu:%6.1f deg>>[%0.2f sec]                                         \r", bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),imu().getHeading(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_FLOAT_BROADCAST_STATUS, bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),imu().getHeading(),_fsm_timer.read());
         
         break;
         
     case MULTI_DIVE :
         // start local state timer and init any other one-shot actions        
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: MULTI-DIVE\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: MULTI-DIVE\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -567,27 +569,27 @@ int StateMachine::runStateMachine() {
             
             
             headingLoop().setCommand(_heading_command);     //ACTIVE HEADING (mimic of dive and rise code)
-            serialPrint("MULTI-DIVE: depth cmd: %3.1f ft, pitch cmd: %3.1f deg\r\n",depthLoop().getCommand(), pitchLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "MULTI-DIVE: depth cmd: %3.1f ft, pitch cmd: %3.1f deg\r\n",depthLoop().getCommand(), pitchLoop().getCommand());
             
             //no max depth recording right now
         }
         
         // how exit?
         if (_fsm_timer > _timeout) {
-            serialPrint("\r\n\nMULTI-DIVE: timed out [time: %0.1f]\r\n\n", _fsm_timer.read());
+            TRACE(TRACE_STATE, TRACE_WARN, "\r\n\nMULTI-DIVE: timed out [time: %0.1f]\r\n\n", _fsm_timer.read());
             _state = MULTI_RISE; //new behavior 11/17/2017
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
         else if (depthLoop().getPosition() > depthLoop().getCommand()) {
-            serialPrint("MULTI-DIVE: depth: %3.1f, cmd: %3.1f\r\n", depthLoop().getPosition(), depthLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "MULTI-DIVE: depth: %3.1f, cmd: %3.1f\r\n", depthLoop().getPosition(), depthLoop().getCommand());
             _state = MULTI_RISE;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
         }
         
         // WHAT IS ACTIVE?
-        serialPrint("MD: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg [cmd:%6.1f], heading_imu:%6.1f deg>>[%0.2f sec]                                         \r", bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),pitchLoop().getCommand(),imu().getHeading(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_MULTI_DIVE_STATUS, bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),pitchLoop().getCommand(),imu().getHeading(),_fsm_timer.read());
         bce().setPosition_mm(depthLoop().getOutput());
         batt().setPosition_mm(pitchLoop().getOutput());
         
@@ -599,7 +601,7 @@ int StateMachine::runStateMachine() {
     case MULTI_RISE :
         // start local state timer and init any other one-shot actions
         if (!_isTimeoutRunning) {
-            serialPrint("\r\n\nstate: MULTI-RISE\r\n");
+            TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nstate: MULTI-RISE\r\n");
             _fsm_timer.reset(); // timer goes back to zero
             _fsm_timer.start(); // background timer starts running
             _isTimeoutRunning = true; 
@@ -620,12 +622,12 @@ int StateMachine::runStateMachine() {
             pitchLoop().setCommand(-sequence_pitch_command);            
             
             headingLoop().setCommand(_heading_command);     //ACTIVE HEADING (mimic of dive and rise code)
-            serialPrint("MULTI-RISE: depth cmd: 0.0 ft, pitch cmd: %3.1f deg\r\n",depthLoop().getCommand(), pitchLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "MULTI-RISE: depth cmd: 0.0 ft, pitch cmd: %3.1f deg\r\n",depthLoop().getCommand(), pitchLoop().getCommand());
         }
         
         // how exit?
         if (_fsm_timer > _timeout) {
-            serialPrint("MULTI-RISE: timed out [time: %0.1f]\r\n\n", _fsm_timer.read());
+            TRACE(TRACE_STATE, TRACE_WARN, "MULTI-RISE: timed out [time: %0.1f]\r\n\n", _fsm_timer.read());
             _state = EMERGENCY_CLIMB;
             _fsm_timer.reset();
             _isTimeoutRunning = false;
@@ -637,7 +639,7 @@ int StateMachine::runStateMachine() {
 //            sequenceController().loadSequence();
         }
         else if (depthLoop().getPosition() < 0.5) { // depth is less than 0.5 (zero is surface level)
-            serialPrint("MULTI-RISE: depth: %3.1f, cmd: %3.1f\r\n", depthLoop().getPosition(), depthLoop().getCommand());
+            TRACE(TRACE_STATE, TRACE_INFO, "MULTI-RISE: depth: %3.1f, cmd: %3.1f\r\n", depthLoop().getPosition(), depthLoop().getCommand());
             
             //going to next state            
             _isTimeoutRunning = false;
@@ -664,7 +666,7 @@ int StateMachine::runStateMachine() {
         }
         
         // WHAT IS ACTIVE?
-        serialPrint("MR: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg [cmd:%6.1f], heading_imu:%6.1f deg>>[%0.2f sec]                                         \r", bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),pitchLoop().getCommand(),imu().getHeading(),_fsm_timer.read());
+        TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_MULTI_RISE_STATUS, bce().getPosition_mm(),bce().getSetPosition_mm(),batt().getPosition_mm(),batt().getSetPosition_mm(),rudder().getSetPosition_deg(),depthLoop().getPosition(),depthLoop().getCommand(),pitchLoop().getPosition(),pitchLoop().getCommand(),imu().getHeading(),_fsm_timer.read());
         bce().setPosition_mm(depthLoop().getOutput());  //constantly checking the Outer Loop output to move the motors
         batt().setPosition_mm(pitchLoop().getOutput()); 
         
@@ -673,30 +675,30 @@ int StateMachine::runStateMachine() {
         
         break; 
         
+    case TX_MBED_LOG :
+        TRACE(TRACE_STATE, TRACE_INFO, "state: TX_MBED_LOG\r\n");
+        
+        //the download runs from the main loop (it has its own timeout), back to idle right away
+        mbedLogger().startLogTransmit();
+        
+        _state = SIT_IDLE;
+        _isTimeoutRunning = false;
+        
+        break;
+        
     case RX_SEQUENCE :
-        serialPrint("state: RX_SEQUENCE\r\n");
-    
-        if (!_isTimeoutRunning) {
-            serialPrint("RX_SEQUENCE _isTimeoutRunning\r\n");
-            _fsm_timer.reset(); // timer goes back to zero
-            _fsm_timer.start(); // background timer starts running
-            _isTimeoutRunning = true; 
-        }
+        TRACE(TRACE_STATE, TRACE_INFO, "state: RX_SEQUENCE\r\n");
         
-        if (_fsm_timer.read() > _timeout) {
-            serialPrint("RX_SEQUENCE: timed out!\r\n");
-            _state = SIT_IDLE;
-            _fsm_timer.reset();
-            _isTimeoutRunning = false;
-        }
+        //the upload runs from the main loop (it has its own timeout), back to idle right away
+        mbedLogger().startSequenceReceive();
         
-        // what is active?
-        serialPrint("Receive sequence active?\r\n");
+        _state = SIT_IDLE;
+        _isTimeoutRunning = false;
         
         break;
     
     default :
-        serialPrint("DEBUG: SIT_IDLE\r\n");
+        TRACE(TRACE_STATE, TRACE_INFO, "DEBUG: SIT_IDLE\r\n");
         _state = SIT_IDLE;
     }
     
@@ -708,6 +710,9 @@ int StateMachine::runStateMachine() {
         _previous_state = _state;
     }
     
+    //running min/max/mean and time in each state for the dive summary
+    diveStatistics().update(_state);
+    
     return _state;
 }   /* end of runStateMachine */
  
@@ -721,6 +726,7 @@ void StateMachine::printSimpleMenu() {
     serialPrint("  B to float at broadcast pitch\r\n");
     serialPrint("  E to initiate emergency climb\r\n");
     serialPrint("  P to print the current log file.\r\n");
+    serialPrint("  K to show/transmit the last dive summary (go/no-go)\r\n");
     serialPrint("  G to transmit MBED log file\r\n");
     serialPrint("  I to receive multi-dive sequence file\r\n");
     serialPrint("  ~ to erase mbed log file. (clear before logging more than a few runs)\r\n");
@@ -751,7 +757,10 @@ void StateMachine::printDebugMenu() {
     serialPrint("  '|' to HOME the BMM (5 second delay)\r\n");
     serialPrint("  Z to show FSM and sub-FSM states.\r\n");
     serialPrint("  P to print the current log file.\r\n");
-    serialPrint("  X to print the list of log files.\r\n");
+    serialPrint("  X to print the list of log files (and the log segment index).\r\n");
+    serialPrint("  L to show the log buffer counters (records waiting, dropped, write times).\r\n");
+    serialPrint("  O to change the status line on the XBee: off/text/binary (now: %s)\r\n", !(trace().getPortCategories(TRACE_PORT_XBEE) & TRACE_STATUS) ? "off" : (trace().getBinaryCategories() & TRACE_STATUS) ? "binary" : "text");
+    serialPrint("  K to show/transmit the last dive summary (go/no-go)\r\n");
     serialPrint("  I to receive data.\r\n");
     serialPrint("  G to transmit MBED log file (60 second timeout)\r\n");
     serialPrint("  ~ to erase mbed log file. (clear before logging more than a few runs)\r\n");
@@ -786,12 +795,12 @@ int StateMachine::runNeutralStateMachine() {
             if (!_isSubStateTimerRunning) {                
                 _neutral_timer = _fsm_timer.read() + 5; //record the time when this block is first entered and add 5 seconds
                 
-                serialPrint("\r\n\nNEUTRAL_SINKING: Next retraction at %0.1f sec [current time: %0.1f] (pitch: %0.1f) (BCE getSetPosition: %0.1f)\r\n", _neutral_timer, _fsm_timer.read(), pitchLoop().getPosition(), bce().getSetPosition_mm());
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nNEUTRAL_SINKING: Next retraction at %0.1f sec [current time: %0.1f] (pitch: %0.1f) (BCE getSetPosition: %0.1f)\r\n", _neutral_timer, _fsm_timer.read(), pitchLoop().getPosition(), bce().getSetPosition_mm());
                 
                 // what are the commands? (BCE linear actuator active, no BMM or pitch movement)
                 bce().setPosition_mm(bce().getSetPosition_mm() - 2.5);
                 
-                serialPrint("NEUTRAL_SINKING: Retracting piston 2.5 mm [BCE CMD : %0.1f] (pitch: %0.1f)\r\n", bce().getSetPosition_mm(), pitchLoop().getPosition());
+                TRACE(TRACE_STATE, TRACE_INFO, "NEUTRAL_SINKING: Retracting piston 2.5 mm [BCE CMD : %0.1f] (pitch: %0.1f)\r\n", bce().getSetPosition_mm(), pitchLoop().getPosition());
                 
                 _isSubStateTimerRunning = true;    //disable this block after one iteration
             }
@@ -799,7 +808,7 @@ int StateMachine::runNeutralStateMachine() {
             // how exit?
             //once reached the travel limit, no need to keep trying, so exit
             if (bce().getPosition_mm() <= 0) {
-                serialPrint("\r\nDEBUG: BCE current position is %0.1f mm (NEXT SUBSTATE NEUTRAL EXIT)\r\n", bce().getPosition_mm());
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\nDEBUG: BCE current position is %0.1f mm (NEXT SUBSTATE NEUTRAL EXIT)\r\n", bce().getPosition_mm());
                 _substate = NEUTRAL_EXIT;
                 _isSubStateTimerRunning = false; // reset the sub state timer
             }
@@ -813,13 +822,13 @@ int StateMachine::runNeutralStateMachine() {
             // what is active?
             //once the 10 second timer is complete, reset the timeout so the state one-shot entry will move the setpoint
             if (_fsm_timer.read() >= _neutral_timer) {
-                serialPrint("\r\n\n NEUTRAL_SINKING TIMER COMPLETE! [current time: %0.1f]\r\n", _fsm_timer.read());
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\n\n NEUTRAL_SINKING TIMER COMPLETE! [current time: %0.1f]\r\n", _fsm_timer.read());
                 
                 _isSubStateTimerRunning = false; // reset the sub state timer to do one-shot actions again
             }
             
             // what is active? (only the buoyancy engine moved every 5 seconds at start)
-            serialPrint("BCE current pos: %0.1f mm (BCE setpoint: %0.1f mm) (current depth: %0.1f ft)\r", bce().getPosition_mm(),bce().getSetPosition_mm(),depthLoop().getPosition()); //debug
+            TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_NEUTRAL_SINKING_STATUS, bce().getPosition_mm(),bce().getSetPosition_mm(),depthLoop().getPosition()); //debug
             
             //the BCE moves every 5 seconds. No BMM or rudder movement.
             
@@ -829,7 +838,7 @@ int StateMachine::runNeutralStateMachine() {
             if (!_isSubStateTimerRunning) {                                
                 _neutral_timer = _fsm_timer.read()+ 5; //record the time when this block is first entered and add 5 seconds
                 
-                serialPrint("\r\n\nNEUTRAL_SLOWLY_RISE: Next extension at %0.1f sec) [current time: %0.1f]\r\n",_neutral_timer,_fsm_timer.read());
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nNEUTRAL_SLOWLY_RISE: Next extension at %0.1f sec) [current time: %0.1f]\r\n",_neutral_timer,_fsm_timer.read());
                 
                 // what are the commands?
                 //move piston at start of sequence (default: extend 2.0 mm)
@@ -840,7 +849,7 @@ int StateMachine::runNeutralStateMachine() {
                 // it's okay to run the pitch outer loop now since we've already found pitch level in the previous state
                 //pitchLoop().setCommand(0.0);
                 
-                serialPrint("NEUTRAL_SLOWLY_RISE: Extending BCE piston 2.0 mm [BCE CMD : %0.1f] (pitch: %0.1f)\r\n", bce().getSetPosition_mm(), pitchLoop().getPosition());
+                TRACE(TRACE_STATE, TRACE_INFO, "NEUTRAL_SLOWLY_RISE: Extending BCE piston 2.0 mm [BCE CMD : %0.1f] (pitch: %0.1f)\r\n", bce().getSetPosition_mm(), pitchLoop().getPosition());
 
                 _isSubStateTimerRunning = true;    //disable this block after one iteration
             }
@@ -854,7 +863,7 @@ int StateMachine::runNeutralStateMachine() {
             //Troy: Depth rate will go negative as the pressure vessel starts rising
             //depth rate or sink rate < 0 ft/s, go to the next substate the next iteration
             else if (depthLoop().getVelocity() < 0) { //less than zero ft/s
-                serialPrint("\r\n\nNEUTRAL_SLOWLY_RISE: Sink Rate < 0 ft/s [time: %0.1f]\r\n", _fsm_timer.read());
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nNEUTRAL_SLOWLY_RISE: Sink Rate < 0 ft/s [time: %0.1f]\r\n", _fsm_timer.read());
                 _substate = NEUTRAL_CHECK_PITCH;
                 _isSubStateTimerRunning = false; // reset the sub state timer
             }
@@ -862,13 +871,13 @@ int StateMachine::runNeutralStateMachine() {
             // what is active?
             //once 5 second timer complete, reset the timeout so the state one-shot entry will move the setpoint
             if (_fsm_timer.read() >= _neutral_timer) {
-                serialPrint("\r\n\n NEUTRAL_SLOWLY_RISE TIMER COMPLETE! [timer: %0.1f]\r\n", _fsm_timer.read());
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\n\n NEUTRAL_SLOWLY_RISE TIMER COMPLETE! [timer: %0.1f]\r\n", _fsm_timer.read());
    
                 _isSubStateTimerRunning = false; // reset the sub state timer to do one-shot actions again
             }
                         
             // what is active? (only the buoyancy engine moved every 5 seconds)
-            serialPrint("depthLoop getOutput: %0.1f\r", depthLoop().getOutput()); //debug
+            TRACE_ID(TRACE_STATUS, TRACE_DEBUG, TRACE_FMT_NEUTRAL_RISE_STATUS, depthLoop().getOutput()); //debug
             
             break;   
                 
@@ -877,16 +886,16 @@ int StateMachine::runNeutralStateMachine() {
             
             if (!_isSubStateTimerRunning) {                    
                 _neutral_timer = _fsm_timer.read() + 10; // record time when this block is entered and add several seconds
-                serialPrint("\r\nNEUTRAL_CHECK_PITCH: Next move in %0.1f sec \r\n",_neutral_timer - _fsm_timer.read());
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\nNEUTRAL_CHECK_PITCH: Next move in %0.1f sec \r\n",_neutral_timer - _fsm_timer.read());
                 
                 // what are the commands? (default: retract or extend 0.5 mm)
                 if (pitchLoop().getPosition() > 2) { // nose is high (extend batteries)
                     batt().setPosition_mm(batt().getSetPosition_mm() + 0.5); // move battery forward (using setpoint from linear actuator)
-                    serialPrint("\r\nNeutral Check Pitch: moving battery FWD in 0.5 mm increments\r\n\n");
+                    TRACE(TRACE_STATE, TRACE_INFO, "\r\nNeutral Check Pitch: moving battery FWD in 0.5 mm increments\r\n\n");
                 }
                 else if (pitchLoop().getPosition() < -2) { // nose is low (retract batteries)
                     batt().setPosition_mm(batt().getSetPosition_mm() - 0.5); // move battery aft (using setpoint from linear actuator)
-                    serialPrint("\r\nNeutral Check Pitch: moving battery AFT in 0.5 mm increments\r\n\n");
+                    TRACE(TRACE_STATE, TRACE_INFO, "\r\nNeutral Check Pitch: moving battery AFT in 0.5 mm increments\r\n\n");
                 }
 
                 _isSubStateTimerRunning = true;    //disable this block after one iteration
@@ -896,7 +905,7 @@ int StateMachine::runNeutralStateMachine() {
             //pitch angle and pitch rate within small tolerance
             //benchtop tests confirm angle needs to be around 2 degrees
             if ((fabs(pitchLoop().getPosition()) < 2.0) and (fabs(pitchLoop().getVelocity()) < 5.0)) { 
-                serialPrint("Debug: Found Level (NEUTRAL_CHECK_PITCH or NEUTRAL_FIRST_PITCH)\r\n");    //debug
+                TRACE(TRACE_STATE, TRACE_INFO, "Debug: Found Level (NEUTRAL_CHECK_PITCH or NEUTRAL_FIRST_PITCH)\r\n");    //debug
                 // found level, but don't need to save anything this time
                 
                 if (depthLoop().getPosition() > _max_recorded_depth_neutral) {  //debug
@@ -918,14 +927,14 @@ int StateMachine::runNeutralStateMachine() {
                     configFileIO().savePitchData(_pitch_KP, _pitch_KI, _pitch_KD, _neutral_batt_pos_mm, _pitch_filter_freq, _pitch_deadband); //P,I,D,batt zeroOffset
                     configFileIO().saveDepthData(_depth_KP, _depth_KI, _depth_KD, _neutral_bce_pos_mm, _depth_filter_freq, _depth_deadband); //P,I,D, bce zeroOffset
 
-                    serialPrint("\r\n\n>>> Saving Positions: BCE: %0.1f mm, BATT: %0.1f <<<\r\n\n",_neutral_bce_pos_mm,_neutral_batt_pos_mm);
+                    TRACE(TRACE_STATE, TRACE_INFO, "\r\n\n>>> Saving Positions: BCE: %0.1f mm, BATT: %0.1f <<<\r\n\n",_neutral_bce_pos_mm,_neutral_batt_pos_mm);
                     
                     _substate = NEUTRAL_EXIT;
                     _isSubStateTimerRunning = false; // reset the sub state timer to do one-shot actions again
                 }
                 
                 else {
-                    serialPrint("\r\nDid not find NEUTRAL_CHECK_PITCH or NEUTRAL_FIRST_PITCH, how did I get here?!\r\n");
+                    TRACE(TRACE_STATE, TRACE_INFO, "\r\nDid not find NEUTRAL_CHECK_PITCH or NEUTRAL_FIRST_PITCH, how did I get here?!\r\n");
                     _substate = NEUTRAL_EXIT;
                 }
             }
@@ -933,8 +942,8 @@ int StateMachine::runNeutralStateMachine() {
             // what is active?
             //once timer complete, reset the timeout so the state one-shot entry will move the setpoint
             if (_fsm_timer.read() >= _neutral_timer) {
-                serialPrint("\r\n\nlevel timer COMPLETE!");
-                serialPrint("\r\n\n (BATT POS: %0.1f) moving 1 mm [timer: %0.1f]\r\n", batt().getPosition_mm(), _fsm_timer.read());
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\n\nlevel timer COMPLETE!");
+                TRACE(TRACE_STATE, TRACE_INFO, "\r\n\n (BATT POS: %0.1f) moving 1 mm [timer: %0.1f]\r\n", batt().getPosition_mm(), _fsm_timer.read());
                 _isSubStateTimerRunning = false; // reset the sub state timer to do one-shot actions again
             }
 
@@ -942,11 +951,11 @@ int StateMachine::runNeutralStateMachine() {
              
         //this state could be removed, it is only used as a transition but is needed to stop entering this function
         case NEUTRAL_EXIT :
-            serialPrint("substate: NEUTRAL_EXIT\r\n");            
+            TRACE(TRACE_STATE, TRACE_INFO, "substate: NEUTRAL_EXIT\r\n");            
             break;
             
         default :
-            serialPrint("how did we get to substate: default?\r\n"); //debug
+            TRACE(TRACE_STATE, TRACE_INFO, "how did we get to substate: default?\r\n"); //debug
             //a default within the sub-state machine
             _substate = NEUTRAL_EXIT;            
             break;
@@ -954,7 +963,7 @@ int StateMachine::runNeutralStateMachine() {
     
     // reset the sub-FSM if needed (useful if you need to redo the neutral-finding sequence)
     if (_substate == NEUTRAL_EXIT) {
-        serialPrint("********************************  EXITING sub-FSM! *******************************\r\n\n");
+        TRACE(TRACE_STATE, TRACE_INFO, "********************************  EXITING sub-FSM! *******************************\r\n\n");
 
         //reset internal sub-state back to first entry conditions (first state is immediately sinking)
         _substate = NEUTRAL_SINKING;
@@ -991,7 +1000,8 @@ int StateMachine::runNeutralStateMachine() {
 // NEW KEYBOARD FUNCTION 12/20/2018
 void StateMachine::keyboard() {   
     if (_state == SIT_IDLE || _state == KEYBOARD) {
-        if (xbee().readable()) {
+        //the XBee bytes are transfer packets during a log download or sequence upload, the USB keyboard still works
+        if (xbee().readable() and !mbedLogger().isTransferRunning()) {
             keyboardInput(xbee().getc());
         }
         
@@ -1025,12 +1035,17 @@ void StateMachine::keyboardInput(char user_input) {
     else if (user_input == 'U') {
         serialPrint("(U) TRANSMIT MULTIPLE PACKETS \n\r");
                     
-        mbedLogger().transmitMultiplePackets();
+        mbedLogger().startLogTransmit();    //the main loop runs the download
+    }
+    
+    else if (user_input == 'K') {
+        diveStatistics().printSummary();
+        diveStatistics().transmitSummaryPacket();  //0x75 0x73 summary packet for the PC (DiveStatistics.cpp)
     }
     
     else if (user_input == 'I') {
         serialPrint("(I) Receive Multi-Dive Sequence! \n\r");
-        mbedLogger().receiveSequenceFile();    //receive sequence.txt files
+        mbedLogger().startSequenceReceive();    //receive sequence.txt files (the main loop runs the upload)
     }
     
     else if (user_input == '8') {
@@ -1164,6 +1179,27 @@ void StateMachine::keyboardInput(char user_input) {
         else if (user_input == 'X') {
             mbedLogger().printMbedDirectory();        //print all log files to the screen
         }
+        else if (user_input == 'L') {
+            mbedLogger().printLogBufferStats();       //log buffer overflow/drop counters and write times
+        }
+        else if (user_input == 'O') {
+            //10 Hz status line on the XBee: off -> text -> binary records (no text on the USB port either) -> off
+            int xbee_categories = trace().getPortCategories(TRACE_PORT_XBEE);
+            
+            if (!(xbee_categories & TRACE_STATUS)) {
+                trace().setPortCategories(TRACE_PORT_XBEE, xbee_categories | TRACE_STATUS);
+                trace().setBinaryCategories(trace().getBinaryCategories() & ~TRACE_STATUS);
+            }
+            else if (!(trace().getBinaryCategories() & TRACE_STATUS)) {
+                trace().setBinaryCategories(trace().getBinaryCategories() | TRACE_STATUS);
+            }
+            else {
+                trace().setPortCategories(TRACE_PORT_XBEE, xbee_categories & ~TRACE_STATUS);
+                trace().setBinaryCategories(trace().getBinaryCategories() & ~TRACE_STATUS);
+            }
+            
+            trace().printStatus();
+        }
         else if (user_input == 'Z') {
             serialPrint("FSG FSM States: \r\n");
             string string_state;
@@ -1526,10 +1562,15 @@ void StateMachine::keyboard_menu_MANUAL_TUNING() {
     rudder().unpause();     //this is now active
     
     // TURN ON FILE SAVING
+    mbedLogger().startNewLogSegment();              //manual tuning gets its own log segment
     mbedLogger().appendLogFile(MANUAL_TUNING, 1);   //open file (logic in the MbedLogger method itself)
     
     while (1) {
         wait(0.1);
+        
+        //the main loop isn't running in this menu, so write the buffered log records here
+        mbedLogger().drainLogBuffer();
+        mbedLogger().serviceLogSinks();
                       
         if (xbee().readable()) {
             TUNING_key = xbee().getc();     //get each keystroke from the XBee connection
@@ -2184,14 +2225,14 @@ void StateMachine::logFileMenu() {
     char FILE_MENU_key;
     
     // print the menu
-    serialPrint("\n\r>>> LOG FILE MENU. Y = Yes, erase file (and exit).  N = No, keep file (and exit).  P = Print file size. T = Tare depth sensor.<<<\n\r");
+    serialPrint("\n\r>>> LOG FILE MENU. Y = Yes, erase ALL log segments (and exit).  N = No, keep files (and exit).  P = Print segments and file size. S = Select segment to print/transmit. T = Tare depth sensor. F = CSV/binary log format. R = 10 Hz binary logging on/off. D = Binary delta encoding on/off. H = Log/GUI field list. B = Black box trigger/status. M = Black box trigger mask. L = Log sinks (SD card/radio/RAM) on/off. W = Print RAM log.<<<\n\r");
     
     // handle the key presses
     // NOTE TO SELF, is there a way to read both serial ports at once?? 02/13/19
     while(1) {
         // get the user's keystroke from either of the two inputs
         if (xbee().readable()) {
-            serialPrint("\n\r>>> LOG FILE MENU. Y = Yes, erase file (and exit).  N = No, keep file (and exit).  P = Print file size. T = Tare depth sensor.<<<\n\r");
+            serialPrint("\n\r>>> LOG FILE MENU. Y = Yes, erase ALL log segments (and exit).  N = No, keep files (and exit).  P = Print segments and file size. S = Select segment to print/transmit. T = Tare depth sensor. F = CSV/binary log format. R = 10 Hz binary logging on/off. D = Binary delta encoding on/off. H = Log/GUI field list. B = Black box trigger/status. M = Black box trigger mask. L = Log sinks (SD card/radio/RAM) on/off. W = Print RAM log.<<<\n\r");
             FILE_MENU_key = xbee().getc();
         }
         else {
@@ -2200,12 +2241,66 @@ void StateMachine::logFileMenu() {
     
         // handle the user's key input
         if (FILE_MENU_key == 'P') { // user wants to save these modified values
-            serialPrint("\n\r>> Printing log file size!\n\r");
+            serialPrint("\n\r>> Printing log segments and file size!\n\r");
             wait(2);
-            mbedLogger().getFileSize("/local/LOG000.csv");
+            mbedLogger().printSegmentIndex();
+            mbedLogger().getFileSize(mbedLogger().getTransmitFileName());
+        }
+        else if (FILE_MENU_key == 'S') {
+            serialPrint("\n\r>> Please enter the log segment number to print/transmit (current: %d, recording: %d).\r\n", mbedLogger().getTransmitSegment(), mbedLogger().getCurrentSegment());
+            mbedLogger().setTransmitSegment((int)getFloatUserInput());
+            serialPrint("\n\r>> Transmit segment is %s\n\r", mbedLogger().getTransmitFileName().c_str());
+            mbedLogger().isTransmitSegmentBinary();     //says so if it can't be printed or transmitted
+        }
+        else if (FILE_MENU_key == 'F') {
+            //binary records are decoded on the PC with FSG_binary_log_to_csv.py
+            if (mbedLogger().getLogFormat() == LOG_FORMAT_CSV) {
+                mbedLogger().setLogFormat(LOG_FORMAT_BINARY);
+                serialPrint("\n\r>> Log format is BINARY (%s)\n\r", mbedLogger().getLogFileName().c_str());
+            }
+            else {
+                mbedLogger().setLogFormat(LOG_FORMAT_CSV);
+                serialPrint("\n\r>> Log format is CSV (%s)\n\r", mbedLogger().getLogFileName().c_str());
+            }
+        }
+        else if (FILE_MENU_key == 'R') {
+            //fast fields every FSM tick (binary log only, the CSV log stays at 1 Hz)
+            mbedLogger().setFastLogging(!mbedLogger().getFastLogging());
+            serialPrint("\n\r>> 10 Hz binary logging is %s\n\r", mbedLogger().getFastLogging() ? "ON" : "OFF");
+        }
+        else if (FILE_MENU_key == 'D') {
+            //varint deltas between keyframes (binary log only), starts a new segment
+            mbedLogger().setDeltaEncoding(!mbedLogger().getDeltaEncoding());
+            serialPrint("\n\r>> Binary delta encoding is %s\n\r", mbedLogger().getDeltaEncoding() ? "ON" : "OFF");
+        }
+        else if (FILE_MENU_key == 'H') {
+            printTelemetryFields();     //column names, units and decimals
+        }
+        else if (FILE_MENU_key == 'B') {
+            blackBox().trigger(BLACK_BOX_TRIGGER_MANUAL);      //written to BBOX###.BIN after the menu exits
+            blackBox().printStatus();
+        }
+        else if (FILE_MENU_key == 'M') {
+            serialPrint("\n\r>> Please enter the black box trigger mask (1 emergency climb, 2 limit switch, 4 manual, 7 all, current: %d).\r\n", blackBox().getTriggerMask());
+            blackBox().setTriggerMask((int)getFloatUserInput());
+            blackBox().printStatus();
+        }
+        else if (FILE_MENU_key == 'L') {
+            //SD card/radio/RAM copies of the log, they start with the next segment
+            mbedLogger().printLogSinkStatus();
+            serialPrint("\n\r>> Please enter the log sink number to turn on/off (0 = none).\r\n");
+            
+            LogSink * sink = mbedLogger().getLogSink((int)getFloatUserInput());
+            if (sink) {
+                sink->setEnabled(!sink->getEnabled());
+                serialPrint("\n\r>> %s log sink is %s\n\r", sink->getName(), sink->getEnabled() ? "ON" : "OFF");
+            }
+        }
+        else if (FILE_MENU_key == 'W') {
+            ramLogSink().print();       //newest log lines (still there if the file systems aren't)
         }
         else if (FILE_MENU_key == 'Y') {
-            serialPrint("\n\r>> Erasing MBED LOG FILE!\n\r");
+            serialPrint("\n\r>> Erasing ALL MBED LOG SEGMENTS!\n\r");
             wait(2);
             mbedLogger().eraseFile();
             break;
@@ -18,6 +18,11 @@ Timer & systemTime() {
     return s;
 }
 
+SystemClock & systemClock() {
+    static SystemClock s;
+    return s;
+}
+
 // need to remove the pulse, not used
 Ticker & pulse() {
     static Ticker pulse;
@@ -35,15 +40,20 @@ MODSERIAL & xbee() {
     return xb;
 }
 
+Trace & trace() {
+    static Trace trace;
+    return trace;
+}
+
 LocalFileSystem & local() {
     static LocalFileSystem local("local");
     return local;    
 } 
 
-//SDFileSystem & sd_card() {
-//    static SDFileSystem sd_card(p11, p12, p13, p14, "sd");     //SDFileSystem sd_card(MOSI, MISO, SCK, CS, "sd");
-//    return sd_card;
-//}
+SDFileSystem & sd_card() {
+    static SDFileSystem sd_card(p11, p12, p13, p14, "sd");     //SDFileSystem sd_card(MOSI, MISO, SCK, CS, "sd");
+    return sd_card;
+}
 
 SpiADC & adc() {
     static SpiADC adc(p5,p6,p7,p8,LED2);
@@ -111,14 +121,41 @@ Sensors & sensors() {
     return sensors;
 }
 
+DiveStatistics & diveStatistics() {
+    static DiveStatistics diveStatistics;
+    return diveStatistics;
+}
+
 MbedLogger & mbedLogger() {
     static MbedLogger mbedLogger("/local/");        //local file system
     return mbedLogger;
 }
 
-MbedLogger & sdLogger() {
-    static MbedLogger sdLogger("/sd/");
-    return sdLogger;
+// log sink queues go in the second AHB SRAM bank (16 KB, mbed only uses it for Ethernet buffers)
+static char sd_log_sink_queue[8192] __attribute__((section("AHBSRAM1")));
+static char radio_log_sink_queue[2048] __attribute__((section("AHBSRAM1")));
+static char ram_log_sink_queue[4096] __attribute__((section("AHBSRAM1")));
+static char sd_log_sector_buffer[SD_LOG_WRITE_BYTES] __attribute__((section("AHBSRAM1")));
+
+SdLogSink & sdLogSink() {
+    sd_card();      //the file system (FatFs drive 0) has to exist before the first file is opened
+    static SdLogSink sdLogSink("SD", sd_log_sink_queue, sizeof(sd_log_sink_queue), sd_log_sector_buffer);
+    return sdLogSink;
+}
+
+RadioLogSink & radioLogSink() {
+    static RadioLogSink radioLogSink("RADIO", radio_log_sink_queue, sizeof(radio_log_sink_queue));
+    return radioLogSink;
+}
+
+RamLogSink & ramLogSink() {
+    static RamLogSink ramLogSink("RAM", ram_log_sink_queue, sizeof(ram_log_sink_queue));
+    return ramLogSink;
+}
+
+BlackBox & blackBox() {
+    static BlackBox blackBox("/local/");
+    return blackBox;
 }
 
 DigitalOut & led1() {
@@ -18,15 +18,22 @@
 #include "ServoDriver.hpp"
 #include "Gui.hpp"
 #include "Sensors.hpp"
+#include "SystemClock.hpp"
+#include "TelemetryFields.hpp"
+#include "DiveStatistics.hpp"
+#include "BlackBox.hpp"
+#include "Trace.hpp"
 
 //Declare static global variables using 'construct on use' idiom to ensure they are always constructed correctly
 // and avoid "static initialization order fiasco".
 
 Timer                       &   systemTime();
+SystemClock                 &   systemClock();      //64 bit microsecond time stamps
 Ticker                      &   pulse();
 
 MODSERIAL                   &   pc();
 MODSERIAL                   &   xbee();
+Trace                       &   trace();            //serialPrint/TRACE output to pc() and xbee()
 
 LocalFileSystem             &   local();
 
@@ -44,11 +51,17 @@ StateMachine                &   stateMachine();
 
 MbedLogger                  &   mbedLogger();       //internal memory log files
 
-//SDFileSystem                &   sd_card();          //SD card file system
+SDFileSystem                &   sd_card();          //SD card file system
 
 Sensors                     &   sensors();
 
-MbedLogger                  &   sdLogger();         //sd log files
+DiveStatistics              &   diveStatistics();   //per-dive summary (go/no-go)
+
+SdLogSink                   &   sdLogSink();        //copy of the log segments on the SD card
+RadioLogSink                &   radioLogSink();     //live log over the XBee
+RamLogSink                  &   ramLogSink();       //newest log bytes in RAM
+
+BlackBox                    &   blackBox();         //100 Hz pre-trigger capture (BBOX###.BIN)
 
 ConfigFileIO                &   configFileIO();
 
@@ -0,0 +1,48 @@
+/*******************************************************************************
+Title:            SystemClock.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+64 bit microsecond clock for time stamping log records.
+
+The mbed us_ticker (a free-running hardware timer at 1 MHz) is only 32 bits and
+rolls over every 71.6 minutes.  Each reading is compared to the last one and a
+rollover bumps the high word, so the result keeps counting up for the whole
+mission.  update() is called from the system ticker so a rollover is never
+missed even if nothing else reads the clock for a while.
+
+Safe to call from the main loop and from interrupts (the read and the high
+word update are done with interrupts masked, a few instructions).
+
+*******************************************************************************/
+
+#include "SystemClock.hpp"
+#include "us_ticker_api.h"
+
+SystemClock::SystemClock() {
+    _last_ticker_us = us_ticker_read();
+    _high_word = 0;
+}
+
+uint64_t SystemClock::read_us() {
+    uint32_t primask = __get_PRIMASK();     //could already be in an interrupt or critical section
+    __disable_irq();
+    
+    uint32_t ticker_us = us_ticker_read();
+    
+    if (ticker_us < _last_ticker_us)
+        _high_word++;                       //32 bit counter rolled over since the last reading
+    
+    _last_ticker_us = ticker_us;
+    uint32_t high_word = _high_word;
+    
+    if (!primask)
+        __enable_irq();
+    
+    return ((uint64_t)high_word << 32) | ticker_us;
+}
+
+void SystemClock::update() {
+    read_us();
+}
@@ -0,0 +1,18 @@
+#ifndef SYSTEMCLOCK_HPP
+#define SYSTEMCLOCK_HPP
+
+#include "mbed.h"
+
+class SystemClock {
+public:
+    SystemClock();
+    
+    uint64_t read_us();         //microseconds since power up, never rolls over
+    void update();              //must run at least once every 71 minutes (system ticker runs it every second)
+    
+private:
+    uint32_t _last_ticker_us;   //last 32 bit hardware reading
+    uint32_t _high_word;        //number of 32 bit rollovers
+};
+
+#endif
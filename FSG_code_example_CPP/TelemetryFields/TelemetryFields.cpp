@@ -0,0 +1,142 @@
+/*******************************************************************************
+Title:            TelemetryFields.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+The one list of the values that are logged and sent to the GUI.
+
+MbedLogger builds the CSV heading from telemetry_log_fields once, samples the
+values with the getters, and formats/scales them with the decimals (CSV lines
+and binary records).  Gui::updateGUI builds its packet from telemetry_gui_fields.
+
+The tables are const, so they stay in flash.  The getters are small functions
+because the objects are only reachable through the StaticDefs accessors.
+
+*******************************************************************************/
+
+#include "TelemetryFields.hpp"
+#include "StaticDefs.hpp"
+
+static float getDepthCommand()      { return depthLoop().getCommand(); }
+static float getDepthPosition()     { return depthLoop().getPosition(); }      //filtered depth
+static float getPitchCommand()      { return pitchLoop().getCommand(); }
+static float getPitchPosition()     { return pitchLoop().getPosition(); }      //filtered pitch
+static float getRudderPWM()         { return rudder().getSetPosition_pwm(); }
+static float getRudderDeg()         { return rudder().getSetPosition_deg(); }
+static float getHeadingPosition()   { return headingLoop().getPosition(); }    //filtered heading
+
+static float getBceCommand()        { return bce().getSetPosition_mm(); }
+static float getBcePosition()       { return bce().getPosition_mm(); }
+static float getBattCommand()       { return batt().getSetPosition_mm(); }
+static float getBattPosition()      { return batt().getPosition_mm(); }
+static float getPitchRate()         { return pitchLoop().getVelocity(); }
+static float getDepthRate()         { return depthLoop().getVelocity(); }
+
+static float getCurrentInput()      { return sensors().getCurrentInput(); }
+static float getVoltageInput()      { return sensors().getVoltageInput(); }
+static float getAltimeter()         { return sensors().getAltimeterChannelReadings(); }
+static float getInternalPSI()       { return sensors().getInternalPressurePSI(); }
+
+static float getBceP()              { return bce().getControllerP(); }
+static float getBceI()              { return bce().getControllerI(); }
+static float getBceD()              { return bce().getControllerD(); }
+static float getBattP()             { return batt().getControllerP(); }
+static float getBattI()             { return batt().getControllerI(); }
+static float getBattD()             { return batt().getControllerD(); }
+static float getDepthP()            { return depthLoop().getControllerP(); }
+static float getDepthI()            { return depthLoop().getControllerI(); }
+static float getDepthD()            { return depthLoop().getControllerD(); }
+static float getPitchP()            { return pitchLoop().getControllerP(); }
+static float getPitchI()            { return pitchLoop().getControllerI(); }
+static float getPitchD()            { return pitchLoop().getControllerD(); }
+static float getHeadingP()          { return headingLoop().getControllerP(); }
+static float getHeadingI()          { return headingLoop().getControllerI(); }
+static float getHeadingD()          { return headingLoop().getControllerD(); }
+
+static float getImuRoll()           { return imu().getRoll(); }
+static float getImuPitch()          { return imu().getPitch(); }
+static float getImuHeading()        { return imu().getHeading(); }
+static float getStateTimer()        { return stateMachine().getTimerValue(); }
+
+const TelemetryField telemetry_log_fields[BINARY_LOG_NUM_FIELDS] = {
+    //name              units       getter              decimals    rate                            range (CSV and binary)
+    {"DepthCmd",        "ft",       getDepthCommand,    1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"DepthFt",         "ft",       getDepthPosition,   1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"PitchCmd",        "deg",      getPitchCommand,    1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"PitchDeg",        "deg",      getPitchPosition,   1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"RudderPWM",       "us",       getRudderPWM,       0,          TELEMETRY_RATE_FAST},       //+/-32767
+    {"RudderCmdDeg",    "deg",      getRudderDeg,       0,          TELEMETRY_RATE_FAST},       //+/-32767
+    {"HeadDeg",         "deg",      getHeadingPosition, 1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    
+    {"bceCmd",          "mm",       getBceCommand,      1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"bce_mm",          "mm",       getBcePosition,     1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"battCmd",         "mm",       getBattCommand,     1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"batt_mm",         "mm",       getBattPosition,    1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"PitchRateDegSec", "deg/s",    getPitchRate,       1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    {"depthrate_fps",   "ft/s",     getDepthRate,       1,          TELEMETRY_RATE_FAST},       //+/-3276.7
+    
+    {"SystemAmps",      "A",        getCurrentInput,    3,          TELEMETRY_RATE_SLOW},       //+/-32.767
+    {"SystemVolts",     "V",        getVoltageInput,    2,          TELEMETRY_RATE_SLOW},       //+/-327.67
+    {"AltChRd",         "counts",   getAltimeter,       0,          TELEMETRY_RATE_SLOW},       //+/-32767
+    {"IntPSI",          "psi",      getInternalPSI,     2,          TELEMETRY_RATE_SLOW},       //+/-327.67
+    
+    {"BCE_p",           "",         getBceP,            3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"BCi",             "",         getBceI,            3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"BCd",             "",         getBceD,            3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"BATT_p",          "",         getBattP,           3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"BTi",             "",         getBattI,           3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"BTd",             "",         getBattD,           3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"DEPTH_p",         "",         getDepthP,          2,          TELEMETRY_RATE_ON_CHANGE},  //+/-327.67
+    {"Di",              "",         getDepthI,          3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"Dd",              "",         getDepthD,          3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"PITCH_p",         "",         getPitchP,          3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"Pi",              "",         getPitchI,          3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"Pd",              "",         getPitchD,          3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"HEAD_p",          "",         getHeadingP,        3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"Hi",              "",         getHeadingI,        3,          TELEMETRY_RATE_ON_CHANGE},  //+/-32.767
+    {"Hd",              "",         getHeadingD,        3,          TELEMETRY_RATE_ON_CHANGE}   //+/-32.767
+};
+
+//ROLL PITCH HEADING(YAW) DEPTH TIMER (raw IMU angles, not the filtered outer loop values)
+const TelemetryField telemetry_gui_fields[TELEMETRY_NUM_GUI_FIELDS] = {
+    {"roll",            "deg",      getImuRoll,         2,          TELEMETRY_RATE_SLOW},
+    {"pitch",           "deg",      getImuPitch,        2,          TELEMETRY_RATE_SLOW},
+    {"heading",         "deg",      getImuHeading,      2,          TELEMETRY_RATE_SLOW},
+    {"depth",           "ft",       getDepthPosition,   2,          TELEMETRY_RATE_SLOW},
+    {"timer",           "s",        getStateTimer,      2,          TELEMETRY_RATE_SLOW}
+};
+
+static const double powers_of_ten[4] = {1.0, 10.0, 100.0, 1000.0};
+
+static const char * const telemetry_rate_strings[] = {"10 Hz", "1 Hz", "on change"};
+static const char * const telemetry_range_strings[] = {"32767", "3276.7", "327.67", "32.767"};   //32767 / 10^decimals
+
+void printTelemetryFields() {
+    serialPrint("\n\rLOG FIELDS (after StateStr,St#,TimeSec), binary log rate\n\r");
+    for (int i = 0; i < BINARY_LOG_NUM_FIELDS; i++) {
+        serialPrint("%2d %-16s %-7s %d decimals  +/-%-9s %s\n\r", i, telemetry_log_fields[i].name, telemetry_log_fields[i].units, telemetry_log_fields[i].decimals, telemetry_range_strings[telemetry_log_fields[i].decimals], telemetry_rate_strings[telemetry_log_fields[i].rate]);
+    }
+    
+    serialPrint("\n\rGUI PACKET FIELDS\n\r");
+    for (int i = 0; i < TELEMETRY_NUM_GUI_FIELDS; i++) {
+        serialPrint("%2d %-16s %-7s\n\r", i, telemetry_gui_fields[i].name, telemetry_gui_fields[i].units);
+    }
+}
+
+// scale and round (like printf) a float into an int16 (double here because float rounding was off by one
+// in the last digit on some values)
+int16_t scaleToInt16(float value, int decimals) {
+    if (value != value)         //NaN
+        return -32768;
+    
+    double scaled = value * powers_of_ten[decimals];
+    scaled += (scaled < 0.0) ? -0.5 : 0.5;
+    
+    if (scaled > 32767.0)
+        return 32767;
+    if (scaled < -32767.0)
+        return -32767;
+    
+    return (int16_t)scaled;
+}
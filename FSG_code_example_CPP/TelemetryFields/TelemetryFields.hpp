@@ -0,0 +1,41 @@
+#ifndef TELEMETRYFIELDS_HPP
+#define TELEMETRYFIELDS_HPP
+
+#include "mbed.h"
+#include "LogRecord.hpp"        //BINARY_LOG_NUM_FIELDS
+
+#define TELEMETRY_NUM_GUI_FIELDS    5       //floats in the GUI update packet
+
+typedef float (*TelemetryGetter)();
+
+//how often a field goes into the binary log (the CSV line always has every field at 1 Hz)
+enum {
+    TELEMETRY_RATE_FAST,        // every FSM tick (10 Hz) while recording: depth, pitch, heading, actuators, rates
+    TELEMETRY_RATE_SLOW,        // every log_function call (1 Hz): power and housekeeping
+    TELEMETRY_RATE_ON_CHANGE    // only when the value changes (and in the first record of a segment): gains, settings
+};
+
+//one telemetry value: where it comes from and how it is printed/stored
+struct TelemetryField {
+    const char * name;          // CSV column heading
+    const char * units;         // "" for gains and other unitless values
+    TelemetryGetter getter;     // reads the current value
+    uint8_t decimals;           // CSV decimal places, the binary log stores round(value * 10^decimals) (0 to 3)
+    uint8_t rate;               // TELEMETRY_RATE_FAST, _SLOW or _ON_CHANGE (binary log)
+};
+
+//log columns in order (_data_log, CSV columns after StateStr,St#,TimeSec and the binary record fields)
+//CSV and binary are both printed from round(value * 10^decimals) in an int16, so a field only logs +/-32767 / 10^decimals
+//(range column in the table), a value past it is logged at the limit and counted (log buffer stats)
+//adding a column: add a line here and bump BINARY_LOG_NUM_FIELDS (and the Python decoder heading)
+extern const TelemetryField telemetry_log_fields[BINARY_LOG_NUM_FIELDS];
+
+//GUI update packet floats in order
+extern const TelemetryField telemetry_gui_fields[TELEMETRY_NUM_GUI_FIELDS];
+
+void printTelemetryFields();    //list the log and GUI fields with units (log file menu)
+
+//round(value * 10^decimals) saturated at +/-32767, NaN is -32768 (binary log, black box, trace records, dive summary)
+int16_t scaleToInt16(float value, int decimals);
+
+#endif
@@ -0,0 +1,301 @@
+/*******************************************************************************
+Title:            Trace.cpp
+Date:             10/17/2026
+
+Description/Notes:
+
+Diagnostic output to the USB serial port and the XBee.  This replaces the
+serialPrint macro every file had its own copy of, which printed each message
+twice (one printf for pc(), one for xbee()).
+
+A message has a category (console, state, status, log) and a level (error to
+debug).  The TRACE macro checks both against TRACE_COMPILED_CATEGORIES and
+TRACE_COMPILED_LEVEL first, so a build without a category has none of its
+format strings or calls.  At run time the message is formatted once into
+_buffer and written to every port that has its category turned on, at or
+below the level set.
+
+By default the XBee doesn't get the 10 Hz status line (about 250 characters a
+tick, more than the radio link can carry during a dive), the USB port gets
+everything.  Debug menu 'O' changes that.
+
+A message longer than _buffer (the log file menu, the tuning printouts) is
+formatted again into a heap buffer of its own length, so nothing is cut off
+unless the heap is out.
+
+The messages in TraceFormats.hpp (the status lines) are printed with TRACE_ID
+and a format ID instead of the format string.  A port gets them as text like
+any other message, except for the categories in setBinaryCategories(): the
+XBee gets a binary record with the ID, the time and the raw arguments (floats
+mostly as int16 tenths), about 30 bytes instead of 250, and no port gets the
+text, so there is no float printf at all (about 0.1 us instead of 4.5 us a
+status line on a host build, the M3's soft float printf saves more).
+The records wait in a ring buffer and service() moves whole records into the
+XBee transmit buffer from the main loop.  FSG_trace_decoder.py turns them back
+into the text using the same TraceFormats.hpp.
+
+Not for interrupts, the buffer is shared.
+
+*******************************************************************************/
+
+#include "Trace.hpp"
+#include "StaticDefs.hpp"
+#include <stdarg.h>
+#include <stdlib.h>     //malloc for the long messages
+
+// TraceFormats.hpp table, indexed by format ID
+struct TraceFormat {
+    const char * types;
+    const char * format;
+};
+
+static const TraceFormat trace_formats[TRACE_NUM_FORMATS] = {
+#define TRACE_FORMAT_ENTRY(id, types, format) {types, format},
+    TRACE_FORMAT_LIST(TRACE_FORMAT_ENTRY)
+#undef TRACE_FORMAT_ENTRY
+};
+
+Trace::Trace() {
+    _level = TRACE_DEBUG;
+    _port_categories[TRACE_PORT_PC] = TRACE_ALL;
+    _port_categories[TRACE_PORT_XBEE] = TRACE_ALL & ~TRACE_STATUS;
+    _message_count = 0;
+    _truncated_count = 0;
+    
+    _binary_categories = 0;
+    _ring_head = 0;
+    _ring_tail = 0;
+    _binary_record_count = 0;
+    _binary_drop_count = 0;
+}
+
+void Trace::print(int category, int level, const char * fmt, ...) {
+    if (level > _level)
+        return;
+    
+    int ports = 0;
+    
+    for (int port = 0; port < TRACE_NUM_PORTS; port++) {
+        if (_port_categories[port] & category)
+            ports |= (1 << port);
+    }
+    
+    if (!ports)
+        return;
+    
+    va_list args;
+    va_start(args, fmt);
+    int length = printText(ports, fmt, args);
+    va_end(args);
+    
+    //didn't fit, format it again (the arguments are read again from the start)
+    if (length >= TRACE_BUFFER_BYTES) {
+        va_start(args, fmt);
+        printLongText(ports, length, fmt, args);
+        va_end(args);
+    }
+}
+
+void Trace::printId(int category, int level, int format_id, ...) {
+    if (level > _level or format_id < 0 or format_id >= TRACE_NUM_FORMATS)
+        return;
+    
+    int ports = 0;
+    
+    for (int port = 0; port < TRACE_NUM_PORTS; port++) {
+        if (_port_categories[port] & category)
+            ports |= (1 << port);
+    }
+    
+    va_list args;
+    
+    //binary record on the XBee and no text anywhere (the float printf is what binary mode saves)
+    if ((ports & (1 << TRACE_PORT_XBEE)) and (_binary_categories & category)) {
+        ports = 0;
+        
+        uint8_t record[TRACE_BINARY_MAX_RECORD];
+        
+        va_start(args, format_id);
+        int length = encodeRecord(record, format_id, args);
+        va_end(args);
+        
+        if (length > 0 and pushRecord(record, length))
+            _binary_record_count++;
+        else
+            _binary_drop_count++;
+    }
+    
+    if (ports) {
+        va_start(args, format_id);
+        int length = printText(ports, trace_formats[format_id].format, args);
+        va_end(args);
+        
+        if (length >= TRACE_BUFFER_BYTES) {
+            va_start(args, format_id);
+            printLongText(ports, length, trace_formats[format_id].format, args);
+            va_end(args);
+        }
+    }
+}
+
+// Format once into _buffer and write it to each port in the ports bit mask.  Returns the length,
+// nothing is written if it is TRACE_BUFFER_BYTES or more (call printLongText with fresh arguments).
+int Trace::printText(int ports, const char * fmt, va_list args) {
+    int length = vsnprintf(_buffer, TRACE_BUFFER_BYTES, fmt, args);
+    
+    if (length < 0 or length >= TRACE_BUFFER_BYTES)
+        return length;
+    
+    _message_count++;
+    writePorts(ports, _buffer, length);
+    
+    return length;
+}
+
+// message that didn't fit in _buffer (length from printText), cut short to what is in _buffer only if the heap is out
+void Trace::printLongText(int ports, int length, const char * fmt, va_list args) {
+    char * text = (char *)malloc(length + 1);
+    
+    _message_count++;
+    
+    if (!text) {
+        _truncated_count++;
+        writePorts(ports, _buffer, TRACE_BUFFER_BYTES - 1);
+        return;
+    }
+    
+    vsnprintf(text, length + 1, fmt, args);
+    writePorts(ports, text, length);
+    
+    free(text);
+}
+
+void Trace::writePorts(int ports, const char * text, int length) {
+    //one block copy into each TX buffer (puts goes a character at a time)
+    if (ports & (1 << TRACE_PORT_PC))
+        pc().write((const uint8_t *)text, length);
+    
+    if (ports & (1 << TRACE_PORT_XBEE))
+        xbee().write((const uint8_t *)text, length);
+}
+
+// binary record for a TraceFormats.hpp message, returns the length (0 if the types are bad)
+int Trace::encodeRecord(uint8_t * record, int format_id, va_list args) {
+    const char * types = trace_formats[format_id].types;
+    uint32_t time_us = (uint32_t)systemClock().read_us();
+    int length = TRACE_BINARY_HEADER;
+    
+    for (int i = 0; types[i]; i++) {
+        if (i >= TRACE_BINARY_MAX_ARGS)
+            return 0;
+        
+        if (types[i] == 'f') {
+            float value = (float)va_arg(args, double);
+            memcpy(record + length, &value, 4);
+            length += 4;
+        }
+        else if (types[i] == 'd') {
+            int32_t value = va_arg(args, int);
+            memcpy(record + length, &value, 4);
+            length += 4;
+        }
+        else if (types[i] == 't' or types[i] == 'c') {
+            int16_t value = scaleToInt16(va_arg(args, double), (types[i] == 't') ? 1 : 2);
+            memcpy(record + length, &value, 2);
+            length += 2;
+        }
+        else {
+            return 0;
+        }
+    }
+    
+    record[0] = TRACE_BINARY_SYNC;
+    record[1] = format_id;
+    record[2] = length - TRACE_BINARY_HEADER;
+    memcpy(record + 3, &time_us, 4);
+    
+    uint8_t checksum = 0;
+    for (int i = 0; i < length; i++)
+        checksum ^= record[i];
+    
+    record[length++] = checksum;
+    
+    return length;
+}
+
+// whole record or nothing
+bool Trace::pushRecord(const uint8_t * record, int length) {
+    unsigned int head = _ring_head;
+    
+    if (TRACE_RING_BYTES - (head - _ring_tail) < (unsigned int)length)
+        return false;
+    
+    for (int i = 0; i < length; i++)
+        _ring[(head + i) & (TRACE_RING_BYTES - 1)] = record[i];
+    
+    _ring_head = head + length;     //after the bytes, service() only reads up to here
+    
+    return true;
+}
+
+// whole records into the XBee transmit buffer while they fit (leaves room for text messages)
+void Trace::service() {
+    unsigned int tail = _ring_tail;
+    
+    while (tail != _ring_head) {
+        int length = TRACE_BINARY_HEADER + _ring[(tail + 2) & (TRACE_RING_BYTES - 1)] + 1;
+        int room = xbee().txBufferGetSize(0) - xbee().txBufferGetCount() - TRACE_PORT_RESERVE;
+        
+        if (length > room)
+            break;
+        
+        //a record can wrap around the end of the ring, then it goes in two writes
+        int start = tail & (TRACE_RING_BYTES - 1);
+        int first = TRACE_RING_BYTES - start;
+        
+        if (first > length)
+            first = length;
+        
+        xbee().write(_ring + start, first);
+        if (first < length)
+            xbee().write(_ring, length - first);
+        
+        tail += length;
+        _ring_tail = tail;
+    }
+}
+
+void Trace::setLevel(int level) {
+    _level = level;
+}
+
+int Trace::getLevel() {
+    return _level;
+}
+
+void Trace::setPortCategories(int port, int categories) {
+    if (port >= 0 and port < TRACE_NUM_PORTS)
+        _port_categories[port] = categories;
+}
+
+int Trace::getPortCategories(int port) {
+    if (port >= 0 and port < TRACE_NUM_PORTS)
+        return _port_categories[port];
+    
+    return 0;
+}
+
+void Trace::setBinaryCategories(int categories) {
+    _binary_categories = categories;
+}
+
+int Trace::getBinaryCategories() {
+    return _binary_categories;
+}
+
+void Trace::printStatus() {
+    serialPrint("Trace: level %d (compiled %d), categories USB 0x%02X, XBee 0x%02X (compiled 0x%02X), %u messages, %u cut short (no heap)\r\n",
+                _level, TRACE_COMPILED_LEVEL, _port_categories[TRACE_PORT_PC], _port_categories[TRACE_PORT_XBEE], TRACE_COMPILED_CATEGORIES, _message_count, _truncated_count);
+    serialPrint("  XBee binary categories 0x%02X: %u records sent, %u dropped, %u bytes waiting\r\n",
+                _binary_categories, _binary_record_count, _binary_drop_count, _ring_head - _ring_tail);
+}
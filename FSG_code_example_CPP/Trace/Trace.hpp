@@ -0,0 +1,92 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "mbed.h"
+#include <stdarg.h>
+#include "TraceFormats.hpp"
+
+//levels, a message is printed if its level is at or below the level set
+#define TRACE_ERROR     0
+#define TRACE_WARN      1
+#define TRACE_INFO      2
+#define TRACE_DEBUG     3
+
+//categories (bit mask)
+#define TRACE_CONSOLE   0x01        //menus, replies to the keyboard, startup messages (serialPrint)
+#define TRACE_STATE     0x02        //state machine transitions, set points and time outs
+#define TRACE_STATUS    0x04        //status line printed every FSM tick (10 Hz)
+#define TRACE_LOG       0x08        //log file, log sinks, black box
+#define TRACE_ALL       0xFF
+
+//ports
+#define TRACE_PORT_PC   0
+#define TRACE_PORT_XBEE 1
+#define TRACE_NUM_PORTS 2
+
+//categories and level built into the code, a message outside them compiles to nothing
+//(set them in the compiler flags, for example -DTRACE_COMPILED_CATEGORIES=0x0B for a dive build without the status line)
+#ifndef TRACE_COMPILED_CATEGORIES
+#define TRACE_COMPILED_CATEGORIES   TRACE_ALL
+#endif
+
+#ifndef TRACE_COMPILED_LEVEL
+#define TRACE_COMPILED_LEVEL        TRACE_DEBUG
+#endif
+
+#define TRACE_BUFFER_BYTES  384     //messages up to this long are formatted here (the status lines are about 250 characters), longer ones on the heap
+
+//binary trace record: sync, format ID, argument bytes, time (us, low 32 bits of systemClock), arguments, checksum (XOR of the bytes before it)
+#define TRACE_BINARY_SYNC       0xB5        //not ASCII, the decoder finds records between text messages
+#define TRACE_BINARY_HEADER     7
+#define TRACE_BINARY_MAX_ARGS   16
+#define TRACE_BINARY_MAX_RECORD (TRACE_BINARY_HEADER + 4 * TRACE_BINARY_MAX_ARGS + 1)
+#define TRACE_RING_BYTES        512         //binary records waiting for the port (power of two)
+#define TRACE_PORT_RESERVE      64          //tx buffer space left for text messages
+
+//the condition is a constant, the compiler drops the whole call (and the getters in the arguments) when it is false
+#define TRACE(category, level, fmt, ...) do { if (((category) & TRACE_COMPILED_CATEGORIES) and (level) <= TRACE_COMPILED_LEVEL) trace().print((category), (level), fmt, ##__VA_ARGS__); } while (0)
+
+//message from TraceFormats.hpp, text or a binary record depending on the port (setBinaryCategories)
+#define TRACE_ID(category, level, format_id, ...) do { if (((category) & TRACE_COMPILED_CATEGORIES) and (level) <= TRACE_COMPILED_LEVEL) trace().printId((category), (level), (format_id), ##__VA_ARGS__); } while (0)
+
+//print to both serial ports using this macro
+#define serialPrint(fmt, ...) TRACE(TRACE_CONSOLE, TRACE_INFO, fmt, ##__VA_ARGS__)
+
+class Trace {
+public:
+    Trace();
+    
+    void print(int category, int level, const char * fmt, ...);    //use the TRACE macro
+    void printId(int category, int level, int format_id, ...);      //use the TRACE_ID macro
+    void service();                     //send waiting binary records (main loop)
+    
+    void setLevel(int level);
+    int getLevel();
+    void setPortCategories(int port, int categories);   //categories printed on TRACE_PORT_PC or TRACE_PORT_XBEE
+    int getPortCategories(int port);
+    void setBinaryCategories(int categories);   //categories sent to the XBee as binary records instead of text (on every port)
+    int getBinaryCategories();
+    void printStatus();
+    
+private:
+    int printText(int ports, const char * fmt, va_list args);
+    void printLongText(int ports, int length, const char * fmt, va_list args);
+    void writePorts(int ports, const char * text, int length);
+    int encodeRecord(uint8_t * record, int format_id, va_list args);
+    bool pushRecord(const uint8_t * record, int length);
+    
+    char _buffer[TRACE_BUFFER_BYTES];   //message is formatted once and written to each port
+    int _level;
+    int _port_categories[TRACE_NUM_PORTS];
+    unsigned int _message_count;
+    unsigned int _truncated_count;  //longer than _buffer and no heap for it
+    
+    int _binary_categories;
+    uint8_t _ring[TRACE_RING_BYTES];    //one producer (TRACE_ID), one consumer (service), no locking
+    volatile unsigned int _ring_head;   //free running, written by pushRecord only
+    volatile unsigned int _ring_tail;   //free running, written by service only
+    unsigned int _binary_record_count;
+    unsigned int _binary_drop_count;
+};
+
+#endif
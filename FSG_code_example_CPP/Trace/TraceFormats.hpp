@@ -0,0 +1,36 @@
+#ifndef TRACEFORMATS_HPP
+#define TRACEFORMATS_HPP
+
+//Messages that can be sent as binary trace records (format ID, time, raw arguments) instead of text.
+//
+//X(id, argument types, format)  one character per argument:
+//  f  float (4 bytes)
+//  d  int (4 bytes)
+//  t  float in tenths (2 bytes, +-3276.7)
+//  c  float in hundredths (2 bytes, +-327.67)
+//
+//The ID is the position in this list.  FSG_trace_decoder.py reads this file to decode the records,
+//so give it the same copy of the file as the firmware that sent them (only add to the end).
+
+#define TRACE_FORMAT_LIST(X) \
+    X(TRACE_FMT_CHECK_TUNING_STATUS,    "tttttttf",     "CHECK_TUNING: BCE_position: %0.1f, BATT_position: %0.1f (BCE_cmd: %0.1f, BATT_cmd: %0.1f)(depth: %0.1f ft,pitch: %0.1f deg,heading: %0.1f)     [%0.1f sec]\r") \
+    X(TRACE_FMT_EMERGENCY_CLIMB_STATUS, "ttttttf",      "EC: depth: %3.1f, pitch: %0.1f deg [BCE:%0.1f (cmd: %0.1f) BMM:%0.1f (cmd: %0.1f)] [%0.1f sec]\r") \
+    X(TRACE_FMT_DIVE_STATUS,            "ttttttttttf",  "DIVE: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg [cmd:%6.1f], heading_imu:%6.1f deg>>[%0.2f sec]                                         \r") \
+    X(TRACE_FMT_RISE_STATUS,            "ttttttttttf",  "RISE: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg [cmd:%6.1f], heading_imu:%6.1f deg>>[%0.2f sec]                                         \r") \
+    X(TRACE_FMT_POSITION_DIVE_STATUS,   "tttttttttf",   "POS DIVE: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg, heading_imu:%6.1f deg>>[%0.2f sec]                                         \r") \
+    X(TRACE_FMT_POSITION_RISE_STATUS,   "tttttttttf",   "POS RISE: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg, heading_imu:%6.1f deg>>[%0.2f sec]                                         \r") \
+    X(TRACE_FMT_FLOAT_LEVEL_STATUS,     "tttf",         "FL: pitchLoop output: %3.1f, batt pos: %3.1f, piston pos: %3.1f [%0.1f sec]\r") \
+    X(TRACE_FMT_FLOAT_BROADCAST_STATUS, "tttttttttf",   "FB: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg, heading_imu:%6.1f deg>>[%0.2f sec]                                         \r") \
+    X(TRACE_FMT_MULTI_DIVE_STATUS,      "ttttttttttf",  "MD: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg [cmd:%6.1f], heading_imu:%6.1f deg>>[%0.2f sec]                                         \r") \
+    X(TRACE_FMT_MULTI_RISE_STATUS,      "ttttttttttf",  "MR: BcePos (cmd):%6.1f mm(%0.1f), BattPos:%6.1f mm(%0.1f), RUD_deg_cmd: %5.1f <<current depth:%6.1f ft [cmd:%6.1f]), pitch:%6.1f deg [cmd:%6.1f], heading_imu:%6.1f deg>>[%0.2f sec]                                         \r") \
+    X(TRACE_FMT_NEUTRAL_SINKING_STATUS, "ttt",          "BCE current pos: %0.1f mm (BCE setpoint: %0.1f mm) (current depth: %0.1f ft)\r") \
+    X(TRACE_FMT_NEUTRAL_RISE_STATUS,    "t",            "depthLoop getOutput: %0.1f\r")
+
+enum {
+#define TRACE_FORMAT_ID(id, types, format) id,
+    TRACE_FORMAT_LIST(TRACE_FORMAT_ID)
+#undef TRACE_FORMAT_ID
+    TRACE_NUM_FORMATS
+};
+
+#endif
@@ -16,16 +16,14 @@ unknown behavior.
 This loads configuration files at the start--takes a second or two to load a few
 files. Also initiliazes the file systems on the MBED and SD card.
 
-Commented out SD card because we were testing hardware without an SD card at WH.
+The SD card copy of the log is a log sink (off until it is turned on in the log
+file menu) because we were testing hardware without an SD card at WH.
 
 *******************************************************************************/
 
 #include "mbed.h"
 #include "StaticDefs.hpp"
 
-// Macro to output to both serial ports
-#define serialPrint(fmt, ...) pc().printf(fmt, ##__VA_ARGS__);xbee().printf(fmt, ##__VA_ARGS__)
-
 Ticker systemTicker;
 bool setup_complete = false;
 volatile unsigned int bTick = 0;
@@ -62,6 +60,7 @@ void FSM() {                    // FSM loop runs at 10 hz
 }
 
 // Run the logging based on the timing set in the main loop
+// (this only samples into the RAM log buffer, the main loop writes it to the file with drainLogBuffer)
 void log_function() {    
     // log loop runs at 1 hz
     if (log_loop) {
@@ -69,18 +68,16 @@ void log_function() {
         
         if(current_state != 0) {
             if (!file_opened) {                                 //if the log file is not open, open it
-                mbedLogger().appendLogFile(current_state, 0);   //open MBED file once
-                //sdLogger().appendLogFile(current_state, 0);     //open SD file once
+                mbedLogger().startNewLogSegment();              //new log segment (LOG###) for each dive (the sinks follow it)
                            
                 file_opened = true;                             //stops it from continuing to open it
 
-                serialPrint(">>>>>>>> Recording. Log file opened. <<<<<<<<\n\r");
+                TRACE(TRACE_LOG, TRACE_INFO, ">>>>>>>> Recording. Log file opened. <<<<<<<<\n\r");
             }
             
             //record to Mbed file system   
             
             mbedLogger().appendLogFile(current_state, 1);    //writing data
-            //sdLogger().appendLogFile(current_state, 1);    //writing data
         }
         
         //when the current FSM state is zero (SIT_IDLE), close the file
@@ -89,14 +86,12 @@ void log_function() {
             if (file_opened) {
                 //WRITE ONCE
                 mbedLogger().appendLogFile(current_state, 1);   //write the idle state, then close
-                //sdLogger().appendLogFile(current_state, 1);     //write the idle state, then close
                 
                 mbedLogger().appendLogFile(current_state, 0);    //close log file
-                //sdLogger().appendLogFile(current_state, 0);    //close log file
                 
                 file_opened = false;
                 
-                serialPrint(">>>>>>>> Stopped recording. Log file closed. <<<<<<<<\n\r");
+                TRACE(TRACE_LOG, TRACE_INFO, ">>>>>>>> Stopped recording. Log file closed. <<<<<<<<\n\r");
             }
         }
     }   //END OF LOG LOOP8
@@ -104,6 +99,12 @@ void log_function() {
     log_loop = false;   // wait until the loop rate timer fires again
 }
 
+// Fast fields between the 1 Hz records while recording (binary log only, see TelemetryFields rate column)
+void fast_log_function() {
+    if (file_opened and current_state != 0)
+        mbedLogger().recordFastData(current_state);
+}
+
 //single system timer to run hardware/electronics timing
 static void system_timer(void) {
     bTick = 1;
@@ -119,6 +120,7 @@ static void system_timer(void) {
         if ( (timer_counter % 10) == 0) {   // runs at 100 Hz
             bce().update();      //update() inside LinearActuator class (running at 0.01 second intervals)
             batt().update();
+            blackBox().sample(); //last 2.56 seconds of raw readings, PID terms and commands
         }
         
         if ( (timer_counter % 20) == 0 ) {    // 0.02 second intervals
@@ -136,6 +138,7 @@ static void system_timer(void) {
         }
         
         if ( (timer_counter % 1000) == 0) {        // update at 1.0 second intervals
+            systemClock().update();                 // catch the microsecond timer rollover (every 71 minutes)
             //gui().updateGUI();
         }
         
@@ -167,8 +170,6 @@ void setup() {
     // construct the MBED local file system
     local();
     
-    // construct the SD card file system TEST 10/23/18
-    //sd_card();
  
     // load config data from files
     configFileIO().load_BATT_config();      // load the battery mass mover parameters from the file "batt.txt"
@@ -233,11 +234,18 @@ void setup() {
     
     //set time of logger (to current or close-to-current time)
     mbedLogger().setLogTime();
-    //sdLogger().setLogTime();
     
-    //create log files if not present on file system
+    //find the last log segment on the file system (the next dive is recorded in a new segment)
     mbedLogger().initializeLogFile();
-    //sdLogger().initializeLogFile(); // works 10/23/18
+    
+    //the log is formatted once and copied to these (SD card and radio are turned on in the log file menu)
+    mbedLogger().addLogSink(&sdLogSink());
+    mbedLogger().addLogSink(&radioLogSink());
+    mbedLogger().addLogSink(&ramLogSink());
+    ramLogSink().setEnabled(true);
+    
+    //construct the black box here, not in the system ticker interrupt that samples it
+    blackBox();
     
     //hardcoded p29 to be active for the altimeter
     ssr_cntl.write(0);  // Off-board altimeter on! This appears to be flipped from PCB drawing.
@@ -259,31 +267,44 @@ int main() {
         if( read_ticker() )                         // read_ticker runs at the speed of 10 kHz (adc timing)
         {
             ++tNow;
-
-            //Note to self: Retest data transmission code.
-            //This is currently running at 0.1 second intervals (10 hz) and was working well for data transmission
-            if (current_state == TX_MBED_LOG or current_state == RX_SEQUENCE) {
-                if ( (tNow % 100) == 0 ) {   // 0.1 second intervals  (100 Hz)
-                    fsm_loop = true;
-                    FSM();
-                }
-            }
             
-            //NOT TRANSMITTING DATA, NORMAL OPERATIONS
-            else {  
-            //FSM
-                if ( (tNow % 100) == 0 ) {   // 0.1 second intervals
-                    fsm_loop = true;
-                    FSM();
-                    
-                    //get commands and update GUI
+            //SEQUENCE FILE UPLOAD AND LOG DOWNLOAD (every tick while one is running, they return when they have nothing to do)
+            mbedLogger().serviceSequenceReceive();
+            mbedLogger().serviceLogTransmit();
+            
+        //BINARY TRACE RECORDS (status lines for FSG_trace_decoder.py, only when turned on in the debug menu)
+            if ( (tNow % 100) == 10 ) {
+                trace().service();
+            }
+        //LOG SINKS (SD card and radio copies of the log, each one only takes its own share of the time)
+            if ( (tNow % 100) == 25 ) {
+                mbedLogger().serviceLogSinks();
+            }
+        //FSM
+            if ( (tNow % 100) == 0 ) {   // 0.1 second intervals
+                fsm_loop = true;
+                FSM();
+                
+                //get commands and update GUI (not during a log download or sequence upload, they read the XBee)
+                if (!mbedLogger().isTransferRunning())
                     gui().getCommandFSM();
-                }        
-            //LOGGING     
-                if ( (tNow % 1000) == 0 ) {   // 1.0 second intervals                
-                    log_loop = true;
-                    log_function();
-                }
+                
+                //the 1 Hz log record has the fast fields too
+                if ( (tNow % 1000) != 0 )
+                    fast_log_function();
+            }        
+        //LOGGING     
+            if ( (tNow % 1000) == 0 ) {   // 1.0 second intervals                
+                log_loop = true;
+                log_function();
+            }
+        //LOG FILE WRITES (halfway between FSM ticks so slow file system writes never delay the FSM)
+            if ( (tNow % 100) == 50 ) {
+                mbedLogger().drainLogBuffer();
+            }
+        //BLACK BOX FILE (only after a trigger, about 1 KB per call)
+            if ( (tNow % 100) == 75 ) {
+                blackBox().persist();
             }
         }
     }
@@ -17,9 +17,6 @@ Fixed some errors, included the header guards, adjusted for 3.3v ADC.
 #include "omegaPX209.hpp"
 #include "StaticDefs.hpp"       //pins and other hardware (new)
 
-//print to both serial ports using this macro
-#define serialPrint(fmt, ...) pc().printf(fmt, ##__VA_ARGS__);xbee().printf(fmt, ##__VA_ARGS__)
-
 omegaPX209::omegaPX209(PinName pin): _adc(pin){    
     _psi = 14.7;                    // pressure [psi]
     _zeroPsi = 14.7;                // atmospheric pressure at sea level [psi]
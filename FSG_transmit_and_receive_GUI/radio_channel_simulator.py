@@ -0,0 +1,421 @@
+'''
+Title:            radio_channel_simulator.py
+Date:             10/17/2026
+Version:          0.1
+Description:      Runs the windowed log download (receive_file_from_mbed getWindowedData) over a simulated
+                  radio link and prints the download time for each bit error rate, packet type and parity group.
+Python Version:   2.7.13
+System:           Windows 7 64-bit
+Notes:            The MBED side is a model of MbedLogger::serviceTransmitWindow, transmitCompressedBlock and
+                  addToParity / transmitParityPacket (LZSS as in LogCompressor.cpp).  The link has a byte rate,
+                  a latency each way and random bit errors.  With --frames the radio cuts the stream into frames
+                  and drops a frame with a bit error in it (the XBee checks the RF CRC), without it the bad
+                  bytes get through and the packet CRC throws the packet away.
+                  The receiver runs unchanged on a simulated clock, a run takes a few seconds.
+                  Usage: python radio_channel_simulator.py [LOG000.csv] [--frames] [--rate 11520] [--latency 0.05]
+'''
+
+from __future__ import print_function
+
+import bisect
+import collections
+import os
+import random
+import sys
+import time as real_time
+
+import receive_file_from_mbed_02_25_19 as receive_file_from_mbed
+
+LINE_SIZE = receive_file_from_mbed.ReceiveFromSerialFSG.LINE_SIZE
+BLOCK_LINES = receive_file_from_mbed.ReceiveFromSerialFSG.COMPRESS_BLOCK_LINES
+CRCTABLE = receive_file_from_mbed.ReceiveFromSerialFSG.CRCTABLE
+
+WINDOW_MAX_PACKETS = 32     # LOG_WINDOW_MAX_PACKETS in MbedLogger.hpp
+
+def crc16(data, crc=0):
+    for byte in bytearray(data):
+        crc = (CRCTABLE[(byte ^ crc) & 0xff] ^ (crc >> 8)) & 0xFFFF
+    return crc
+
+def compress(data, primer_length, line_length, output_size):
+    ### LogCompressor::compress, None if it doesn't fit in output_size ###
+    def hash(i):
+        return ((data[i] << 8) ^ (data[i+1] << 4) ^ data[i+2]) & 255
+
+    hash_head = [0] * 256
+    length = len(data)
+
+    def addHash(i):
+        if (i + 2 < length):
+            hash_head[hash(i)] = i + 1
+
+    def matchLength(candidate, position):
+        if (candidate < 0 or candidate >= position or position - candidate > 4096):
+            return 0
+        match = 0
+        while (position + match < length and match < 273 and data[candidate + match] == data[position + match]):
+            match = match + 1
+        return match
+
+    for position in range(primer_length):
+        addHash(position)
+
+    output = bytearray()
+    flag_index = 0
+    items = 8
+    position = primer_length
+
+    while (position < length):
+        if (len(output) + 4 > output_size):
+            return None
+
+        if (items == 8):
+            flag_index = len(output)
+            output.append(0)
+            items = 0
+
+        candidates = [position - line_length, position - 2 * line_length]
+        candidates.append(hash_head[hash(position)] - 1 if position + 2 < length else -1)
+
+        best_length = 0
+        best_distance = 0
+        for candidate in candidates:
+            match = matchLength(candidate, position)
+            if (match > best_length):
+                best_length = match
+                best_distance = position - candidate
+
+        if (best_length >= 3):
+            code = best_length - 3
+            output[flag_index] |= (1 << items)
+            output.append(((best_distance - 1) >> 4) & 0xFF)
+            if (code >= 15):
+                output += bytearray([(((best_distance - 1) << 4) | 15) & 0xFF, code - 15])
+            else:
+                output.append((((best_distance - 1) << 4) | code) & 0xFF)
+            for i in range(best_length):
+                addHash(position + i)
+            position = position + best_length
+        else:
+            output.append(data[position])
+            addHash(position)
+            position = position + 1
+
+        items = items + 1
+
+    return output
+
+class SimulatedClock(object):
+    ### stands in for the time module of receive_file_from_mbed, sleep moves the simulation on ###
+    def __init__(self):
+        self.now = 0.0
+        self.link = None
+
+    def time(self):
+        return self.now
+
+    def sleep(self, seconds):
+        self.now = self.now + seconds
+        self.link.update(self.now)
+
+    def __getattr__(self, name):
+        return getattr(real_time, name)     # strftime, localtime
+
+class SimulatedLink(object):
+    ### serial port of the PC: bytes from the MBED model come in at the byte rate after the latency ###
+    def __init__(self, clock, mbed, rate, latency, bit_error_rate, frame_size, seed):
+        self.clock = clock
+        self.mbed = mbed
+        self.rate = rate
+        self.latency = latency
+        self.bit_error_rate = bit_error_rate
+        self.frame_size = frame_size
+        self.random = random.Random(seed)
+
+        self._downlink = collections.deque()   # (arrival time, byte)
+        self._downlink_free = 0.0               # when the MBED has sent everything it was given
+        self._uplink = []                       # (arrival time, bytes) for the MBED
+        self._received = bytearray()
+        self.bytes_sent = 0
+
+        clock.link = self
+
+    def corrupt(self, data):
+        ### (position, byte) of the bytes that get through: random bits flipped, or the frames with a flipped bit dropped ###
+        data = bytearray(data)
+        errors = []
+        if (self.bit_error_rate > 0):
+            position = int(self.random.expovariate(self.bit_error_rate))
+            while (position < len(data) * 8):
+                errors.append(position)
+                position = position + 1 + int(self.random.expovariate(self.bit_error_rate))
+
+        if (self.frame_size):
+            lost_frames = set([x / 8 / self.frame_size for x in errors])
+            return [(i, byte) for i, byte in enumerate(data) if i / self.frame_size not in lost_frames]
+
+        for x in errors:
+            data[x / 8] ^= (1 << (x % 8))
+        return list(enumerate(data))
+
+    def transmit(self, data, send_time):
+        ### MBED to PC, the MBED waits for the UART (xbee().putc) so the bytes go one after the other ###
+        if (not data):
+            return
+
+        start = max(self._downlink_free, send_time)
+        self._downlink_free = start + len(data) / float(self.rate)
+        self.bytes_sent = self.bytes_sent + len(data)
+
+        for i, byte in self.corrupt(data):
+            self._downlink.append((start + (i + 1) / float(self.rate) + self.latency, byte))
+
+    def update(self, now):
+        ### hand the MBED the PC bytes that got there by now ###
+        while (self._uplink and self._uplink[0][0] <= now):
+            arrival, data = self._uplink.pop(0)
+            self.transmit(self.mbed.receive(data), arrival)
+
+    # serial.Serial
+    @property
+    def in_waiting(self):
+        self.update(self.clock.now)
+        while (self._downlink and self._downlink[0][0] <= self.clock.now):
+            self._received.append(self._downlink.popleft()[1])
+        return len(self._received)
+
+    def read(self, size=1):
+        data = str(self._received[:size])
+        del self._received[:size]
+        return data
+
+    def write(self, data):
+        arrival = self.clock.now + len(data) / float(self.rate) + self.latency
+        received = bytearray([byte for i, byte in self.corrupt(data)])
+        bisect.insort(self._uplink, (arrival, received))
+
+    def reset_input_buffer(self):
+        self._received = bytearray()
+
+    def flush(self):
+        pass
+
+class SimulatedMbed(object):
+    ### MbedLogger side of the windowed download, answers the window acknowledgements (75 61) ###
+    def __init__(self, lines):
+        self.lines = lines      # LINE_SIZE bytes each, the newline last
+        self._input = bytearray()
+        self._output = bytearray()
+
+        self._active = False
+        self._compressed = False
+        self._next_packet = 0
+        self._send_count = 0
+        self._sent_at = [0] * (WINDOW_MAX_PACKETS + 1)
+        self._total = 0
+
+        self._parity_group = 0
+        self._parity_first = 0
+        self._parity_count = 0
+        self._parity = bytearray()
+
+    def receive(self, data):
+        ### bytes from the PC, returns the bytes the MBED sends back ###
+        self._input += data
+        self._output = bytearray()
+
+        while True:
+            start = self._input.find(b"\x75\x61")
+            if (start < 0):
+                del self._input[:max(0, len(self._input) - 1)]
+                break
+            if (len(self._input) < start + 12):
+                del self._input[:start]
+                break
+
+            packet = self._input[start:start+12]
+            if (crc16(packet[:10]) == packet[10] * 256 + packet[11]):
+                mask = (packet[5] << 24) | (packet[6] << 16) | (packet[7] << 8) | packet[8]
+                self.serviceWindow(packet[2], packet[3] * 256 + packet[4], mask, packet[9] & 1, packet[9] & 2, packet[9] >> 4)
+                del self._input[:start+12]
+            else:
+                del self._input[:start+1]
+
+        return self._output
+
+    def serviceWindow(self, window, first_missing, mask, resend_missing, compressed, parity_group):
+        ### MbedLogger::serviceTransmitWindow ###
+        window = max(1, min(window, WINDOW_MAX_PACKETS))
+        compressed = bool(compressed)
+        slots = WINDOW_MAX_PACKETS + 1
+
+        if (not self._active or first_missing > self._next_packet or compressed != self._compressed):
+            self._active = True
+            self._compressed = compressed
+            self._next_packet = first_missing
+            self._send_count = 0
+            self._sent_at = [0] * slots
+            self._total = (len(self.lines) + BLOCK_LINES - 1) / BLOCK_LINES if compressed else len(self.lines)
+            self._parity_count = 0
+
+        if (parity_group != self._parity_group):
+            self._parity_group = parity_group
+            self._parity_count = 0
+
+        received_sent_at = 0
+        for bit in range(WINDOW_MAX_PACKETS):
+            if (mask & (1 << bit)):
+                received_sent_at = max(received_sent_at, self._sent_at[(first_missing + 1 + bit) % slots])
+
+        last_sent = min(self._next_packet, first_missing + 1 + WINDOW_MAX_PACKETS, self._total)
+        for packet in range(first_missing, last_sent):
+            bit = packet - first_missing - 1
+            if (bit >= 0 and mask & (1 << bit)):
+                continue
+
+            parity_to_come = (self._parity_count > 0 and self._parity_first <= packet < self._parity_first + self._parity_count)
+            if (resend_missing or (self._sent_at[packet % slots] < received_sent_at and not parity_to_come)):
+                self.sendPacket(packet, False)
+                self._send_count = self._send_count + 1
+                self._sent_at[packet % slots] = self._send_count
+
+        while (self._next_packet < self._total and self._next_packet < first_missing + window):
+            bit = self._next_packet - first_missing - 1
+            if (bit < 0 or not mask & (1 << bit)):
+                self.sendPacket(self._next_packet, True)
+                self._send_count = self._send_count + 1
+                self._sent_at[self._next_packet % slots] = self._send_count
+            self._next_packet = self._next_packet + 1
+
+    def sendPacket(self, packet_number, add_to_parity):
+        ### a line (transmitPacketNumber) or a compressed block (transmitCompressedBlock) ###
+        if (self._compressed):
+            first_line = packet_number * BLOCK_LINES
+            lines = min(BLOCK_LINES, len(self.lines) - first_line)
+            primer = self.lines[first_line - 1] if first_line > 0 else bytearray()
+            block = bytearray().join(self.lines[first_line:first_line+lines])
+
+            method = 1
+            data = compress(primer + block, len(primer), LINE_SIZE, lines * LINE_SIZE - 1)
+            if (data is None):
+                method = 0
+                data = block
+
+            header = bytearray([0x75, 0x7A, packet_number / 256, packet_number % 256, self._total / 256, self._total % 256, lines, method, len(data) / 256, len(data) % 256])
+            parity_bytes = header[6:] + data
+        else:
+            data = self.lines[packet_number][:LINE_SIZE-1]
+            header = bytearray([0x75, 0x65, packet_number / 256, packet_number % 256, self._total / 256, self._total % 256, len(data)])
+            parity_bytes = data
+
+        crc = crc16(data, crc16(header))
+        self._output += header + data + bytearray([crc / 256, crc % 256])
+
+        if (add_to_parity):
+            self.addToParity(packet_number, parity_bytes)
+
+    def addToParity(self, packet_number, data):
+        ### MbedLogger::addToParity and transmitParityPacket ###
+        if (self._parity_group < 2):
+            return
+
+        if (self._parity_count == 0 or packet_number != self._parity_first + self._parity_count):
+            self._parity_first = packet_number
+            self._parity_count = 0
+            self._parity = bytearray()
+
+        if (len(data) > len(self._parity)):
+            self._parity += bytearray(len(data) - len(self._parity))
+        for i, byte in enumerate(data):
+            self._parity[i] ^= byte
+        self._parity_count = self._parity_count + 1
+
+        if (self._parity_count == self._parity_group or packet_number == self._total - 1):
+            header = bytearray([0x75, 0x70, self._parity_first / 256, self._parity_first % 256, self._parity_count, len(self._parity) / 256, len(self._parity) % 256])
+            crc = crc16(self._parity, crc16(header))
+            self._output += header + self._parity + bytearray([crc / 256, crc % 256])
+
+            self._send_count = self._send_count + 1
+            for packet in range(self._parity_first, self._parity_first + self._parity_count):
+                self._sent_at[packet % (WINDOW_MAX_PACKETS + 1)] = self._send_count
+            self._parity_count = 0
+
+def readLog(filename):
+    ### log lines padded to the fixed width the MBED uses ###
+    lines = []
+    for line in open(filename, 'rb').read().splitlines():
+        lines.append(bytearray(line[:LINE_SIZE-1].ljust(LINE_SIZE-1)) + b"\n")
+    return lines
+
+def simulateDownload(lines, rate, latency, bit_error_rate, frame_size, window, compressed, parity_group, seed):
+    ### seconds to get the log, bytes the MBED sent, packets rebuilt from parity (None if the download didn't finish) ###
+    clock = SimulatedClock()
+    link = SimulatedLink(clock, SimulatedMbed(lines), rate, latency, bit_error_rate, frame_size, seed)
+    receive_file_from_mbed.time = clock
+
+    receiver = receive_file_from_mbed.ReceiveFromSerialFSG()
+    receiver._ser = link
+
+    packets = (len(lines) + BLOCK_LINES - 1) / BLOCK_LINES if compressed else len(lines)
+    if (not receiver.getWindowedData(window, total=packets, compressed=compressed, parity_group=parity_group)):
+        return None
+
+    if (receiver._data_packet_list != [str(x).rstrip() + "\n" for x in lines]):
+        print("simulateDownload: the log is different from the one sent!")
+        return None
+
+    return clock.now, link.bytes_sent, receiver.window_recovered
+
+if __name__ == '__main__':
+    arguments = sys.argv[1:]
+    options = {'--rate': 11520.0, '--latency': 0.05, '--window': 32, '--seeds': 3}
+    for name in options.keys():
+        if (name in arguments):
+            index = arguments.index(name)
+            options[name] = type(options[name])(arguments[index+1])
+            del arguments[index:index+2]
+
+    frame_size = 0
+    if ('--frames' in arguments):
+        frame_size = 100        # about what the XBee puts in an RF packet
+        arguments.remove('--frames')
+
+    filename = arguments[0] if arguments else os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "FSG_plot_and_save_to_excel", "LOG000.csv")
+    lines = readLog(filename)
+    log_bytes = len(lines) * LINE_SIZE
+
+    modes = [("lines", False, 0), ("lines, parity 8", False, 8), ("compressed", True, 0), ("compressed, parity 4", True, 4), ("compressed, parity 8", True, 8)]
+    bit_error_rates = [0, 1e-5, 3e-5, 1e-4, 3e-4]
+
+    print("%s: %d lines (%d bytes), %d bytes/s, %.0f ms latency, window %d, %s" % (filename, len(lines), log_bytes, options['--rate'],
+        options['--latency'] * 1000, options['--window'], "frames with an error dropped" if frame_size else "bit errors"))
+    print("log bytes per second (average of %d runs), packets rebuilt from parity in brackets" % options['--seeds'])
+    print("%-22s" % "bit error rate" + "".join(["%14g" % x for x in bit_error_rates]))
+
+    stdout = sys.stdout
+    for name, compressed, parity_group in modes:
+        row = "%-22s" % name
+        for bit_error_rate in bit_error_rates:
+            seconds = 0
+            recovered = 0
+            failed = False
+            for seed in range(options['--seeds']):
+                sys.stdout = open(os.devnull, 'w')      # the receiver prints every download
+                try:
+                    result = simulateDownload(lines, options['--rate'], options['--latency'], bit_error_rate, frame_size,
+                                              options['--window'], compressed, parity_group, seed)
+                finally:
+                    sys.stdout = stdout
+                if (result is None):
+                    failed = True
+                    break
+                seconds = seconds + result[0]
+                recovered = recovered + result[2]
+
+            if (failed):
+                row = row + "%14s" % "failed"
+            elif (parity_group):
+                row = row + "%14s" % ("%.0f (%d)" % (log_bytes * options['--seeds'] / seconds, recovered))
+            else:
+                row = row + "%14.0f" % (log_bytes * options['--seeds'] / seconds)
+        print(row)
@@ -2,11 +2,20 @@ from __future__ import print_function
 
 import serial
 import time
+import os
+import json
 
 DEMO = True
 
 class ReceiveFromSerialFSG(object):
     # the crc list is always going to stay the same no matter the instance of the class
+    # state numbers (St# column of the log, StateMachine.hpp) for log queries
+    MULTI_DIVE = 10
+    MULTI_RISE = 11
+
+    LINE_SIZE = 255                 # every log line is 254 characters and the newline
+    COMPRESS_BLOCK_LINES = 8        # lines in a compressed packet (LOG_COMPRESS_BLOCK_LINES in MbedLogger.hpp)
+
     CRCTABLE = [0, 49345, 49537, 320, 49921, 960, 640, 49729, 50689, 1728, 1920, 51009, 1280, 50625, 50305,  1088, 52225,  3264,  3456, 52545,  3840, 53185, 52865,  3648,  2560, 51905, 52097,  2880, 51457,  2496,  2176, 51265, 55297,  6336,  6528, 55617,  6912, 56257, 55937,  6720,  7680, 57025, 57217,  8000, 56577,  7616,  7296, 56385,  5120, 54465, 54657,  5440, 55041,  6080,  5760, 54849, 53761,  4800,  4992, 54081,  4352, 53697, 53377,  4160, 61441, 12480, 12672, 61761, 13056, 62401, 62081, 12864, 13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529, 15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089, 64001, 15040, 15232, 64321, 14592, 63937, 63617, 14400, 10240, 59585, 59777, 10560, 60161, 11200, 10880, 59969, 60929, 11968, 12160, 61249, 11520, 60865, 60545, 11328, 58369,  9408,  9600, 58689,  9984, 59329, 59009,  9792,  8704, 58049, 58241,  9024, 57601,  8640,  8320, 57409, 40961, 24768, 24960, 41281, 25344, 41921, 41601, 25152, 26112, 42689, 42881, 26432, 42241, 26048, 25728, 42049, 27648, 44225, 44417, 27968, 44801, 28608, 28288, 44609, 43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688, 30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681, 48641, 32448, 32640, 48961, 32000, 48577, 48257, 31808, 46081, 29888, 30080, 46401, 30464, 47041, 46721, 30272, 29184, 45761, 45953, 29504, 45313, 29120, 28800, 45121, 20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441, 38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568, 39937, 23744, 23936, 40257, 24320, 40897, 40577, 24128, 23040, 39617, 39809, 23360, 39169, 22976, 22656, 38977, 34817, 18624, 18816, 35137, 19200, 35777, 35457, 19008, 19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905, 17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369, 33281, 17088, 17280, 33601, 16640, 33217, 32897, 16448]
     
     def __init__(self, input_port='COM25'):     #get a Serial instance and configure/open it later        
@@ -24,11 +33,25 @@ class ReceiveFromSerialFSG(object):
         self._number_of_packets_in_file = 0
 
         self.finished_processing = False
+        self._end_of_query = False
 
         # TIMER
         self.t0 = 0
         self.t1 = 0
 
+        # windowed download (getWindowedData)
+        self._window_packets = {}
+        self._window_bytes = bytearray()
+        self.window_acks_sent = 0
+        self.window_duplicates = 0
+        self._window_highest = -1
+        self._window_gap = False
+        self._window_new_packets = []
+        self._window_compressed = False
+        self._window_parity_group = 0
+        self._window_parity = {}
+        self.window_recovered = 0
+
     def setSerialPort(self, new_serial_port):
         self._ser.port = new_serial_port
 
@@ -95,6 +118,247 @@ class ReceiveFromSerialFSG(object):
         
         #print("sendRequest: %d %d %d %d (#%d) (Python)" % (75,65,send_byte_three,send_byte_four, packet_number)) #DEBUG        
 
+    def sendQuery(self, start_time, end_time, state_list, decimation):
+        ### log query: lines from start_time to end_time (TimeSec, 0 = no limit) in the states in state_list (empty = all), every Nth line ###
+        state_mask = 0
+        for state in state_list:
+            state_mask = state_mask | (1 << state)
+
+        query_bytes = [117, 113]    # 0x75 0x71 ('q')
+        for value in (start_time, end_time):
+            query_bytes += [(value >> 24) & 0xFF, (value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF]
+        query_bytes += [state_mask / 256, state_mask % 256, decimation]
+
+        query_string = "".join([chr(x) for x in query_bytes])
+        query_string += chr(self.calc_crc_1(query_string)) + chr(self.calc_crc_2(query_string))
+        self._ser.write(query_string)
+
+        print("sendQuery: start %d end %d states %04X decimation %d" % (start_time, end_time, state_mask, decimation))
+
+    def sendWindowAck(self, window, first_missing, received_mask, resend_missing):
+        ### window acknowledgement: every packet before first_missing is in, bit n of received_mask is packet first_missing+1+n ###
+        ack_bytes = [117, 97, window]    # 0x75 0x61 ('a')
+        ack_bytes += [first_missing / 256, first_missing % 256]
+        ack_bytes += [(received_mask >> 24) & 0xFF, (received_mask >> 16) & 0xFF, (received_mask >> 8) & 0xFF, received_mask & 0xFF]
+        ack_bytes += [(1 if resend_missing else 0) | (2 if self._window_compressed else 0) | (self._window_parity_group << 4)]
+
+        ack_string = "".join([chr(x) for x in ack_bytes])
+        ack_string += chr(self.calc_crc_1(ack_string)) + chr(self.calc_crc_2(ack_string))
+        self._ser.write(ack_string)
+        self.window_acks_sent = self.window_acks_sent + 1
+
+    def sendIdentityRequest(self, segment):
+        ### which segment to download (0xFFFF = the MBED transmit segment), the MBED replies with its identity ###
+        identity_string = "".join([chr(x) for x in [117, 105, segment / 256, segment % 256]])    # 0x75 0x69 ('i')
+        identity_string += chr(self.calc_crc_1(identity_string)) + chr(self.calc_crc_2(identity_string))
+        self._ser.write(identity_string)
+
+    def parseIdentityReply(self, read_data_string):
+        # 75 69 segment (2) current segment (2) packets (2) fingerprint (4) CC CC
+        data = bytearray(read_data_string)
+        start = data.find(b"\x75\x69")
+        if (start < 0 or len(data) < start + 14):
+            return None
+
+        if (self.crccalc(str(data[start:start+12])) != data[start+12] * 256 + data[start+13]):
+            return None
+
+        identity = {}
+        identity['segment'] = data[start+2] * 256 + data[start+3]
+        identity['current_segment'] = data[start+4] * 256 + data[start+5]
+        identity['packets'] = data[start+6] * 256 + data[start+7]
+        identity['fingerprint'] = (data[start+8] << 24) | (data[start+9] << 16) | (data[start+10] << 8) | data[start+11]
+        return identity
+
+    def getSegmentIdentity(self, segment=0xFFFF, attempts=5):
+        for attempt in range(attempts):
+            self._ser.reset_input_buffer()
+            self.sendIdentityRequest(segment)
+            time.sleep(0.5)
+
+            identity = self.parseIdentityReply(self._ser.read(self._ser.in_waiting))
+            if (identity is not None):
+                return identity
+
+        print("getSegmentIdentity: no reply from the MBED")
+        return None
+
+    def parseWindowPackets(self):
+        ### take every whole data packet out of the received bytes, skip anything else (text, damaged packets) ###
+        # 75 65 NN NN TT TT LL (data) CC CC is a line, 75 7A NN NN TT TT lines method LL LL (data) CC CC a compressed block,
+        # 75 70 FF FF count LL LL (XOR of the packets) CC CC a parity packet
+        data = self._window_bytes
+        new_packets = 0
+        start = 0
+
+        while True:
+            start = data.find(b"\x75", start)
+            if (start < 0):
+                start = len(data)
+                break
+            if (len(data) < start + 2):
+                break
+
+            if (data[start+1] == 0x65 or data[start+1] == 0x70):
+                header_length = 7
+            elif (data[start+1] == 0x7A):
+                header_length = 10
+            else:
+                start = start + 1
+                continue
+
+            if (len(data) < start + header_length):
+                break
+
+            if (data[start+1] == 0x65):
+                length = data[start+6]
+            elif (data[start+1] == 0x70):
+                length = data[start+5] * 256 + data[start+6]
+            else:
+                length = data[start+8] * 256 + data[start+9]
+
+            if (length == 0 or length > self.COMPRESS_BLOCK_LINES * self.LINE_SIZE + 4):
+                start = start + 1   # not a packet
+                continue
+
+            if (len(data) < start + header_length + length + 2):
+                break
+
+            crc = 0
+            for byte in data[start:start+header_length+length]:
+                crc = (self.CRCTABLE[(byte ^ crc) & 0xff] ^ (crc >> 8)) & 0xFFFF
+
+            if (crc != data[start+header_length+length] * 256 + data[start+header_length+length+1]):
+                start = start + 1   # not a packet (or damaged), look for the next header
+                continue
+
+            packet_number = data[start+2] * 256 + data[start+3]
+
+            if (data[start+1] == 0x70):
+                self._window_parity[packet_number] = (data[start+4], data[start+header_length:start+header_length+length])
+                start = start + header_length + length + 2
+                continue
+
+            self._number_of_packets_in_file = data[start+4] * 256 + data[start+5]
+
+            packet = str(data[start+header_length:start+header_length+length])
+            if (header_length == 10):
+                packet = (data[start+6], data[start+7], packet)     # lines, method, compressed data
+
+            if (packet_number in self._window_packets):
+                self.window_duplicates = self.window_duplicates + 1
+            else:
+                self._window_packets[packet_number] = packet
+                self._window_new_packets.append(packet_number)
+                new_packets = new_packets + 1
+
+            if (packet_number > self._window_highest + 1):
+                self._window_gap = True     # a packet in between was lost
+            self._window_highest = max(self._window_highest, packet_number)
+
+            start = start + header_length + length + 2
+
+        # keep the start of a packet that is cut in half
+        self._window_bytes = data[start:]
+        return new_packets + self.recoverFromParity()
+
+    def getParityBytes(self, packet_number):
+        ### the bytes of a packet that go into the parity (MbedLogger::addToParity) ###
+        packet = self._window_packets[packet_number]
+        if (not self._window_compressed):
+            return bytearray(packet)
+
+        lines, method, data = packet
+        return bytearray([lines, method, len(data) / 256, len(data) % 256]) + bytearray(data)
+
+    def recoverFromParity(self):
+        ### rebuild the packet of a parity group that didn't get through (XOR of the parity and the rest of the group) ###
+        recovered = 0
+
+        for first in sorted(self._window_parity.keys()):
+            count, parity = self._window_parity[first]
+            group = range(first, first + count)
+            missing = [x for x in group if x not in self._window_packets]
+
+            if (len(missing) == 0):
+                del self._window_parity[first]
+                continue
+
+            # can't use the group if two are missing, or one was downloaded in an earlier session (no bytes here)
+            if (len(missing) > 1 or [x for x in group if x != missing[0] and self._window_packets[x] is None]):
+                continue
+
+            rebuilt = bytearray(parity)
+            for x in group:
+                if (x != missing[0]):
+                    for i, byte in enumerate(self.getParityBytes(x)):
+                        rebuilt[i] = rebuilt[i] ^ byte
+
+            if (self._window_compressed):
+                length = rebuilt[2] * 256 + rebuilt[3]
+                packet = (rebuilt[0], rebuilt[1], str(rebuilt[4:4+length]))
+            else:
+                packet = str(rebuilt[:self.LINE_SIZE-1])
+
+            self._window_packets[missing[0]] = packet
+            self._window_new_packets.append(missing[0])
+            self._window_highest = max(self._window_highest, missing[0])
+            self.window_recovered = self.window_recovered + 1
+            recovered = recovered + 1
+            del self._window_parity[first]
+
+        return recovered
+
+    @staticmethod
+    def decompressBlock(data, primer, length):
+        ### LZSS (LogCompressor.cpp): flag byte for 8 items, literal byte or 12 bit distance-1 and 4 bit length-3 (15: one more byte) ###
+        data = bytearray(data)
+        output = bytearray(primer)
+        end = len(output) + length
+        i = 0
+
+        while (len(output) < end):
+            flags = data[i]
+            i = i + 1
+            for item in range(8):
+                if (len(output) >= end):
+                    break
+
+                if (flags & (1 << item)):
+                    distance = ((data[i] << 4) | (data[i+1] >> 4)) + 1
+                    match = data[i+1] & 15
+                    i = i + 2
+                    if (match == 15):
+                        match = match + data[i]
+                        i = i + 1
+                    for k in range(match + 3):
+                        output.append(output[-distance])
+                else:
+                    output.append(data[i])
+                    i = i + 1
+
+        return str(output[len(primer):])
+
+    def decodeWindowBlock(self, block, primer):
+        ### lines of a compressed block, primer is the line before it ("" for block 0) ###
+        lines, method, data = self._window_packets[block]
+        if (method == 0):
+            return data
+        return self.decompressBlock(data, primer, lines * self.LINE_SIZE)
+
+    def getWindowAck(self):
+        ### first missing packet and the bitmap of the packets after it that are already in ###
+        first_missing = 0
+        while (first_missing in self._window_packets):
+            first_missing = first_missing + 1
+
+        received_mask = 0
+        for bit in range(32):
+            if (first_missing + 1 + bit in self._window_packets):
+                received_mask = received_mask | (1 << bit)
+
+        return first_missing, received_mask
+
     def recordLog(self, input_list):
         # NEXT CREATE FILE BASED ON DATE AND TIME
         log_filename = time.strftime("Log_%Y_%m_%d_time_%H_%M.csv", time.localtime())
@@ -144,6 +408,13 @@ class ReceiveFromSerialFSG(object):
         # Packet: 75 65 NN NN TT TT LL CC CC  (smallest packet, no data, is size 9)
         # Packet: 75 65 NN NN TT TT LL DD CC CC  (smallest packet, should be over size 10)
 
+        # end of a log query: 75 65 NN NN TT TT 00 CC CC (no data, TT TT is the number of lines that matched)
+        if (string_length == 9 and ord(read_data_string[0]) == 117 and ord(read_data_string[1]) == 101 and ord(read_data_string[6]) == 0):
+            if (self.crccalc(read_data_string[0:7]) == ord(read_data_string[7]) * 256 + ord(read_data_string[8])):
+                self._end_of_query = True
+                self._number_of_packets_in_file = ord(read_data_string[4]) * 256 + ord(read_data_string[5])
+            return False
+
         if (string_length < 10):
             return False
 
@@ -308,6 +579,214 @@ class ReceiveFromSerialFSG(object):
                     print("<><> COMPLETED PROCESSING %d" %x)
                     break
 
+    def getWindowedData(self, window=32, idle_time=0.3, timeout=600, silence_timeout=10, total=0, known_packets=None, new_packets_callback=None, compressed=False, parity_group=0):
+        # selective repeat: the MBED streams up to window packets, acknowledgements report the holes
+        # known_packets (downloaded in an earlier session) aren't sent again, new_packets_callback gets the numbers of the new ones
+        # compressed: packets are blocks of COMPRESS_BLOCK_LINES lines (LZSS) instead of lines
+        # parity_group: a parity packet after every parity_group packets (2 to 15), one lost packet in a group is rebuilt here
+        self._window_compressed = compressed
+        self._window_parity_group = parity_group
+        self._window_parity = {}
+        self.window_recovered = 0
+        self._window_packets = dict.fromkeys(known_packets or [])
+        self._window_bytes = bytearray()
+        self._window_new_packets = []
+        self._window_gap = False
+        self._number_of_packets_in_file = total
+        self.window_acks_sent = 0
+        self.window_duplicates = 0
+
+        start_time = time.time()
+        last_packet_time = time.time()
+        last_data_time = time.time()
+        packets_since_ack = 0
+
+        first_missing, received_mask = self.getWindowAck()
+        self._window_highest = first_missing - 1
+        self.sendWindowAck(window, first_missing, received_mask, True)     # starts the stream
+
+        while True:
+            waiting = self._ser.in_waiting
+            if (waiting):
+                self._window_bytes += bytearray(self._ser.read(waiting))
+                last_data_time = time.time()    # still sending (maybe packets we have), not idle
+                new_packets = self.parseWindowPackets()
+                if (new_packets):
+                    packets_since_ack = packets_since_ack + new_packets
+                    last_packet_time = time.time()
+                    if (new_packets_callback is not None):
+                        new_packets_callback(self._window_new_packets)
+                    self._window_new_packets = []
+            else:
+                time.sleep(0.01)
+
+            total = self._number_of_packets_in_file
+            if (total and len(self._window_packets) >= total):
+                break
+
+            if (time.time() - start_time > timeout or time.time() - last_packet_time > silence_timeout):
+                print("getWindowedData: stopped with %d of %d packets" % (len(self._window_packets), total))
+                return False
+
+            # acknowledge every quarter window and as soon as a packet is missing (the MBED only sends the lost ones again),
+            # ask for all the holes again when the MBED stops sending
+            idle = (time.time() - last_data_time > idle_time)
+            if (packets_since_ack >= max(1, window / 4) or self._window_gap or idle):
+                first_missing, received_mask = self.getWindowAck()
+                self.sendWindowAck(window, first_missing, received_mask, idle)
+                packets_since_ack = 0
+                self._window_gap = False
+                if (idle):
+                    last_data_time = time.time()
+
+            if (total):
+                self.download_progress = 100 * (1.0 * len(self._window_packets) / total)
+
+        if (compressed):
+            lines = []
+            if (not known_packets):     # a resumed download is put together by the caller (getResumableData)
+                for x in range(total):
+                    block = self.decodeWindowBlock(x, lines[-1] if lines else "")
+                    lines += [block[i:i+self.LINE_SIZE] for i in range(0, len(block), self.LINE_SIZE)]
+        else:
+            lines = [self._window_packets[x] for x in range(total) if self._window_packets[x] is not None]
+
+        self._data_packet_list = [x.rstrip() + "\n" for x in lines]
+        self.download_progress = 100
+
+        print("<><> COMPLETED %d packets (%d acknowledgements, %d duplicates, %d rebuilt from parity)" % (total, self.window_acks_sent, self.window_duplicates, self.window_recovered))
+        return True
+
+    def getQueryData(self):
+        x = 1
+        self._end_of_query = False
+
+        # the total number of lines isn't known until the MBED sends the end of the query
+        while True:
+            self.sendRequest(x) # SEND REQUEST, WAIT FOR REPLY
+            time.sleep(0.25)
+
+            if (self.receiveData(x)):
+                self._data_packet_list.append(self._write_string)
+                print("(getQueryData) line #%d" % x)
+                x = x+1
+
+            elif (self._end_of_query):
+                print("<><> QUERY COMPLETE, %d lines" % self._number_of_packets_in_file)
+                self.download_progress = 100
+                break
+
+    def getQueryLog(self, start_time=0, end_time=0, state_list=None, decimation=1):
+        # only the lines in the time window/states (every Nth line), from all the CSV log segments
+        self.t0 = time.time()
+
+        if (state_list is None):
+            state_list = []
+
+        self.openserial()
+        time.sleep(1)
+
+        self._ser.write("c")
+        time.sleep(1)
+        self._ser.flush()
+
+        print("Python: (getQueryLog) Sending MBED transmit command ('U')")
+        self._ser.write("U")
+        time.sleep(3)
+
+        ### SEND THE QUERY UNTIL THE MBED REPLIES WITH THE HEADING (packet 0) ###
+        while True:
+            self.sendQuery(start_time, end_time, state_list, decimation)
+            time.sleep(0.5)
+            if (self.receiveData(0)):
+                break
+
+        self._data_packet_list.append(self._write_string)
+
+        ### PROCESS PACKETS (GET DATA) ###
+        self.getQueryData()
+
+        ### RECORD DATA TO FILE
+        self.recordLog(self._data_packet_list)
+
+        ### END TRANSMISSION WITH HEX 16 16 16 16 command, DEC 10 10 10 10)
+        self.endTransmitRequest()
+
+        print("Python: CLOSING SERIAL PORT!")
+        self._ser.close()
+
+        self.t1 = time.time()
+
+        print("getQueryLog: time to complete was %d seconds" % (self.t1-self.t0))
+
+    def parseDiveSummary(self, read_data_string):
+        # 75 73 LL (76 bytes of summary) CC CC, layout in DiveStatistics.cpp (fillSummaryPacket)
+        start = read_data_string.find(chr(117) + chr(115))
+        if (start < 0 or len(read_data_string) < start + 3):
+            return None
+
+        packet = [ord(x) for x in read_data_string[start:]]
+        length = packet[2]
+        if (length != 76 or len(packet) < length + 5):
+            return None
+
+        if (self.crccalc(read_data_string[start:start+3+length]) != packet[3+length] * 256 + packet[4+length]):
+            print("parseDiveSummary: bad checksum")
+            return None
+
+        def uint16(i):
+            return packet[3+i] * 256 + packet[4+i]
+        def int16(i):
+            value = uint16(i)
+            if (value > 32767):
+                value = value - 65536
+            return value
+
+        summary = {}
+        summary['dive'] = uint16(0)
+        summary['seconds'] = uint16(2)
+        summary['max_depth_ft'] = int16(4) / 10.0
+        summary['mean_depth_ft'] = int16(6) / 10.0
+        summary['min_pitch_deg'] = int16(8) / 10.0
+        summary['max_pitch_deg'] = int16(10) / 10.0
+        summary['mean_pitch_deg'] = int16(12) / 10.0
+        summary['std_pitch_deg'] = int16(14) / 10.0
+        summary['mean_amps'] = int16(16) / 1000.0
+        summary['max_amps'] = int16(18) / 1000.0
+        summary['min_volts'] = int16(20) / 100.0
+        summary['joules'] = uint16(22) * 65536 + uint16(24)
+        summary['transitions'] = uint16(26)
+        summary['state_seconds'] = [uint16(28 + 2*i) for i in range(16)]
+        summary['state_entries'] = [packet[3 + 60 + i] for i in range(16)]
+        return summary
+
+    def getDiveSummary(self):
+        # one packet with the last dive's numbers (go/no-go) instead of the whole log
+        self.openserial()
+        time.sleep(1)
+        self._ser.flush()
+
+        summary = None
+        for attempt in range(3):
+            self._ser.reset_input_buffer()
+            self._ser.write("K")
+            time.sleep(1)
+
+            read_data_string = self._ser.read(self._ser.in_waiting)
+            summary = self.parseDiveSummary(read_data_string)
+            if (summary is not None):
+                break
+
+        self._ser.close()
+
+        if (summary is None):
+            print("getDiveSummary: no valid summary packet")
+        else:
+            for key in sorted(summary.keys()):
+                print("  %s: %s" % (key, summary[key]))
+
+        return summary
+
     def getCurrentLog(self):
         self.t0 = time.time()    # get current time in seconds (USED TO TIME HOW LONG THIS TAKES TO COMPLETE)
         
@@ -342,8 +821,179 @@ class ReceiveFromSerialFSG(object):
 
         print("getCurrentLog: time to complete was %d seconds" % (self.t1-self.t0))
 
+    def getWindowedLog(self, window=32, compressed=False, parity_group=0):
+        # same as getCurrentLog, the MBED streams the packets instead of waiting for a request for each one
+        self.t0 = time.time()
+
+        self.openserial()
+        time.sleep(1)
+
+        self._ser.write("c")
+        time.sleep(1)
+        self._ser.flush()
+
+        print("Python: (getWindowedLog) Sending MBED transmit command ('U')")
+        self._ser.write("U")
+        time.sleep(3)
+        self._ser.reset_input_buffer()
+
+        if (self.getWindowedData(window, compressed=compressed, parity_group=parity_group)):
+            self.recordLog(self._data_packet_list)
+
+        self.endTransmitRequest()
+
+        print("Python: CLOSING SERIAL PORT!")
+        self._ser.close()
+
+        self.t1 = time.time()
+
+        print("getWindowedLog: time to complete was %d seconds" % (self.t1-self.t0))
+
+    def loadResumeToken(self, token_filename, identity):
+        # packets downloaded in an earlier session, if the segment on the MBED is still the same one
+        try:
+            with open(token_filename, "r") as f:
+                token = json.load(f)
+        except (IOError, ValueError):
+            return []
+
+        if (token.get('segment') != identity['segment'] or token.get('fingerprint') != identity['fingerprint']):
+            print("loadResumeToken: segment %d on the MBED changed, starting over" % identity['segment'])
+            return []
+
+        bitmap = bytearray.fromhex(token.get('bitmap', ""))
+        return [x for x in range(min(len(bitmap) * 8, identity['packets'])) if bitmap[x / 8] & (1 << (x % 8))]
+
+    def saveResumeToken(self, token_filename, identity, packet_numbers):
+        bitmap = bytearray((identity['packets'] + 7) / 8)
+        for x in packet_numbers:
+            if (x < identity['packets']):
+                bitmap[x / 8] = bitmap[x / 8] | (1 << (x % 8))
+
+        token = {'segment': identity['segment'], 'fingerprint': identity['fingerprint'],
+                 'packets': identity['packets'], 'bitmap': "".join(["%02x" % x for x in bitmap])}
+
+        # write a new file and rename it, a half written token would lose the whole download
+        with open(token_filename + ".tmp", "w") as f:
+            json.dump(token, f)
+        if (os.path.exists(token_filename)):
+            os.remove(token_filename)
+        os.rename(token_filename + ".tmp", token_filename)
+
+    def getResumableData(self, segment=0xFFFF, window=32, directory=".", compressed=False, parity_group=0):
+        # LOG###.csv keeps each line at its place in the segment (every line is 255 bytes), LOG###.token says which lines are in
+        # a download that stops (end of the surface window) goes on from there the next time, lines added since are fetched too
+        # compressed blocks are decoded as soon as the line before them is in
+        identity = self.getSegmentIdentity(segment)
+        if (identity is None):
+            return False
+
+        print("getResumableData: segment %d, %d packets (MBED is recording segment %d)" % (identity['segment'], identity['packets'], identity['current_segment']))
+        if (identity['packets'] == 0):
+            print("getResumableData: nothing to download")
+            return False
+
+        csv_filename = os.path.join(directory, "LOG%03d.csv" % identity['segment'])
+        token_filename = os.path.join(directory, "LOG%03d.token" % identity['segment'])
+
+        known_packets = self.loadResumeToken(token_filename, identity)
+        if (not known_packets or not os.path.exists(csv_filename)):
+            known_packets = []
+            open(csv_filename, "wb").close()
+
+        print("getResumableData: %d packets from earlier sessions" % len(known_packets))
+
+        downloaded = set(known_packets)
+        csv_file = open(csv_filename, "r+b")
+
+        lines_total = identity['packets']
+        block_lines = self.COMPRESS_BLOCK_LINES
+
+        def blockLines(block):
+            return range(block * block_lines, min(block * block_lines + block_lines, lines_total))
+
+        if (compressed):
+            total = (lines_total + block_lines - 1) / block_lines
+            known_packets = [x for x in range(total) if all([line in downloaded for line in blockLines(x)])]
+        else:
+            total = lines_total
+
+        def writeLine(line_number, line):
+            csv_file.seek(line_number * self.LINE_SIZE)
+            csv_file.write(line[:self.LINE_SIZE-1].ljust(self.LINE_SIZE-1) + "\n")
+            downloaded.add(line_number)
+
+        pending_blocks = set()
+
+        def savePackets(packet_numbers):
+            if (not compressed):
+                for x in packet_numbers:
+                    writeLine(x, self._window_packets[x])
+            else:
+                pending_blocks.update(packet_numbers)
+                decoded = True
+                while (decoded):
+                    decoded = False
+                    for x in sorted(pending_blocks):
+                        first_line = x * block_lines
+                        if (first_line > 0 and first_line - 1 not in downloaded):
+                            continue
+
+                        primer = ""
+                        if (first_line > 0):
+                            csv_file.seek((first_line - 1) * self.LINE_SIZE)
+                            primer = csv_file.read(self.LINE_SIZE)
+
+                        block = self.decodeWindowBlock(x, primer)
+                        for i, line_number in enumerate(blockLines(x)):
+                            writeLine(line_number, block[i*self.LINE_SIZE:(i+1)*self.LINE_SIZE])
+                        pending_blocks.discard(x)
+                        decoded = True
+
+            csv_file.flush()
+            self.saveResumeToken(token_filename, identity, downloaded)
+
+        complete = self.getWindowedData(window, total=total, known_packets=known_packets, new_packets_callback=savePackets, compressed=compressed, parity_group=parity_group)
+        csv_file.close()
+
+        print("getResumableData: %d of %d packets in %s" % (len(downloaded), identity['packets'], csv_filename))
+        return complete
+
+    def getResumableLog(self, segment=0xFFFF, window=32, directory=".", compressed=False, parity_group=0):
+        # same as getWindowedLog, picks up where the last download of the segment stopped
+        self.t0 = time.time()
+
+        self.openserial()
+        time.sleep(1)
+
+        self._ser.write("c")
+        time.sleep(1)
+        self._ser.flush()
+
+        print("Python: (getResumableLog) Sending MBED transmit command ('U')")
+        self._ser.write("U")
+        time.sleep(3)
+
+        complete = self.getResumableData(segment, window, directory, compressed, parity_group)
+
+        self.endTransmitRequest()
+
+        print("Python: CLOSING SERIAL PORT!")
+        self._ser.close()
+
+        self.t1 = time.time()
+
+        print("getResumableLog: time to complete was %d seconds (%s)" % (self.t1-self.t0, "complete" if complete else "not complete, run again to resume"))
+        return complete
+
 ## CODE TO TEST BELOW ##
 if __name__ == '__main__':
     test_serial = ReceiveFromSerialFSG()
     test_serial.setSerialPort('COM8')
     test_serial.getCurrentLog()
+    #test_serial.getWindowedLog(32)    # streamed, only the lost packets are sent again
+    #test_serial.getResumableLog(0xFFFF, 32, ".")   # goes on from the last download of the segment (LOG###.csv/.token)
+    #test_serial.getResumableLog(0xFFFF, 32, ".", True)     # same, blocks of 8 compressed lines (about a third of the bytes)
+    #test_serial.getResumableLog(0xFFFF, 32, ".", True, 8)  # and a parity packet every 8 blocks for a marginal link
+    #test_serial.getDiveSummary()   # last dive max depth, pitch, current, energy, time in each state
+    #test_serial.getQueryLog(0, 0, [ReceiveFromSerialFSG.MULTI_DIVE, ReceiveFromSerialFSG.MULTI_RISE], 1)   # only the multi-dive lines